@@ -48,8 +48,9 @@
 #include "log.h"
 #include "event.h"
 #include "event-internal.h"
+#include "mm-internal.h"
 
-#define XFREE(ptr) do { if (ptr) free(ptr); } while(0)
+#define XFREE(ptr) do { if (ptr) mm_free(ptr); } while(0)
 
 extern struct event_list timequeue;
 extern struct event_list addqueue;
@@ -122,7 +123,8 @@ struct eventop win32ops = {
 	win32_del,
 	win32_dispatch,
 	win32_dealloc,
-	0
+	0, /* need reinit */
+	0 /* features */
 };
 
 #define FD_SET_ALLOC_SIZE(n) ((sizeof(struct win_fd_set) + ((n)-1)*sizeof(SOCKET)))
@@ -137,15 +139,15 @@ realloc_fd_sets(struct win32op *op, size_t new_size)
 	assert(new_size >= 1);
 
 	size = FD_SET_ALLOC_SIZE(new_size);
-	if (!(op->readset_in = realloc(op->readset_in, size)))
+	if (!(op->readset_in = mm_realloc(op->readset_in, size)))
 		return (-1);
-	if (!(op->writeset_in = realloc(op->writeset_in, size)))
+	if (!(op->writeset_in = mm_realloc(op->writeset_in, size)))
 		return (-1);
-	if (!(op->readset_out = realloc(op->readset_out, size)))
+	if (!(op->readset_out = mm_realloc(op->readset_out, size)))
 		return (-1);
-	if (!(op->exset_out = realloc(op->exset_out, size)))
+	if (!(op->exset_out = mm_realloc(op->exset_out, size)))
 		return (-1);
-	if (!(op->writeset_out = realloc(op->writeset_out, size)))
+	if (!(op->writeset_out = mm_realloc(op->writeset_out, size)))
 		return (-1);
 	op->fd_setsz = new_size;
 	return (0);
@@ -165,7 +167,7 @@ get_event_entry(struct win32op *op, SOCKET s, int create)
 	val = RB_FIND(event_map, &op->event_root, &key);
 	if (val || !create)
 		return val;
-	if (!(val = calloc(1, sizeof(struct event_entry)))) {
+	if (!(val = mm_calloc(1, sizeof(struct event_entry)))) {
 		event_warn("%s: calloc", __func__);
 		return NULL;
 	}
@@ -236,19 +238,19 @@ win32_init(struct event_base *_base)
 {
 	struct win32op *winop;
 	size_t size;
-	if (!(winop = calloc(1, sizeof(struct win32op))))
+	if (!(winop = mm_calloc(1, sizeof(struct win32op))))
 		return NULL;
 	winop->fd_setsz = NEVENT;
 	size = FD_SET_ALLOC_SIZE(NEVENT);
-	if (!(winop->readset_in = malloc(size)))
+	if (!(winop->readset_in = mm_malloc(size)))
 		goto err;
-	if (!(winop->writeset_in = malloc(size)))
+	if (!(winop->writeset_in = mm_malloc(size)))
 		goto err;
-	if (!(winop->readset_out = malloc(size)))
+	if (!(winop->readset_out = mm_malloc(size)))
 		goto err;
-	if (!(winop->writeset_out = malloc(size)))
+	if (!(winop->writeset_out = mm_malloc(size)))
 		goto err;
-	if (!(winop->exset_out = malloc(size)))
+	if (!(winop->exset_out = mm_malloc(size)))
 		goto err;
 	RB_INIT(&winop->event_root);
 	winop->readset_in->fd_count = winop->writeset_in->fd_count = 0;
@@ -322,7 +324,7 @@ win32_del(void *op, struct event *ev)
 	}
 	if (!ent->read_event && !ent->write_event) {
 		RB_REMOVE(event_map, &win32op->event_root, ent);
-		free(ent);
+		mm_free(ent);
 	}
 
 	return 0;
@@ -428,19 +430,19 @@ win32_dealloc(struct event_base *_base, void *arg)
 
 	evsignal_dealloc(_base);
 	if (win32op->readset_in)
-		free(win32op->readset_in);
+		mm_free(win32op->readset_in);
 	if (win32op->writeset_in)
-		free(win32op->writeset_in);
+		mm_free(win32op->writeset_in);
 	if (win32op->readset_out)
-		free(win32op->readset_out);
+		mm_free(win32op->readset_out);
 	if (win32op->writeset_out)
-		free(win32op->writeset_out);
+		mm_free(win32op->writeset_out);
 	if (win32op->exset_out)
-		free(win32op->exset_out);
+		mm_free(win32op->exset_out);
 	/* XXXXX free the tree. */
 
 	memset(win32op, 0, sizeof(win32op));
-	free(win32op);
+	mm_free(win32op);
 }
 
 #if 0
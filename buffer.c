@@ -49,8 +49,13 @@
 #include <sys/ioctl.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -64,13 +69,141 @@
 #include "event.h"
 #include "config.h"
 #include "evutil.h"
+#include "defer-internal.h"
+#define EVENT_MM_MODULE EVENT_MEM_BUFFER
+#include "mm-internal.h"
+
+/* see evbuffer_defer_callbacks() */
+struct evbuffer_deferred {
+	struct event_deferred deferred;
+	struct event_base *base;
+	size_t oldoff;		/* length when the callback was scheduled */
+};
+
+/*
+ * The data of an evbuffer lives in a list of chunks, so that appending,
+ * draining and moving data between buffers touches only the chunks at
+ * either end.  Each chunk is allocated together with its storage, which
+ * follows the header.  Only the last chunk of a buffer may be empty.
+ */
+struct evbuffer_chain {
+	struct evbuffer_chain *next;
+	size_t buffer_len;	/* bytes of storage */
+	size_t misalign;	/* unused bytes before the data */
+	size_t off;		/* bytes of data */
+};
+
+#define EVBUFFER_CHAIN_SIZE	sizeof(struct evbuffer_chain)
+#define EVBUFFER_CHAIN_DATA(ch)	((u_char *)((ch) + 1) + (ch)->misalign)
+#define EVBUFFER_CHAIN_SPACE(ch)					\
+	((ch)->buffer_len - (ch)->misalign - (ch)->off)
+
+/* the smallest allocation for a chunk, header included */
+#define EVBUFFER_CHAIN_MIN	512
+/* chunks grow by doubling up to this size, unless the data needs more */
+#define EVBUFFER_CHAIN_MAX_AUTO	4096
+/* data up to this size is moved to the front rather than a new chunk made */
+#define EVBUFFER_CHAIN_MAX_ALIGN 2048
+
+/*
+ * Tells the callback that the length went from oldoff to newoff, or
+ * queues it to learn about all changes of this loop pass at once.
+ */
+static void
+evbuffer_invoke_cb(struct evbuffer *buffer, size_t oldoff, size_t newoff)
+{
+	struct evbuffer_deferred *d = buffer->deferred;
+
+	if (d != NULL) {
+		if (!d->deferred.queued) {
+			d->oldoff = oldoff;
+			event_deferred_schedule(d->base, &d->deferred);
+		}
+		return;
+	}
+	(*buffer->cb)(buffer, oldoff, newoff, buffer->cbarg);
+}
+
+static struct evbuffer_chain *
+evbuffer_chain_new(size_t size)
+{
+	struct evbuffer_chain *chain;
+	size_t to_alloc;
+
+	if (size > ((size_t)-1) / 2 - EVBUFFER_CHAIN_SIZE)
+		return (NULL);
+	size += EVBUFFER_CHAIN_SIZE;
+
+	/* round small chunks up to a power of two, large ones are exact */
+	to_alloc = size;
+	if (size <= EVBUFFER_CHAIN_MAX_AUTO) {
+		to_alloc = EVBUFFER_CHAIN_MIN;
+		while (to_alloc < size)
+			to_alloc <<= 1;
+	}
+
+	if ((chain = mm_malloc(to_alloc)) == NULL)
+		return (NULL);
+	chain->next = NULL;
+	chain->buffer_len = to_alloc - EVBUFFER_CHAIN_SIZE;
+	chain->misalign = 0;
+	chain->off = 0;
+
+	return (chain);
+}
+
+static void
+evbuffer_chain_free_all(struct evbuffer_chain *chain)
+{
+	struct evbuffer_chain *next;
+
+	for (; chain != NULL; chain = next) {
+		next = chain->next;
+		mm_free(chain);
+	}
+}
+
+/* Removes an empty last chunk, so that data can be linked behind the rest */
+static void
+evbuffer_chain_free_empty_last(struct evbuffer *buf)
+{
+	struct evbuffer_chain *chain = buf->last, *prev;
+
+	if (chain == NULL || chain->off != 0)
+		return;
+	if (buf->first == chain) {
+		buf->first = buf->last = NULL;
+	} else {
+		for (prev = buf->first; prev->next != chain; prev = prev->next)
+			;
+		prev->next = NULL;
+		buf->last = prev;
+	}
+	mm_free(chain);
+}
+
+/* Appends the chunks first to last, holding len bytes, to buf */
+static void
+evbuffer_chain_link(struct evbuffer *buf, struct evbuffer_chain *first,
+    struct evbuffer_chain *last, size_t len)
+{
+	if (buf->off == 0) {
+		evbuffer_chain_free_all(buf->first);
+		buf->first = first;
+	} else {
+		evbuffer_chain_free_empty_last(buf);
+		buf->last->next = first;
+	}
+	buf->last = last;
+	buf->off += len;
+}
 
 struct evbuffer *
 evbuffer_new(void)
 {
 	struct evbuffer *buffer;
-	
-	buffer = calloc(1, sizeof(struct evbuffer));
+
+	buffer = mm_calloc(1, sizeof(struct evbuffer));
 
 	return (buffer);
 }
@@ -78,64 +211,122 @@ evbuffer_new(void)
 void
 evbuffer_free(struct evbuffer *buffer)
 {
-	if (buffer->orig_buffer != NULL)
-		free(buffer->orig_buffer);
-	free(buffer);
+	evbuffer_defer_callbacks(buffer, NULL);
+	evbuffer_chain_free_all(buffer->first);
+	mm_free(buffer);
 }
 
-/* 
+/*
  * This is a destructive add.  The data from one buffer moves into
- * the other buffer.
+ * the other buffer.  Only the chunks are relinked; nothing is copied.
  */
 
-#define SWAP(x,y) do { \
-	(x)->buffer = (y)->buffer; \
-	(x)->orig_buffer = (y)->orig_buffer; \
-	(x)->misalign = (y)->misalign; \
-	(x)->totallen = (y)->totallen; \
-	(x)->off = (y)->off; \
-} while (0)
-
 int
 evbuffer_add_buffer(struct evbuffer *outbuf, struct evbuffer *inbuf)
 {
-	int res;
-
-	/* Short cut for better performance */
-	if (outbuf->off == 0) {
-		struct evbuffer tmp;
-		size_t oldoff = inbuf->off;
-
-		/* Swap them directly */
-		SWAP(&tmp, outbuf);
-		SWAP(outbuf, inbuf);
-		SWAP(inbuf, &tmp);
-
-		/* 
-		 * Optimization comes with a price; we need to notify the
-		 * buffer if necessary of the changes. oldoff is the amount
-		 * of data that we transfered from inbuf to outbuf
-		 */
-		if (inbuf->off != oldoff && inbuf->cb != NULL)
-			(*inbuf->cb)(inbuf, oldoff, inbuf->off, inbuf->cbarg);
-		if (oldoff && outbuf->cb != NULL)
-			(*outbuf->cb)(outbuf, 0, oldoff, outbuf->cbarg);
-		
+	size_t outoff = outbuf->off, inoff = inbuf->off;
+
+	if (inoff == 0)
+		return (0);
+
+	evbuffer_chain_link(outbuf, inbuf->first, inbuf->last, inoff);
+	inbuf->first = inbuf->last = NULL;
+	inbuf->off = 0;
+
+	if (inbuf->cb != NULL)
+		evbuffer_invoke_cb(inbuf, inoff, 0);
+	if (outbuf->cb != NULL)
+		evbuffer_invoke_cb(outbuf, outoff, outbuf->off);
+
+	return (0);
+}
+
+/* Copies datlen bytes to the end of buf without telling the callback */
+static int
+evbuffer_copyin(struct evbuffer *buf, const void *data, size_t datlen)
+{
+	struct evbuffer_chain *chain = buf->last;
+	const u_char *p = data;
+	size_t n;
+
+	if (datlen == 0)
 		return (0);
+
+	/* fill up the last chunk first, then put the rest into a new one */
+	if (chain != NULL && (n = EVBUFFER_CHAIN_SPACE(chain)) != 0 &&
+	    n < datlen && chain->off != 0) {
+		memcpy(EVBUFFER_CHAIN_DATA(chain) + chain->off, p, n);
+		chain->off += n;
+		buf->off += n;
+		p += n;
+		datlen -= n;
 	}
+	if (evbuffer_expand(buf, datlen) == -1)
+		return (-1);
+
+	chain = buf->last;
+	memcpy(EVBUFFER_CHAIN_DATA(chain) + chain->off, p, datlen);
+	chain->off += datlen;
+	buf->off += datlen;
+
+	return (0);
+}
 
-	res = evbuffer_add(outbuf, inbuf->buffer, inbuf->off);
-	if (res == 0) {
-		/* We drain the input buffer on success */
-		evbuffer_drain(inbuf, inbuf->off);
+/* Removes len bytes from the front of buf without telling the callback */
+static void
+evbuffer_drain_nocb(struct evbuffer *buf, size_t len)
+{
+	struct evbuffer_chain *chain, *next;
+
+	if (len >= buf->off) {
+		/* keep the last chunk for the data to come */
+		if ((chain = buf->last) == NULL)
+			return;
+		for (; buf->first != chain; buf->first = next) {
+			next = buf->first->next;
+			mm_free(buf->first);
+		}
+		chain->misalign = 0;
+		chain->off = 0;
+		buf->off = 0;
+		return;
 	}
 
-	return (res);
+	buf->off -= len;
+	for (chain = buf->first; len >= chain->off; chain = next) {
+		next = chain->next;
+		len -= chain->off;
+		mm_free(chain);
+	}
+	buf->first = chain;
+	chain->misalign += len;
+	chain->off -= len;
+}
+
+/* Copies up to datlen bytes from the front of buf into data */
+static size_t
+evbuffer_copyout(struct evbuffer *buf, void *data, size_t datlen)
+{
+	struct evbuffer_chain *chain;
+	u_char *p = data;
+	size_t nread = 0, n;
+
+	for (chain = buf->first; chain != NULL && nread < datlen;
+	    chain = chain->next) {
+		n = datlen - nread;
+		if (n > chain->off)
+			n = chain->off;
+		memcpy(p + nread, EVBUFFER_CHAIN_DATA(chain), n);
+		nread += n;
+	}
+
+	return (nread);
 }
 
 int
 evbuffer_add_vprintf(struct evbuffer *buf, const char *fmt, va_list ap)
 {
+	struct evbuffer_chain *chain;
 	char *buffer;
 	size_t space;
 	size_t oldoff = buf->off;
@@ -143,12 +334,12 @@ evbuffer_add_vprintf(struct evbuffer *buf, const char *fmt, va_list ap)
 	va_list aq;
 
 	/* make sure that at least some space is available */
-	evbuffer_expand(buf, 64);
+	if (evbuffer_expand(buf, 64) == -1)
+		return (-1);
 	for (;;) {
-		size_t used = buf->misalign + buf->off;
-		buffer = (char *)buf->buffer + buf->off;
-		assert(buf->totallen >= used);
-		space = buf->totallen - used;
+		chain = buf->last;
+		buffer = (char *)EVBUFFER_CHAIN_DATA(chain) + chain->off;
+		space = EVBUFFER_CHAIN_SPACE(chain);
 
 #ifndef va_copy
 #define	va_copy(dst, src)	memcpy(&(dst), &(src), sizeof(va_list))
@@ -162,9 +353,10 @@ evbuffer_add_vprintf(struct evbuffer *buf, const char *fmt, va_list ap)
 		if (sz < 0)
 			return (-1);
 		if ((size_t)sz < space) {
+			chain->off += sz;
 			buf->off += sz;
 			if (buf->cb != NULL)
-				(*buf->cb)(buf, oldoff, buf->off, buf->cbarg);
+				evbuffer_invoke_cb(buf, oldoff, buf->off);
 			return (sz);
 		}
 		if (evbuffer_expand(buf, sz + 1) == -1)
@@ -192,16 +384,104 @@ evbuffer_add_printf(struct evbuffer *buf, const char *fmt, ...)
 int
 evbuffer_remove(struct evbuffer *buf, void *data, size_t datlen)
 {
-	size_t nread = datlen;
-	if (nread >= buf->off)
-		nread = buf->off;
+	size_t nread = evbuffer_copyout(buf, data, datlen);
 
-	memcpy(data, buf->buffer, nread);
 	evbuffer_drain(buf, nread);
-	
+
 	return (nread);
 }
 
+int
+evbuffer_remove_buffer(struct evbuffer *src, struct evbuffer *dst,
+    size_t datlen)
+{
+	struct evbuffer_chain *first = src->first, *chain, *prev = NULL;
+	size_t srcoff = src->off, dstoff = dst->off;
+	size_t nread = 0;
+
+	if (datlen >= src->off) {
+		evbuffer_add_buffer(dst, src);
+		return (srcoff);
+	}
+
+	/* the chunks that fit as a whole change owners */
+	for (chain = first; chain->off <= datlen - nread; chain = chain->next) {
+		nread += chain->off;
+		prev = chain;
+	}
+	if (prev != NULL) {
+		prev->next = NULL;
+		src->first = chain;
+		src->off -= nread;
+		evbuffer_chain_link(dst, first, prev, nread);
+	}
+
+	/* and the rest is copied */
+	if (nread < datlen) {
+		if (evbuffer_copyin(dst, EVBUFFER_CHAIN_DATA(chain),
+			datlen - nread) == -1)
+			datlen = nread;
+		evbuffer_drain_nocb(src, datlen - nread);
+	}
+
+	if (datlen != 0) {
+		if (src->cb != NULL)
+			evbuffer_invoke_cb(src, srcoff, src->off);
+		if (dst->cb != NULL)
+			evbuffer_invoke_cb(dst, dstoff, dst->off);
+	}
+
+	return (datlen);
+}
+
+u_char *
+evbuffer_pullup(struct evbuffer *buf, size_t size)
+{
+	struct evbuffer_chain *chain = buf->first, *tmp, *next;
+	u_char *p;
+	size_t need, n;
+
+	if (chain == NULL)
+		return (NULL);
+	if (size > buf->off)
+		size = buf->off;
+	if (chain->off >= size)
+		return (EVBUFFER_CHAIN_DATA(chain));
+
+	/* gather into the first chunk if it is large enough, else a new one */
+	if (chain->buffer_len - chain->misalign >= size) {
+		tmp = chain;
+		chain = chain->next;
+	} else {
+		if ((tmp = evbuffer_chain_new(size)) == NULL)
+			return (NULL);
+	}
+	p = EVBUFFER_CHAIN_DATA(tmp) + tmp->off;
+	need = size - tmp->off;
+
+	for (; need != 0; chain = next) {
+		next = chain->next;
+		n = chain->off < need ? chain->off : need;
+		memcpy(p, EVBUFFER_CHAIN_DATA(chain), n);
+		p += n;
+		need -= n;
+		tmp->off += n;
+		if (n < chain->off) {
+			chain->misalign += n;
+			chain->off -= n;
+			break;
+		}
+		mm_free(chain);
+	}
+
+	tmp->next = chain;
+	buf->first = tmp;
+	if (chain == NULL)
+		buf->last = tmp;
+
+	return (EVBUFFER_CHAIN_DATA(tmp));
+}
+
 /*
  * Reads a line terminated by either '\r\n', '\n\r' or '\r' or '\n'.
  * The returned buffer needs to be freed by the called.
@@ -210,20 +490,27 @@ evbuffer_remove(struct evbuffer *buf, void *data, size_t datlen)
 char *
 evbuffer_readline(struct evbuffer *buffer)
 {
-	u_char *data = EVBUFFER_DATA(buffer);
+	struct evbuffer_chain *chain;
+	u_char *data;
 	size_t len = EVBUFFER_LENGTH(buffer);
 	char *line;
-	unsigned int i;
-
-	for (i = 0; i < len; i++) {
-		if (data[i] == '\r' || data[i] == '\n')
-			break;
+	size_t i = 0, j;
+
+	/* find the end of the line, then make it and the next byte contiguous */
+	for (chain = buffer->first; chain != NULL; chain = chain->next) {
+		data = EVBUFFER_CHAIN_DATA(chain);
+		for (j = 0; j < chain->off; j++, i++) {
+			if (data[j] == '\r' || data[j] == '\n')
+				goto found;
+		}
 	}
+	return (NULL);
 
-	if (i == len)
+ found:
+	if ((data = evbuffer_pullup(buffer, i + 2)) == NULL)
 		return (NULL);
 
-	if ((line = malloc(i + 1)) == NULL) {
+	if ((line = mm_malloc_export(i + 1)) == NULL) {
 		fprintf(stderr, "%s: out of memory\n", __func__);
 		return (NULL);
 	}
@@ -248,50 +535,58 @@ evbuffer_readline(struct evbuffer *buffer)
 	return (line);
 }
 
-/* Adds data to an event buffer */
-
-static void
-evbuffer_align(struct evbuffer *buf)
-{
-	memmove(buf->orig_buffer, buf->buffer, buf->off);
-	buf->buffer = buf->orig_buffer;
-	buf->misalign = 0;
-}
-
-/* Expands the available space in the event buffer to at least datlen */
+/*
+ * Makes room for datlen bytes at the end of the last chunk, where
+ * evbuffer_read() and evbuffer_add_printf() put their data.
+ */
 
 int
 evbuffer_expand(struct evbuffer *buf, size_t datlen)
 {
-	size_t need = buf->misalign + buf->off + datlen;
-
-	/* If we can fit all the data, then we don't have to do anything */
-	if (buf->totallen >= need)
-		return (0);
-
-	/*
-	 * If the misalignment fulfills our data needs, we just force an
-	 * alignment to happen.  Afterwards, we have enough space.
-	 */
-	if (buf->misalign >= datlen) {
-		evbuffer_align(buf);
-	} else {
-		void *newbuf;
-		size_t length = buf->totallen;
+	struct evbuffer_chain *chain = buf->last, *tmp;
+	size_t to_alloc = datlen;
+
+	if (chain != NULL) {
+		/* If we can fit all the data, then we don't have to do anything */
+		if (EVBUFFER_CHAIN_SPACE(chain) >= datlen)
+			return (0);
+
+		/* A little data is cheaper to move than a new chunk */
+		if (chain->buffer_len - chain->off >= datlen &&
+		    chain->off <= EVBUFFER_CHAIN_MAX_ALIGN &&
+		    chain->off <= chain->buffer_len / 2) {
+			u_char *start = (u_char *)(chain + 1);
+
+			memmove(start, start + chain->misalign, chain->off);
+			chain->misalign = 0;
+			return (0);
+		}
 
-		if (length < 256)
-			length = 256;
-		while (length < need)
-			length <<= 1;
+		/*
+		 * small additions get ever larger chunks, up to a limit; a
+		 * large chunk before them does not make the next one large
+		 */
+		if (datlen < EVBUFFER_CHAIN_MAX_AUTO) {
+			to_alloc = chain->buffer_len;
+			if (to_alloc <= EVBUFFER_CHAIN_MAX_AUTO / 2)
+				to_alloc <<= 1;
+			else if (to_alloc > EVBUFFER_CHAIN_MAX_AUTO)
+				to_alloc = EVBUFFER_CHAIN_MAX_AUTO;
+			if (datlen > to_alloc)
+				to_alloc = datlen;
+		}
+	}
 
-		if (buf->orig_buffer != buf->buffer)
-			evbuffer_align(buf);
-		if ((newbuf = realloc(buf->buffer, length)) == NULL)
-			return (-1);
+	if ((tmp = evbuffer_chain_new(to_alloc)) == NULL)
+		return (-1);
 
-		buf->orig_buffer = buf->buffer = newbuf;
-		buf->totallen = length;
-	}
+	/* an empty last chunk is replaced instead of followed */
+	evbuffer_chain_free_empty_last(buf);
+	if (buf->last == NULL)
+		buf->first = tmp;
+	else
+		buf->last->next = tmp;
+	buf->last = tmp;
 
 	return (0);
 }
@@ -299,19 +594,13 @@ evbuffer_expand(struct evbuffer *buf, size_t datlen)
 int
 evbuffer_add(struct evbuffer *buf, const void *data, size_t datlen)
 {
-	size_t need = buf->misalign + buf->off + datlen;
 	size_t oldoff = buf->off;
 
-	if (buf->totallen < need) {
-		if (evbuffer_expand(buf, datlen) == -1)
-			return (-1);
-	}
-
-	memcpy(buf->buffer + buf->off, data, datlen);
-	buf->off += datlen;
+	if (evbuffer_copyin(buf, data, datlen) == -1)
+		return (-1);
 
 	if (datlen && buf->cb != NULL)
-		(*buf->cb)(buf, oldoff, buf->off, buf->cbarg);
+		evbuffer_invoke_cb(buf, oldoff, buf->off);
 
 	return (0);
 }
@@ -321,22 +610,11 @@ evbuffer_drain(struct evbuffer *buf, size_t len)
 {
 	size_t oldoff = buf->off;
 
-	if (len >= buf->off) {
-		buf->off = 0;
-		buf->buffer = buf->orig_buffer;
-		buf->misalign = 0;
-		goto done;
-	}
-
-	buf->buffer += len;
-	buf->misalign += len;
-
-	buf->off -= len;
+	evbuffer_drain_nocb(buf, len);
 
- done:
 	/* Tell someone about changes in this buffer */
 	if (buf->off != oldoff && buf->cb != NULL)
-		(*buf->cb)(buf, oldoff, buf->off, buf->cbarg);
+		evbuffer_invoke_cb(buf, oldoff, buf->off);
 
 }
 
@@ -349,6 +627,7 @@ evbuffer_drain(struct evbuffer *buf, size_t len)
 int
 evbuffer_read(struct evbuffer *buf, int fd, int howmuch)
 {
+	struct evbuffer_chain *chain;
 	u_char *p;
 	size_t oldoff = buf->off;
 	int n = EVBUFFER_MAX_READ;
@@ -369,8 +648,8 @@ evbuffer_read(struct evbuffer *buf, int fd, int howmuch)
 		 * about it.  If the reader does not tell us how much
 		 * data we should read, we artifically limit it.
 		 */
-		if ((size_t)n > buf->totallen << 2)
-			n = buf->totallen << 2;
+		if ((size_t)n > buf->off << 2)
+			n = buf->off << 2;
 		if (n < EVBUFFER_MAX_READ)
 			n = EVBUFFER_MAX_READ;
 	}
@@ -383,7 +662,8 @@ evbuffer_read(struct evbuffer *buf, int fd, int howmuch)
 		return (-1);
 
 	/* We can append new data at this point */
-	p = buf->buffer + buf->off;
+	chain = buf->last;
+	p = EVBUFFER_CHAIN_DATA(chain) + chain->off;
 
 #ifndef WIN32
 	n = read(fd, p, howmuch);
@@ -395,24 +675,50 @@ evbuffer_read(struct evbuffer *buf, int fd, int howmuch)
 	if (n == 0)
 		return (0);
 
+	chain->off += n;
 	buf->off += n;
 
 	/* Tell someone about changes in this buffer */
 	if (buf->off != oldoff && buf->cb != NULL)
-		(*buf->cb)(buf, oldoff, buf->off, buf->cbarg);
+		evbuffer_invoke_cb(buf, oldoff, buf->off);
 
 	return (n);
 }
 
+/* chunks handed to a single writev() */
+#if defined(IOV_MAX) && IOV_MAX < 64
+#define EVBUFFER_MAX_IOV	IOV_MAX
+#else
+#define EVBUFFER_MAX_IOV	64
+#endif
+
 int
 evbuffer_write(struct evbuffer *buffer, int fd)
 {
+	struct evbuffer_chain *chain = buffer->first;
 	int n;
 
+#ifdef HAVE_SYS_UIO_H
+	struct iovec iov[EVBUFFER_MAX_IOV];
+	int i;
+
+	for (i = 0; chain != NULL && i < EVBUFFER_MAX_IOV;
+	    chain = chain->next) {
+		if (chain->off == 0)
+			continue;
+		iov[i].iov_base = (void *)EVBUFFER_CHAIN_DATA(chain);
+		iov[i].iov_len = chain->off;
+		i++;
+	}
+	n = writev(fd, iov, i);
+#else
+	if (chain == NULL)
+		return (0);
 #ifndef WIN32
-	n = write(fd, buffer->buffer, buffer->off);
+	n = write(fd, EVBUFFER_CHAIN_DATA(chain), chain->off);
 #else
-	n = send(fd, buffer->buffer, buffer->off, 0);
+	n = send(fd, EVBUFFER_CHAIN_DATA(chain), chain->off, 0);
+#endif
 #endif
 	if (n == -1)
 		return (-1);
@@ -423,24 +729,97 @@ evbuffer_write(struct evbuffer *buffer, int fd)
 	return (n);
 }
 
+/*
+ * Compares len bytes of what with the buffer contents starting at offset
+ * off of chain, continuing into the following chunks as needed.
+ */
+static int
+evbuffer_chain_match(struct evbuffer_chain *chain, size_t off,
+    const u_char *what, size_t len)
+{
+	size_t n;
+
+	for (; chain != NULL && len != 0; chain = chain->next, off = 0) {
+		n = chain->off - off < len ? chain->off - off : len;
+		if (memcmp(EVBUFFER_CHAIN_DATA(chain) + off, what, n) != 0)
+			return (0);
+		what += n;
+		len -= n;
+	}
+
+	return (len == 0);
+}
+
+/*
+ * Searches the chunks in place and only makes the buffer contiguous up to
+ * the end of the match, so that the result can still be used as an offset
+ * from EVBUFFER_DATA().
+ */
+
 u_char *
 evbuffer_find(struct evbuffer *buffer, const u_char *what, size_t len)
 {
-	u_char *search = buffer->buffer, *end = search + buffer->off;
-	u_char *p;
+	struct evbuffer_chain *chain;
+	u_char *data, *p;
+	size_t pos = 0, off;
 
-	while (search < end &&
-	    (p = memchr(search, *what, end - search)) != NULL) {
-		if (p + len > end)
-			break;
-		if (memcmp(p, what, len) == 0)
-			return (p);
-		search = p + 1;
+	if (len > buffer->off)
+		return (NULL);
+
+	for (chain = buffer->first; chain != NULL;
+	    pos += chain->off, chain = chain->next) {
+		data = EVBUFFER_CHAIN_DATA(chain);
+		for (off = 0; off < chain->off &&
+		    (p = memchr(data + off, *what, chain->off - off)) != NULL;
+		    off = p - data + 1) {
+			if (pos + (p - data) + len > buffer->off)
+				return (NULL);
+			if (evbuffer_chain_match(chain, p - data, what, len)) {
+				pos += p - data;
+				if ((data = evbuffer_pullup(buffer, pos + len)) == NULL)
+					return (NULL);
+				return (data + pos);
+			}
+		}
 	}
 
 	return (NULL);
 }
 
+static void
+evbuffer_deferred_cb(struct event_deferred *d, void *arg)
+{
+	struct evbuffer *buffer = arg;
+	size_t oldoff = buffer->deferred->oldoff;
+
+	if (buffer->cb != NULL && buffer->off != oldoff)
+		(*buffer->cb)(buffer, oldoff, buffer->off, buffer->cbarg);
+}
+
+int
+evbuffer_defer_callbacks(struct evbuffer *buffer, struct event_base *base)
+{
+	struct evbuffer_deferred *d = buffer->deferred;
+
+	if (d != NULL) {
+		event_deferred_cancel(d->base, &d->deferred);
+		if (base == NULL) {
+			mm_free(d);
+			buffer->deferred = NULL;
+			return (0);
+		}
+	} else {
+		if (base == NULL)
+			return (0);
+		if ((d = mm_malloc(sizeof(struct evbuffer_deferred))) == NULL)
+			return (-1);
+		event_deferred_init(&d->deferred, evbuffer_deferred_cb, buffer);
+		buffer->deferred = d;
+	}
+	d->base = base;
+	return (0);
+}
+
 void evbuffer_setcb(struct evbuffer *buffer,
     void (*cb)(struct evbuffer *, size_t, size_t, void *),
     void *cbarg)
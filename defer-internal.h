@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2026 The libevent contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _DEFER_INTERNAL_H_
+#define _DEFER_INTERNAL_H_
+
+#include <sys/queue.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Deferred callbacks run once per loop pass, after the active events, no
+ * matter how often they were scheduled in between.  Parts of the library
+ * use them to report changes to an object once instead of every time the
+ * object is touched, and from the loop instead of from deep inside the
+ * call that changed it.  They must be scheduled from the loop thread.
+ */
+struct event_deferred;
+typedef void (*event_deferred_cb)(struct event_deferred *, void *);
+
+struct event_deferred {
+	TAILQ_ENTRY (event_deferred) next;
+	int queued;
+	event_deferred_cb cb;
+	void *arg;
+};
+
+TAILQ_HEAD (event_deferred_list, event_deferred);
+
+void event_deferred_init(struct event_deferred *, event_deferred_cb, void *);
+/* does nothing if the callback is queued already */
+void event_deferred_schedule(struct event_base *, struct event_deferred *);
+void event_deferred_cancel(struct event_base *, struct event_deferred *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DEFER_INTERNAL_H_ */
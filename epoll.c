@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <sys/resource.h>
+#include <limits.h>
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #else
@@ -38,6 +39,9 @@
 #endif
 #include <sys/queue.h>
 #include <sys/epoll.h>
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -51,7 +55,9 @@
 #include "event.h"
 #include "event-internal.h"
 #include "evsignal.h"
+#include "fd_map.h"
 #include "log.h"
+#include "mm-internal.h"
 
 /* due to limitations in the epoll interface, we need to keep track of
  * all file descriptors outself.
@@ -59,14 +65,46 @@
 struct evepoll {
 	struct event *evread;
 	struct event *evwrite;
+	int kernel;	/* interest last passed to epoll_ctl */
+	int changed;	/* EVEPOLL_CHANGED, EVEPOLL_CLEARED, EVEPOLL_REARM */
 };
 
+/*
+ * Interest changes are not passed to the kernel right away: epoll_add()
+ * and epoll_del() only put the fd on a changelist, and epoll_dispatch()
+ * compares the final interest with what the kernel has before it waits.
+ * An fd whose write interest is toggled back and forth within one pass
+ * does not cost a system call.  epoll_add() registers a new fd at once,
+ * so that event_add() still fails for an fd that epoll cannot watch.
+ */
+#define EVEPOLL_CHANGED	0x01	/* fd is on the changelist */
+#define EVEPOLL_CLEARED	0x02	/* all interest was dropped meanwhile */
+#define EVEPOLL_REARM	0x04	/* an EV_ET event was added */
+
+/* the wakeup modes of an fd, which all of its events share */
+#define EVEPOLL_MODES	(EV_ET|EV_EXCLUSIVE)
+
+#ifdef EPOLLEXCLUSIVE
+#define EPOLL_FEATURES	(EV_FEATURE_ET|EV_FEATURE_EXCLUSIVE)
+#else
+#define EPOLLEXCLUSIVE	0
+#define EPOLL_FEATURES	EV_FEATURE_ET
+#endif
+
 struct epollop {
-	struct evepoll *fds;
-	int nfds;
+	fd_map_t fds;		/* struct evepoll by fd */
 	struct epoll_event *events;
 	int nevents;
+	int last_res;		/* events returned by the last wait */
+	int avg_res;		/* moving average of them, in 1/16 */
 	int epfd;
+	int *changes;
+	int nchanges;
+	int changes_alloc;
+	/* EVBASE_PRECISE_TIMER: wait with epoll_pwait2() or on a timerfd */
+	int use_pwait2;
+	int timerfd;
+	int timerfd_armed;
 };
 
 static void *epoll_init	(struct event_base *);
@@ -82,7 +120,8 @@ const struct eventop epollops = {
 	epoll_del,
 	epoll_dispatch,
 	epoll_dealloc,
-	1 /* need reinit */
+	1, /* need reinit */
+	EPOLL_FEATURES
 };
 
 #ifdef HAVE_SETFD
@@ -102,9 +141,53 @@ const struct eventop epollops = {
  */
 #define MAX_EPOLL_TIMEOUT_MSEC (35*60*1000)
 
-#define INITIAL_NFILES 32
 #define INITIAL_NEVENTS 32
-#define MAX_NEVENTS 4096
+/* the most events we can ask for without overflowing the array size */
+#define MAX_NEVENTS (INT_MAX / (int)sizeof(struct epoll_event))
+
+/*
+ * epoll_wait() takes its timeout in milliseconds, so a base that asked for
+ * precise timers waits with epoll_pwait2() if the kernel has it, or else
+ * sleeps on a timerfd in the epoll set that carries the real deadline.
+ */
+static void
+epoll_init_precise(struct epollop *epollop)
+{
+	struct epoll_event epev = {EPOLLIN, {0}};
+#ifdef HAVE_EPOLL_PWAIT2
+	struct timespec ts = {0, 0};
+#endif
+#ifdef HAVE_SYS_TIMERFD_H
+	int fd;
+#endif
+
+#ifdef HAVE_EPOLL_PWAIT2
+	/* the C library may know epoll_pwait2() when the kernel does not */
+	if (epoll_pwait2(epollop->epfd, &epev, 1, &ts, NULL) != -1 ||
+	    errno != ENOSYS) {
+		epollop->use_pwait2 = 1;
+		return;
+	}
+#endif
+
+#ifdef HAVE_SYS_TIMERFD_H
+	if ((fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) == -1) {
+		event_warn("timerfd_create");
+		return;
+	}
+	FD_CLOSEONEXEC(fd);
+
+	epev.data.fd = fd;
+	if (epoll_ctl(epollop->epfd, EPOLL_CTL_ADD, fd, &epev) == -1) {
+		event_warn("epoll_ctl: timerfd");
+		close(fd);
+		return;
+	}
+	epollop->timerfd = fd;
+#else
+	event_warnx("%s: precise timers are not supported", __func__);
+#endif
+}
 
 static void *
 epoll_init(struct event_base *base)
@@ -125,64 +208,232 @@ epoll_init(struct event_base *base)
 
 	FD_CLOSEONEXEC(epfd);
 
-	if (!(epollop = calloc(1, sizeof(struct epollop))))
+	if (!(epollop = mm_calloc(1, sizeof(struct epollop))))
 		return (NULL);
 
 	epollop->epfd = epfd;
+	epollop->timerfd = -1;
 
 	/* Initalize fields */
-	epollop->events = malloc(INITIAL_NEVENTS * sizeof(struct epoll_event));
+	epollop->events = mm_malloc(INITIAL_NEVENTS * sizeof(struct epoll_event));
 	if (epollop->events == NULL) {
-		free(epollop);
+		mm_free(epollop);
 		return (NULL);
 	}
 	epollop->nevents = INITIAL_NEVENTS;
 
-	epollop->fds = calloc(INITIAL_NFILES, sizeof(struct evepoll));
-	if (epollop->fds == NULL) {
-		free(epollop->events);
-		free(epollop);
-		return (NULL);
-	}
-	epollop->nfds = INITIAL_NFILES;
+	fd_map_ctor(&epollop->fds, sizeof(struct evepoll));
+
+	if (base->flags & EVBASE_PRECISE_TIMER)
+		epoll_init_precise(epollop);
 
 	evsignal_init(base);
 
 	return (epollop);
 }
 
+/* Returns the EVEPOLL_MODES of the events on an fd */
 static int
-epoll_recalc(struct event_base *base, void *arg, int max)
+epoll_modes(struct evepoll *evep)
 {
-	struct epollop *epollop = arg;
+	struct event *ev = evep->evread != NULL ? evep->evread : evep->evwrite;
 
-	if (max >= epollop->nfds) {
-		struct evepoll *fds;
-		int nfds;
+	return (ev != NULL ? ev->ev_events & EVEPOLL_MODES : 0);
+}
 
-		nfds = epollop->nfds;
-		while (nfds <= max)
-			nfds <<= 1;
+/* Lets the fd map free the entry of fd once it holds no state */
+static void
+epoll_release_fd(struct epollop *epollop, int fd)
+{
+	struct evepoll *evep = fd_map_find(&epollop->fds, fd);
+
+	if (evep != NULL)
+		fd_map_mark(&epollop->fds, fd, evep->evread != NULL ||
+		    evep->evwrite != NULL || evep->kernel != 0 ||
+		    evep->changed != 0);
+}
+
+/*
+ * Brings the kernel's interest for fd in line with its entry.  Returns -1
+ * with errno set if the kernel refuses it.
+ */
+static int
+epoll_sync_fd(struct epollop *epollop, int fd)
+{
+	struct epoll_event epev = {0, {0}};
+	struct evepoll *evep = fd_map_find(&epollop->fds, fd);
+	int op, want, res, resync;
+
+	resync = evep->changed & (EVEPOLL_CLEARED|EVEPOLL_REARM);
+	evep->changed = 0;
+
+	want = 0;
+	if (evep->evread != NULL)
+		want |= EPOLLIN;
+	if (evep->evwrite != NULL)
+		want |= EPOLLOUT;
+	if (want != 0 && (epoll_modes(evep) & EV_ET))
+		want |= EPOLLET;
+	if (want != 0 && (epoll_modes(evep) & EV_EXCLUSIVE))
+		want |= EPOLLEXCLUSIVE;
+
+	/*
+	 * If the fd lost all of its events it may have been closed and
+	 * reopened since, in which case the kernel no longer knows it.
+	 * An edge-triggered event that is added again may have missed its
+	 * edge; passing its interest to the kernel again reports the fd if
+	 * it is ready.
+	 */
+	if (want == evep->kernel && (want == 0 || !resync))
+		return (0);
+
+	epev.data.fd = fd;
+	epev.events = want;
+
+	if (want == 0)
+		op = EPOLL_CTL_DEL;
+	else if (evep->kernel == 0)
+		op = EPOLL_CTL_ADD;
+	else if ((want | evep->kernel) & EPOLLEXCLUSIVE) {
+		/* the kernel does not modify exclusive interest */
+		epoll_ctl(epollop->epfd, EPOLL_CTL_DEL, fd, &epev);
+		op = EPOLL_CTL_ADD;
+	} else
+		op = EPOLL_CTL_MOD;
+
+	res = epoll_ctl(epollop->epfd, op, fd, &epev);
+	if (res == -1 && op == EPOLL_CTL_MOD && errno == ENOENT) {
+		op = EPOLL_CTL_ADD;
+		res = epoll_ctl(epollop->epfd, op, fd, &epev);
+	} else if (res == -1 && op == EPOLL_CTL_ADD && errno == EEXIST) {
+		if (want & EPOLLEXCLUSIVE)
+			epoll_ctl(epollop->epfd, EPOLL_CTL_DEL, fd, &epev);
+		else
+			op = EPOLL_CTL_MOD;
+		res = epoll_ctl(epollop->epfd, op, fd, &epev);
+	} else if (res == -1 && op == EPOLL_CTL_DEL &&
+	    (errno == ENOENT || errno == EBADF || errno == EPERM)) {
+		/* closing the fd already removed it */
+		res = 0;
+	}
+
+	if (res == -1)
+		return (-1);
+	evep->kernel = want;
+	return (0);
+}
 
-		fds = realloc(epollop->fds, nfds * sizeof(struct evepoll));
-		if (fds == NULL) {
+static void
+epoll_queue_change(struct epollop *epollop, int fd)
+{
+	struct evepoll *evep = fd_map_find(&epollop->fds, fd);
+
+	if (evep->changed & EVEPOLL_CHANGED)
+		return;
+
+	if (epollop->nchanges == epollop->changes_alloc) {
+		int n = epollop->changes_alloc ? epollop->changes_alloc * 2 :
+		    INITIAL_NEVENTS;
+		int *changes = mm_realloc(epollop->changes, n * sizeof(int));
+		if (changes == NULL) {
+			/* we can always fall back to an immediate update */
 			event_warn("realloc");
-			return (-1);
+			if (epoll_sync_fd(epollop, fd) == -1)
+				event_warn("epoll_ctl(%d)", fd);
+			epoll_release_fd(epollop, fd);
+			return;
 		}
-		epollop->fds = fds;
-		memset(fds + epollop->nfds, 0,
-		    (nfds - epollop->nfds) * sizeof(struct evepoll));
-		epollop->nfds = nfds;
+		epollop->changes = changes;
+		epollop->changes_alloc = n;
 	}
 
-	return (0);
+	epollop->changes[epollop->nchanges++] = fd;
+	evep->changed |= EVEPOLL_CHANGED;
+}
+
+static void
+epoll_apply_changes(struct epollop *epollop)
+{
+	int i;
+
+	for (i = 0; i < epollop->nchanges; i++) {
+		if (epoll_sync_fd(epollop, epollop->changes[i]) == -1)
+			event_warn("epoll_ctl(%d)", epollop->changes[i]);
+		epoll_release_fd(epollop, epollop->changes[i]);
+	}
+	epollop->nchanges = 0;
+}
+
+#ifdef HAVE_SYS_TIMERFD_H
+/* Programs the timerfd for tv and returns the timeout for epoll_wait() */
+static int
+epoll_timerfd_set(struct epollop *epollop, struct timeval *tv, int timeout)
+{
+	struct itimerspec its;
+
+	if (tv != NULL && !evutil_timerisset(tv))
+		return (0);
+	/* an expired timer would keep the fd readable */
+	if (tv == NULL && !epollop->timerfd_armed)
+		return (-1);
+
+	memset(&its, 0, sizeof(its));
+	if (tv != NULL) {
+		its.it_value.tv_sec = tv->tv_sec;
+		its.it_value.tv_nsec = tv->tv_usec * 1000;
+	}
+	if (timerfd_settime(epollop->timerfd, 0, &its, NULL) == -1) {
+		event_warn("timerfd_settime");
+		return (timeout);
+	}
+	epollop->timerfd_armed = tv != NULL;
+
+	return (-1);
+}
+#endif
+
+/*
+ * Sizes the event array for the next wait.  A wait that filled the array
+ * may have left ready fds behind, so the array doubles; once the average
+ * wait returns less than a quarter of it, it halves, so that one burst
+ * does not keep a large array around for good.
+ */
+static void
+epoll_resize_events(struct epollop *epollop, int max)
+{
+	struct epoll_event *events;
+	int nevents = epollop->nevents;
+
+	if (max <= 0 || max > MAX_NEVENTS)
+		max = MAX_NEVENTS;
+
+	if (nevents > max)
+		nevents = max;
+	else if (epollop->last_res == nevents && nevents < max)
+		nevents = nevents > max / 2 ? max : nevents * 2;
+	else if (nevents > INITIAL_NEVENTS &&
+	    (epollop->avg_res >> 4) < nevents / 4)
+		nevents = nevents / 2 < INITIAL_NEVENTS ?
+		    INITIAL_NEVENTS : nevents / 2;
+
+	if (nevents == epollop->nevents)
+		return;
+
+	events = mm_realloc(epollop->events,
+	    nevents * sizeof(struct epoll_event));
+	if (events != NULL)
+		epollop->events = events;
+	else if (nevents > epollop->nevents)
+		return;
+	/* a smaller array we could not get only means a smaller wait */
+	epollop->nevents = nevents;
 }
 
 static int
 epoll_dispatch(struct event_base *base, void *arg, struct timeval *tv)
 {
 	struct epollop *epollop = arg;
-	struct epoll_event *events = epollop->events;
+	struct epoll_event *events;
 	struct evepoll *evep;
 	int i, res, timeout = -1;
 
@@ -195,6 +446,25 @@ epoll_dispatch(struct event_base *base, void *arg, struct timeval *tv)
 		timeout = MAX_EPOLL_TIMEOUT_MSEC;
 	}
 
+	epoll_apply_changes(epollop);
+	epoll_resize_events(epollop, base->max_dispatch_events);
+	events = epollop->events;
+
+#ifdef HAVE_SYS_TIMERFD_H
+	if (epollop->timerfd != -1)
+		timeout = epoll_timerfd_set(epollop, tv, timeout);
+#endif
+
+#ifdef HAVE_EPOLL_PWAIT2
+	if (epollop->use_pwait2 && tv != NULL) {
+		struct timespec ts;
+
+		ts.tv_sec = tv->tv_sec;
+		ts.tv_nsec = tv->tv_usec * 1000;
+		res = epoll_pwait2(epollop->epfd, events, epollop->nevents,
+		    &ts, NULL);
+	} else
+#endif
 	res = epoll_wait(epollop->epfd, events, epollop->nevents, timeout);
 
 	if (res == -1) {
@@ -211,14 +481,20 @@ epoll_dispatch(struct event_base *base, void *arg, struct timeval *tv)
 
 	event_debug(("%s: epoll_wait reports %d", __func__, res));
 
+	/* empty polls of a busy loop say nothing about the load */
+	epollop->last_res = res;
+	if (res > 0 || timeout != 0)
+		epollop->avg_res += ((res << 4) - epollop->avg_res) / 8;
+
 	for (i = 0; i < res; i++) {
 		int what = events[i].events;
 		struct event *evread = NULL, *evwrite = NULL;
 		int fd = events[i].data.fd;
 
-		if (fd < 0 || fd >= epollop->nfds)
+		/* the timerfd only had to wake us up */
+		if (fd == epollop->timerfd ||
+		    (evep = fd_map_find(&epollop->fds, fd)) == NULL)
 			continue;
-		evep = &epollop->fds[fd];
 
 		if (what & (EPOLLHUP|EPOLLERR)) {
 			evread = evep->evread;
@@ -242,20 +518,6 @@ epoll_dispatch(struct event_base *base, void *arg, struct timeval *tv)
 			event_active(evwrite, EV_WRITE, 1);
 	}
 
-	if (res == epollop->nevents && epollop->nevents < MAX_NEVENTS) {
-		/* We used all of the event space this time.  We should
-		   be ready for more events next time. */
-		int new_nevents = epollop->nevents * 2;
-		struct epoll_event *new_events;
-
-		new_events = realloc(epollop->events,
-		    new_nevents * sizeof(struct epoll_event));
-		if (new_events) {
-			epollop->events = new_events;
-			epollop->nevents = new_nevents;
-		}
-	}
-
 	return (0);
 }
 
@@ -264,46 +526,55 @@ static int
 epoll_add(void *arg, struct event *ev)
 {
 	struct epollop *epollop = arg;
-	struct epoll_event epev = {0, {0}};
 	struct evepoll *evep;
-	int fd, op, events;
+	struct event *evread, *evwrite;
+	int fd, changed;
 
 	if (ev->ev_events & EV_SIGNAL)
 		return (evsignal_add(ev));
 
 	fd = ev->ev_fd;
-	if (fd >= epollop->nfds) {
-		/* Extent the file descriptor array as necessary */
-		if (epoll_recalc(ev->ev_base, epollop, fd) == -1)
-			return (-1);
-	}
-	evep = &epollop->fds[fd];
-	op = EPOLL_CTL_ADD;
-	events = 0;
-	if (evep->evread != NULL) {
-		events |= EPOLLIN;
-		op = EPOLL_CTL_MOD;
-	}
-	if (evep->evwrite != NULL) {
-		events |= EPOLLOUT;
-		op = EPOLL_CTL_MOD;
+	if ((evep = fd_map_get(&epollop->fds, fd)) == NULL) {
+		event_warn("%s: malloc", __func__);
+		return (-1);
 	}
 
-	if (ev->ev_events & EV_READ)
-		events |= EPOLLIN;
-	if (ev->ev_events & EV_WRITE)
-		events |= EPOLLOUT;
-
-	epev.data.fd = fd;
-	epev.events = events;
-	if (epoll_ctl(epollop->epfd, op, ev->ev_fd, &epev) == -1)
-			return (-1);
+	/* epoll knows only one trigger and wakeup mode per fd */
+	if ((evep->evread != NULL || evep->evwrite != NULL) &&
+	    epoll_modes(evep) != (ev->ev_events & EVEPOLL_MODES)) {
+		event_warnx("%s: mixing EV_ET or EV_EXCLUSIVE with other "
+		    "events on fd %d", __func__, fd);
+		return (-1);
+	}
 
 	/* Update events responsible */
+	evread = evep->evread;
+	evwrite = evep->evwrite;
+	changed = evep->changed;
 	if (ev->ev_events & EV_READ)
 		evep->evread = ev;
 	if (ev->ev_events & EV_WRITE)
 		evep->evwrite = ev;
+	if (ev->ev_events & EV_ET)
+		evep->changed |= EVEPOLL_REARM;
+
+	/*
+	 * An fd the kernel does not know yet, or that lost all of its events
+	 * and may have been reopened since, is registered right away: a
+	 * closed fd or a regular file then fails here and not in a later pass
+	 * of the loop.  Both need a system call in the next pass anyway.
+	 */
+	if (evep->kernel == 0 || (evep->changed & EVEPOLL_CLEARED)) {
+		if (epoll_sync_fd(epollop, fd) == -1) {
+			evep->evread = evread;
+			evep->evwrite = evwrite;
+			evep->changed = changed;
+			epoll_release_fd(epollop, fd);
+			return (-1);
+		}
+	} else
+		epoll_queue_change(epollop, fd);
+	epoll_release_fd(epollop, fd);
 
 	return (0);
 }
@@ -312,49 +583,24 @@ static int
 epoll_del(void *arg, struct event *ev)
 {
 	struct epollop *epollop = arg;
-	struct epoll_event epev = {0, {0}};
 	struct evepoll *evep;
-	int fd, events, op;
-	int needwritedelete = 1, needreaddelete = 1;
+	int fd;
 
 	if (ev->ev_events & EV_SIGNAL)
 		return (evsignal_del(ev));
 
 	fd = ev->ev_fd;
-	if (fd >= epollop->nfds)
+	if ((evep = fd_map_find(&epollop->fds, fd)) == NULL)
 		return (0);
-	evep = &epollop->fds[fd];
-
-	op = EPOLL_CTL_DEL;
-	events = 0;
 
 	if (ev->ev_events & EV_READ)
-		events |= EPOLLIN;
-	if (ev->ev_events & EV_WRITE)
-		events |= EPOLLOUT;
-
-	if ((events & (EPOLLIN|EPOLLOUT)) != (EPOLLIN|EPOLLOUT)) {
-		if ((events & EPOLLIN) && evep->evwrite != NULL) {
-			needwritedelete = 0;
-			events = EPOLLOUT;
-			op = EPOLL_CTL_MOD;
-		} else if ((events & EPOLLOUT) && evep->evread != NULL) {
-			needreaddelete = 0;
-			events = EPOLLIN;
-			op = EPOLL_CTL_MOD;
-		}
-	}
-
-	epev.events = events;
-	epev.data.fd = fd;
-
-	if (needreaddelete)
 		evep->evread = NULL;
-	if (needwritedelete)
+	if (ev->ev_events & EV_WRITE)
 		evep->evwrite = NULL;
+	if (evep->evread == NULL && evep->evwrite == NULL)
+		evep->changed |= EVEPOLL_CLEARED;
 
-	if (epoll_ctl(epollop->epfd, op, fd, &epev) == -1)
-		return (-1);
+	epoll_queue_change(epollop, fd);
 
 	return (0);
 }
@@ -365,13 +611,16 @@ epoll_dealloc(struct event_base *base, void *arg)
 	struct epollop *epollop = arg;
 
 	evsignal_dealloc(base);
-	if (epollop->fds)
-		free(epollop->fds);
+	fd_map_dtor(&epollop->fds);
 	if (epollop->events)
-		free(epollop->events);
+		mm_free(epollop->events);
+	if (epollop->changes)
+		mm_free(epollop->changes);
+	if (epollop->timerfd >= 0)
+		close(epollop->timerfd);
 	if (epollop->epfd >= 0)
 		close(epollop->epfd);
 
 	memset(epollop, 0, sizeof(struct epollop));
-	free(epollop);
+	mm_free(epollop);
 }
@@ -49,6 +49,14 @@
 
 #include "evutil.h"
 #include "event.h"
+#define EVENT_MM_MODULE EVENT_MEM_BUFFER
+#include "mm-internal.h"
+
+/*
+ * Edge-triggered bufferevents read and write until the socket would block,
+ * but give other events a chance after this many system calls.
+ */
+#define BUFFEREVENT_ET_MAX_IO	16
 
 /* prototypes */
 
@@ -57,12 +65,16 @@ void bufferevent_read_pressure_cb(struct evbuffer *, size_t, size_t, void *);
 static int
 bufferevent_add(struct event *ev, int timeout)
 {
-	struct timeval tv, *ptv = NULL;
+	struct timeval tv;
+	const struct timeval *ptv = NULL;
 
 	if (timeout) {
 		evutil_timerclear(&tv);
 		tv.tv_sec = timeout;
-		ptv = &tv;
+		/* all bufferevents share a few timeouts; keep them in queues */
+		ptv = event_base_init_common_timeout(ev->ev_base, &tv);
+		if (ptv == NULL)
+			ptv = &tv;
 	}
 
 	return (event_add(ev, ptv));
@@ -89,6 +101,32 @@ bufferevent_read_pressure_cb(struct evbuffer *buf, size_t old, size_t now,
 	}
 }
 
+/*
+ * An edge-triggered read event does not fire again for data that is
+ * already waiting, so keep reading until the socket would block.  If we
+ * have to stop before that, make the event active again so that the next
+ * loop pass picks up where we left off; that is also how an EOF or error
+ * after the data we got here is reported.
+ */
+static void
+bufferevent_read_et(struct bufferevent *bufev, int fd, int howmuch, int res)
+{
+	int i;
+
+	for (i = 1; i < BUFFEREVENT_ET_MAX_IO; i++) {
+		/* stopping at the high watermark is handled by the caller */
+		if (howmuch != -1 && (howmuch -= res) <= 0)
+			return;
+		res = evbuffer_read(bufev->input, fd, howmuch);
+		if (res == -1 && errno == EAGAIN)
+			return;
+		if (res <= 0)
+			break;
+	}
+
+	event_active(&bufev->ev_read, EV_READ, 1);
+}
+
 static void
 bufferevent_readcb(int fd, short event, void *arg)
 {
@@ -133,6 +171,9 @@ bufferevent_readcb(int fd, short event, void *arg)
 	if (res <= 0)
 		goto error;
 
+	if (bufev->ev_read.ev_events & EV_ET)
+		bufferevent_read_et(bufev, fd, howmuch, res);
+
 	bufferevent_add(&bufev->ev_read, bufev->timeout_read);
 
 	/* See if this callbacks meets the water marks */
@@ -157,9 +198,34 @@ bufferevent_readcb(int fd, short event, void *arg)
 	return;
 
  error:
+	/* an edge-triggered event is persistent */
+	event_del(&bufev->ev_read);
 	(*bufev->errorcb)(bufev, what, bufev->cbarg);
 }
 
+/*
+ * Keeps writing until the socket would block, after which the next edge
+ * tells us that there is room again.
+ */
+static void
+bufferevent_write_et(struct bufferevent *bufev, int fd)
+{
+	int i, res;
+
+	for (i = 1; i < BUFFEREVENT_ET_MAX_IO; i++) {
+		if (EVBUFFER_LENGTH(bufev->output) == 0)
+			return;
+		res = evbuffer_write(bufev->output, fd);
+		if (res == -1 && errno == EAGAIN)
+			return;
+		if (res <= 0)
+			break;
+	}
+
+	if (EVBUFFER_LENGTH(bufev->output) != 0)
+		event_active(&bufev->ev_write, EV_WRITE, 1);
+}
+
 static void
 bufferevent_writecb(int fd, short event, void *arg)
 {
@@ -195,10 +261,14 @@ bufferevent_writecb(int fd, short event, void *arg)
 	    }
 	    if (res <= 0)
 		    goto error;
+	    if (bufev->ev_write.ev_events & EV_ET)
+		    bufferevent_write_et(bufev, fd);
 	}
 
 	if (EVBUFFER_LENGTH(bufev->output) != 0)
 		bufferevent_add(&bufev->ev_write, bufev->timeout_write);
+	else if (bufev->ev_write.ev_events & EV_PERSIST)
+		event_del(&bufev->ev_write);
 
 	/*
 	 * Invoke the user callback if our buffer is drained or below the
@@ -216,6 +286,7 @@ bufferevent_writecb(int fd, short event, void *arg)
 	return;
 
  error:
+	event_del(&bufev->ev_write);
 	(*bufev->errorcb)(bufev, what, bufev->cbarg);
 }
 
@@ -236,23 +307,32 @@ bufferevent_new(int fd, evbuffercb readcb, evbuffercb writecb,
 {
 	struct bufferevent *bufev;
 
-	if ((bufev = calloc(1, sizeof(struct bufferevent))) == NULL)
+	if ((bufev = mm_calloc(1, sizeof(struct bufferevent))) == NULL)
 		return (NULL);
 
 	if ((bufev->input = evbuffer_new()) == NULL) {
-		free(bufev);
+		mm_free(bufev);
 		return (NULL);
 	}
 
 	if ((bufev->output = evbuffer_new()) == NULL) {
 		evbuffer_free(bufev->input);
-		free(bufev);
+		mm_free(bufev);
 		return (NULL);
 	}
 
 	event_set(&bufev->ev_read, fd, EV_READ, bufferevent_readcb, bufev);
 	event_set(&bufev->ev_write, fd, EV_WRITE, bufferevent_writecb, bufev);
 
+	/* the read pressure callback only needs to run once per pass */
+	if (evbuffer_defer_callbacks(bufev->input,
+		bufev->ev_read.ev_base) == -1) {
+		evbuffer_free(bufev->output);
+		evbuffer_free(bufev->input);
+		mm_free(bufev);
+		return (NULL);
+	}
+
 	bufferevent_setcb(bufev, readcb, writecb, errorcb, cbarg);
 
 	/*
@@ -279,11 +359,15 @@ bufferevent_setcb(struct bufferevent *bufev,
 void
 bufferevent_setfd(struct bufferevent *bufev, int fd)
 {
+	short mode = bufev->ev_read.ev_events & (EV_PERSIST|EV_ET);
+
 	event_del(&bufev->ev_read);
 	event_del(&bufev->ev_write);
 
-	event_set(&bufev->ev_read, fd, EV_READ, bufferevent_readcb, bufev);
-	event_set(&bufev->ev_write, fd, EV_WRITE, bufferevent_writecb, bufev);
+	event_set(&bufev->ev_read, fd, EV_READ|mode,
+	    bufferevent_readcb, bufev);
+	event_set(&bufev->ev_write, fd, EV_WRITE|mode,
+	    bufferevent_writecb, bufev);
 	if (bufev->ev_base != NULL) {
 		event_base_set(bufev->ev_base, &bufev->ev_read);
 		event_base_set(bufev->ev_base, &bufev->ev_write);
@@ -292,6 +376,37 @@ bufferevent_setfd(struct bufferevent *bufev, int fd)
 	/* might have to manually trigger event registration */
 }
 
+int
+bufferevent_set_edge_triggered(struct bufferevent *bufev, int on)
+{
+	struct event_base *base = bufev->ev_read.ev_base;
+	int fd = bufev->ev_read.ev_fd;
+	int pri = bufev->ev_read.ev_pri;
+	short mode = on ? EV_PERSIST|EV_ET : 0;
+
+	if (on && !(event_base_get_features(base) & EV_FEATURE_ET))
+		return (-1);
+
+	event_del(&bufev->ev_read);
+	event_del(&bufev->ev_write);
+
+	event_set(&bufev->ev_read, fd, EV_READ|mode,
+	    bufferevent_readcb, bufev);
+	event_set(&bufev->ev_write, fd, EV_WRITE|mode,
+	    bufferevent_writecb, bufev);
+	event_base_set(base, &bufev->ev_read);
+	event_base_set(base, &bufev->ev_write);
+	event_priority_set(&bufev->ev_read, pri);
+	event_priority_set(&bufev->ev_write, pri);
+
+	if (bufev->enabled & EV_READ)
+		bufferevent_add(&bufev->ev_read, bufev->timeout_read);
+	if ((bufev->enabled & EV_WRITE) && EVBUFFER_LENGTH(bufev->output))
+		bufferevent_add(&bufev->ev_write, bufev->timeout_write);
+
+	return (0);
+}
+
 int
 bufferevent_priority_set(struct bufferevent *bufev, int priority)
 {
@@ -314,7 +429,7 @@ bufferevent_free(struct bufferevent *bufev)
 	evbuffer_free(bufev->input);
 	evbuffer_free(bufev->output);
 
-	free(bufev);
+	mm_free(bufev);
 }
 
 /*
@@ -342,11 +457,16 @@ bufferevent_write(struct bufferevent *bufev, const void *data, size_t size)
 int
 bufferevent_write_buffer(struct bufferevent *bufev, struct evbuffer *buf)
 {
+	size_t size = EVBUFFER_LENGTH(buf);
 	int res;
 
-	res = bufferevent_write(bufev, buf->buffer, buf->off);
-	if (res != -1)
-		evbuffer_drain(buf, buf->off);
+	res = evbuffer_add_buffer(bufev->output, buf);
+	if (res == -1)
+		return (res);
+
+	/* If everything is okay, we need to schedule a write */
+	if (size > 0 && (bufev->enabled & EV_WRITE))
+		bufferevent_add(&bufev->ev_write, bufev->timeout_write);
 
 	return (res);
 }
@@ -354,18 +474,8 @@ bufferevent_write_buffer(struct bufferevent *bufev, struct evbuffer *buf)
 size_t
 bufferevent_read(struct bufferevent *bufev, void *data, size_t size)
 {
-	struct evbuffer *buf = bufev->input;
-
-	if (buf->off < size)
-		size = buf->off;
-
 	/* Copy the available data to the user buffer */
-	memcpy(data, buf->buffer, size);
-
-	if (size)
-		evbuffer_drain(buf, size);
-
-	return (size);
+	return (evbuffer_remove(bufev->input, data, size));
 }
 
 int
@@ -450,6 +560,10 @@ bufferevent_base_set(struct event_base *base, struct bufferevent *bufev)
 	if (res == -1)
 		return (res);
 
+	res = evbuffer_defer_callbacks(bufev->input, base);
+	if (res == -1)
+		return (res);
+
 	res = event_base_set(base, &bufev->ev_write);
 	return (res);
 }
@@ -102,6 +102,8 @@
 #include "evdns.h"
 #include "evutil.h"
 #include "log.h"
+#define EVENT_MM_MODULE EVENT_MEM_DNS
+#include "mm-internal.h"
 #ifdef WIN32
 #include <winsock2.h>
 #include <windows.h>
@@ -572,13 +574,13 @@ request_finished(struct request *const req, struct request **head) {
 
 	if (!req->request_appended) {
 		/* need to free the request data on it's own */
-		free(req->request);
+		mm_free(req->request);
 	} else {
 		/* the request data is appended onto the header */
 		/* so everything gets free()ed when we: */
 	}
 
-	free(req);
+	mm_free(req);
 
 	evdns_requests_pump_waiting_queue();
 }
@@ -975,7 +977,7 @@ request_parse(u8 *packet, int length, struct evdns_server_port *port, struct soc
 	if (flags & 0x8000) return -1; /* Must not be an answer. */
 	flags &= 0x0110; /* Only RD and CD get preserved. */
 
-	server_req = malloc(sizeof(struct server_request));
+	server_req = mm_malloc(sizeof(struct server_request));
 	if (server_req == NULL) return -1;
 	memset(server_req, 0, sizeof(struct server_request));
 
@@ -985,7 +987,7 @@ request_parse(u8 *packet, int length, struct evdns_server_port *port, struct soc
 
 	server_req->base.flags = flags;
 	server_req->base.nquestions = 0;
-	server_req->base.questions = malloc(sizeof(struct evdns_server_question *) * questions);
+	server_req->base.questions = mm_malloc(sizeof(struct evdns_server_question *) * questions);
 	if (server_req->base.questions == NULL)
 		goto err;
 
@@ -998,7 +1000,7 @@ request_parse(u8 *packet, int length, struct evdns_server_port *port, struct soc
 		GET16(type);
 		GET16(class);
 		namelen = strlen(tmp_name);
-		q = malloc(sizeof(struct evdns_server_question) + namelen);
+		q = mm_malloc(sizeof(struct evdns_server_question) + namelen);
 		if (!q)
 			goto err;
 		q->type = type;
@@ -1025,10 +1027,10 @@ err:
 	if (server_req) {
 		if (server_req->base.questions) {
 			for (i = 0; i < server_req->base.nquestions; ++i)
-				free(server_req->base.questions[i]);
-			free(server_req->base.questions);
+				mm_free(server_req->base.questions[i]);
+			mm_free(server_req->base.questions);
 		}
-		free(server_req);
+		mm_free(server_req);
 	}
 	return -1;
 
@@ -1320,7 +1322,7 @@ dnslabel_clear(struct dnslabel_table *table)
 {
 	int i;
 	for (i = 0; i < table->n_labels; ++i)
-		free(table->labels[i].v);
+		mm_free(table->labels[i].v);
 	table->n_labels = 0;
 }
 
@@ -1345,7 +1347,7 @@ dnslabel_table_add(struct dnslabel_table *table, const char *label, off_t pos)
 	int p;
 	if (table->n_labels == MAX_LABELS)
 		return (-1);
-	v = strdup(label);
+	v = mm_strdup(label);
 	if (v == NULL)
 		return (-1);
 	p = table->n_labels++;
@@ -1478,7 +1480,7 @@ struct evdns_server_port *
 evdns_add_server_port(int socket, int is_tcp, evdns_request_callback_fn_type cb, void *user_data)
 {
 	struct evdns_server_port *port;
-	if (!(port = malloc(sizeof(struct evdns_server_port))))
+	if (!(port = mm_malloc(sizeof(struct evdns_server_port))))
 		return NULL;
 	memset(port, 0, sizeof(struct evdns_server_port));
 
@@ -1536,12 +1538,12 @@ evdns_server_request_add_reply(struct evdns_server_request *_req, int section, c
 	while (*itemp) {
 		itemp = &((*itemp)->next);
 	}
-	item = malloc(sizeof(struct server_reply_item));
+	item = mm_malloc(sizeof(struct server_reply_item));
 	if (!item)
 		return -1;
 	item->next = NULL;
-	if (!(item->name = strdup(name))) {
-		free(item);
+	if (!(item->name = mm_strdup(name))) {
+		mm_free(item);
 		return -1;
 	}
 	item->type = type;
@@ -1552,16 +1554,16 @@ evdns_server_request_add_reply(struct evdns_server_request *_req, int section, c
 	item->data = NULL;
 	if (data) {
 		if (item->is_name) {
-			if (!(item->data = strdup(data))) {
-				free(item->name);
-				free(item);
+			if (!(item->data = mm_strdup(data))) {
+				mm_free(item->name);
+				mm_free(item);
 				return -1;
 			}
 			item->datalen = (u16)-1;
 		} else {
-			if (!(item->data = malloc(datalen))) {
-				free(item->name);
-				free(item);
+			if (!(item->data = mm_malloc(datalen))) {
+				mm_free(item->name);
+				mm_free(item);
 				return -1;
 			}
 			item->datalen = datalen;
@@ -1710,7 +1712,7 @@ overflow:
 
 	req->response_len = j;
 
-	if (!(req->response = malloc(req->response_len))) {
+	if (!(req->response = mm_malloc(req->response_len))) {
 		server_request_free_answers(req);
 		dnslabel_clear(&table);
 		return (-1);
@@ -1787,10 +1789,10 @@ server_request_free_answers(struct server_request *req)
 		victim = *list;
 		while (victim) {
 			next = victim->next;
-			free(victim->name);
+			mm_free(victim->name);
 			if (victim->data)
-				free(victim->data);
-			free(victim);
+				mm_free(victim->data);
+			mm_free(victim);
 			victim = next;
 		}
 		*list = NULL;
@@ -1805,8 +1807,8 @@ server_request_free(struct server_request *req)
 	int i, rc=1;
 	if (req->base.questions) {
 		for (i = 0; i < req->base.nquestions; ++i)
-			free(req->base.questions[i]);
-		free(req->base.questions);
+			mm_free(req->base.questions[i]);
+		mm_free(req->base.questions);
 	}
 
 	if (req->port) {
@@ -1820,7 +1822,7 @@ server_request_free(struct server_request *req)
 	}
 
 	if (req->response) {
-		free(req->response);
+		mm_free(req->response);
 	}
 
 	server_request_free_answers(req);
@@ -1832,10 +1834,10 @@ server_request_free(struct server_request *req)
 
 	if (rc == 0) {
 		server_port_free(req->port);
-		free(req);
+		mm_free(req);
 		return (1);
 	}
-	free(req);
+	mm_free(req);
 	return (0);
 }
 
@@ -2065,7 +2067,7 @@ evdns_clear_nameservers_and_suspend(void)
 			(void) evtimer_del(&server->timeout_event);
 		if (server->socket >= 0)
 			CLOSE_SOCKET(server->socket);
-		free(server);
+		mm_free(server);
 		if (next == started_at)
 			break;
 		server = next;
@@ -2123,7 +2125,7 @@ _evdns_nameserver_add_impl(unsigned long int address, int port) {
 		} while (server != started_at);
 	}
 
-	ns = (struct nameserver *) malloc(sizeof(struct nameserver));
+	ns = (struct nameserver *) mm_malloc(sizeof(struct nameserver));
         if (!ns) return -1;
 
 	memset(ns, 0, sizeof(struct nameserver));
@@ -2165,7 +2167,7 @@ _evdns_nameserver_add_impl(unsigned long int address, int port) {
 out2:
 	CLOSE_SOCKET(ns->socket);
 out1:
-	free(ns);
+	mm_free(ns);
 	log(EVDNS_LOG_WARN, "Unable to add nameserver %s: error %d", debug_ntoa(address), err);
 	return err;
 }
@@ -2241,7 +2243,7 @@ request_new(int type, const char *name, int flags,
 	const u16 trans_id = issuing_now ? transaction_id_pick() : 0xffff;
 	/* the request data is alloced in a single block with the header */
 	struct request *const req =
-	    (struct request *) malloc(sizeof(struct request) + request_max_len);
+	    (struct request *) mm_malloc(sizeof(struct request) + request_max_len);
 	int rlen;
         (void) flags;
 
@@ -2269,7 +2271,7 @@ request_new(int type, const char *name, int flags,
 
 	return req;
 err1:
-	free(req);
+	mm_free(req);
 	return NULL;
 }
 
@@ -2397,15 +2399,15 @@ search_state_decref(struct search_state *const state) {
 		struct search_domain *next, *dom;
 		for (dom = state->head; dom; dom = next) {
 			next = dom->next;
-			free(dom);
+			mm_free(dom);
 		}
-		free(state);
+		mm_free(state);
 	}
 }
 
 static struct search_state *
 search_state_new(void) {
-	struct search_state *state = (struct search_state *) malloc(sizeof(struct search_state));
+	struct search_state *state = (struct search_state *) mm_malloc(sizeof(struct search_state));
         if (!state) return NULL;
 	memset(state, 0, sizeof(struct search_state));
 	state->refcount = 1;
@@ -2438,7 +2440,7 @@ search_postfix_add(const char *domain) {
         if (!global_search_state) return;
 	global_search_state->num_domains++;
 
-	sdomain = (struct search_domain *) malloc(sizeof(struct search_domain) + domain_len);
+	sdomain = (struct search_domain *) mm_malloc(sizeof(struct search_domain) + domain_len);
         if (!sdomain) return;
 	memcpy( ((u8 *) sdomain) + sizeof(struct search_domain), domain, domain_len);
 	sdomain->next = global_search_state->head;
@@ -2501,7 +2503,7 @@ search_make_new(const struct search_state *const state, int n, const char *const
 			/* the actual postfix string is kept at the end of the structure */
 			const u8 *const postfix = ((u8 *) dom) + sizeof(struct search_domain);
 			const int postfix_len = dom->len;
-			char *const newname = (char *) malloc(base_len + need_to_append_dot + postfix_len + 1);
+			char *const newname = (char *) mm_malloc(base_len + need_to_append_dot + postfix_len + 1);
                         if (!newname) return NULL;
 			memcpy(newname, base_name, base_len);
 			if (need_to_append_dot) newname[base_len] = '.';
@@ -2532,11 +2534,11 @@ search_request_new(int type, const char *const name, int flags, evdns_callback_t
 			char *const new_name = search_make_new(global_search_state, 0, name);
                         if (!new_name) return 1;
 			req = request_new(type, new_name, flags, user_callback, user_arg);
-			free(new_name);
+			mm_free(new_name);
 			if (!req) return 1;
 			req->search_index = 0;
 		}
-		req->search_origname = strdup(name);
+		req->search_origname = mm_strdup(name);
 		req->search_state = global_search_state;
 		req->search_flags = flags;
 		global_search_state->refcount++;
@@ -2581,7 +2583,7 @@ search_try_next(struct request *const req) {
                 if (!new_name) return 1;
 		log(EVDNS_LOG_DEBUG, "Search: now trying %s (%d)", new_name, req->search_index);
 		newreq = request_new(req->request_type, new_name, req->search_flags, req->user_callback, req->user_pointer);
-		free(new_name);
+		mm_free(new_name);
 		if (!newreq) return 1;
 		newreq->search_origname = req->search_origname;
 		req->search_origname = NULL;
@@ -2602,7 +2604,7 @@ search_request_finished(struct request *const req) {
 		req->search_state = NULL;
 	}
 	if (req->search_origname) {
-		free(req->search_origname);
+		mm_free(req->search_origname);
 		req->search_origname = NULL;
 	}
 }
@@ -2764,7 +2766,7 @@ evdns_resolv_conf_parse(int flags, const char *const filename) {
 	}
 	if (st.st_size > 65535) { err = 3; goto out1; }  /* no resolv.conf should be any bigger */
 
-	resolv = (u8 *) malloc((size_t)st.st_size + 1);
+	resolv = (u8 *) mm_malloc((size_t)st.st_size + 1);
 	if (!resolv) { err = 4; goto out1; }
 
 	n = 0;
@@ -2800,7 +2802,7 @@ evdns_resolv_conf_parse(int flags, const char *const filename) {
 	}
 
 out2:
-	free(resolv);
+	mm_free(resolv);
 out1:
 	close(fd);
 	return err;
@@ -2819,12 +2821,12 @@ evdns_nameserver_ip_add_line(const char *ips) {
 		addr = ips;
 		while (ISDIGIT(*ips) || *ips == '.' || *ips == ':')
 			++ips;
-		buf = malloc(ips-addr+1);
+		buf = mm_malloc(ips-addr+1);
 		if (!buf) return 4;
 		memcpy(buf, addr, ips-addr);
 		buf[ips-addr] = '\0';
 		r = evdns_nameserver_ip_add(buf);
-		free(buf);
+		mm_free(buf);
 		if (r) return r;
 	}
 	return 0;
@@ -2857,7 +2859,7 @@ load_nameservers_with_getnetworkparams(void)
 		goto done;
 	}
 
-	buf = malloc(size);
+	buf = mm_malloc(size);
 	if (!buf) { status = 4; goto done; }
 	fixed = buf;
 	r = fn(fixed, &size);
@@ -2866,8 +2868,8 @@ load_nameservers_with_getnetworkparams(void)
 		goto done;
 	}
 	if (r != ERROR_SUCCESS) {
-		free(buf);
-		buf = malloc(size);
+		mm_free(buf);
+		buf = mm_malloc(size);
 		if (!buf) { status = 4; goto done; }
 		fixed = buf;
 		r = fn(fixed, &size);
@@ -2903,7 +2905,7 @@ load_nameservers_with_getnetworkparams(void)
 
  done:
 	if (buf)
-		free(buf);
+		mm_free(buf);
 	if (handle)
 		FreeLibrary(handle);
 	return status;
@@ -2919,7 +2921,7 @@ config_nameserver_from_reg_key(HKEY key, const char *subkey)
 	if (RegQueryValueEx(key, subkey, 0, &type, NULL, &bufsz)
 	    != ERROR_MORE_DATA)
 		return -1;
-	if (!(buf = malloc(bufsz)))
+	if (!(buf = mm_malloc(bufsz)))
 		return -1;
 
 	if (RegQueryValueEx(key, subkey, 0, &type, (LPBYTE)buf, &bufsz)
@@ -2927,7 +2929,7 @@ config_nameserver_from_reg_key(HKEY key, const char *subkey)
 		status = evdns_nameserver_ip_add_line(buf);
 	}
 
-	free(buf);
+	mm_free(buf);
 	return status;
 }
 
@@ -3055,7 +3057,7 @@ evdns_shutdown(int fail_requests)
 		(void) event_del(&server->event);
 		if (server->state == 0)
                         (void) event_del(&server->timeout_event);
-		free(server);
+		mm_free(server);
 		if (server_next == server_head)
 			break;
 	}
@@ -3065,9 +3067,9 @@ evdns_shutdown(int fail_requests)
 	if (global_search_state) {
 		for (dom = global_search_state->head; dom; dom = dom_next) {
 			dom_next = dom->next;
-			free(dom);
+			mm_free(dom);
 		}
-		free(global_search_state);
+		mm_free(global_search_state);
 		global_search_state = NULL;
 	}
 	evdns_log_fn = NULL;
@@ -14,6 +14,9 @@
 /* Define is no secure id variant is available */
 /* #undef _EVENT_DNS_USE_GETTIMEOFDAY_FOR_ID */
 
+/* Define to 1 if you have the `accept4' function. */
+#define _EVENT_HAVE_ACCEPT4 1
+
 /* Define to 1 if you have the `clock_gettime' function. */
 #define _EVENT_HAVE_CLOCK_GETTIME 1
 
@@ -29,6 +32,9 @@
 /* Define to 1 if you have the `epoll_ctl' function. */
 #define _EVENT_HAVE_EPOLL_CTL 1
 
+/* Define to 1 if you have the `epoll_pwait2' function. */
+#define _EVENT_HAVE_EPOLL_PWAIT2 1
+
 /* Define if your system supports event ports */
 /* #undef _EVENT_HAVE_EVENT_PORTS */
 
@@ -62,6 +68,9 @@
 /* Define to 1 if you have the <inttypes.h> header file. */
 #define _EVENT_HAVE_INTTYPES_H 1
 
+/* Define if your system supports io_uring */
+#define _EVENT_HAVE_IO_URING 1
+
 /* Define to 1 if you have the `issetugid' function. */
 /* #undef _EVENT_HAVE_ISSETUGID */
 
@@ -74,12 +83,18 @@
 /* Define to 1 if you have the `resolv' library (-lresolv). */
 #define _EVENT_HAVE_LIBRESOLV 1
 
+/* Define to 1 if you have the `pthread' library (-lpthread). */
+#define _EVENT_HAVE_LIBPTHREAD 1
+
 /* Define to 1 if you have the `rt' library (-lrt). */
 #define _EVENT_HAVE_LIBRT 1
 
 /* Define to 1 if you have the `socket' library (-lsocket). */
 /* #undef _EVENT_HAVE_LIBSOCKET */
 
+/* Define to 1 if you have the <linux/io_uring.h> header file. */
+#define _EVENT_HAVE_LINUX_IO_URING_H 1
+
 /* Define to 1 if you have the <memory.h> header file. */
 #define _EVENT_HAVE_MEMORY_H 1
 
@@ -110,6 +125,9 @@
 /* Define to 1 if you have the `signal' function. */
 #define _EVENT_HAVE_SIGNAL 1
 
+/* Define to 1 if you have the <pthread.h> header file. */
+#define _EVENT_HAVE_PTHREAD_H 1
+
 /* Define to 1 if you have the <signal.h> header file. */
 #define _EVENT_HAVE_SIGNAL_H 1
 
@@ -149,6 +167,9 @@
 /* Define to 1 if you have the <sys/epoll.h> header file. */
 #define _EVENT_HAVE_SYS_EPOLL_H 1
 
+/* Define to 1 if you have the <sys/eventfd.h> header file. */
+#define _EVENT_HAVE_SYS_EVENTFD_H 1
+
 /* Define to 1 if you have the <sys/event.h> header file. */
 /* #undef _EVENT_HAVE_SYS_EVENT_H */
 
@@ -164,12 +185,18 @@
 /* Define to 1 if you have the <sys/select.h> header file. */
 #define _EVENT_HAVE_SYS_SELECT_H 1
 
+/* Define to 1 if you have the <sys/signalfd.h> header file. */
+#define _EVENT_HAVE_SYS_SIGNALFD_H 1
+
 /* Define to 1 if you have the <sys/socket.h> header file. */
 #define _EVENT_HAVE_SYS_SOCKET_H 1
 
 /* Define to 1 if you have the <sys/stat.h> header file. */
 #define _EVENT_HAVE_SYS_STAT_H 1
 
+/* Define to 1 if you have the <sys/timerfd.h> header file. */
+#define _EVENT_HAVE_SYS_TIMERFD_H 1
+
 /* Define to 1 if you have the <sys/time.h> header file. */
 #define _EVENT_HAVE_SYS_TIME_H 1
 
@@ -203,6 +230,9 @@
 /* Define to 1 if the system has the type `uint8_t'. */
 #define _EVENT_HAVE_UINT8_T 1
 
+/* Define to 1 if you have the <sys/uio.h> header file. */
+#define _EVENT_HAVE_SYS_UIO_H 1
+
 /* Define to 1 if you have the <unistd.h> header file. */
 #define _EVENT_HAVE_UNISTD_H 1
 
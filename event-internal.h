@@ -33,7 +33,9 @@ extern "C" {
 
 #include "config.h"
 #include "min_heap.h"
+#include "timer_wheel.h"
 #include "evsignal.h"
+#include "defer-internal.h"
 
 /*
  * 在libevent中，每种I/O demultiplex机制的实现都必须提供这五个函数接口，
@@ -46,11 +48,36 @@ struct eventop {
 	const char *name;
 	void *(*init)(struct event_base *);		//初始化
 	int (*add)(void *, struct event *);		//注册事件
-	int (*del)(void *, st uct event *);		//删除事件
+	int (*del)(void *, struct event *);		//删除事件
 	int (*dispatch)(struct event_base *, void *, struct timeval *);		//事件分发
 	void (*dealloc)(struct event_base *, void *);		//注销，释放资源
 	/* set if we need to reinitialize the event base */
 	int need_reinit;
+	/* EV_FEATURE_* flags of this mechanism */
+	int features;
+};
+
+/*
+ * Events added with a timeout returned by event_base_init_common_timeout()
+ * are kept in a FIFO per duration; only timeout_event, which fires when
+ * the head of the list expires, lives in the timer heap or wheel.
+ */
+struct common_timeout_list {
+	struct event_list events;
+	struct timeval duration;
+	struct event timeout_event;
+	struct event_base *base;
+};
+
+/*
+ * Loop statistics.  The loop thread makes seq odd while it updates them,
+ * so that other threads can take a consistent snapshot without a lock.
+ */
+struct event_stats_info {
+	volatile unsigned int seq;
+	struct event_base_stats stats;
+	struct event_stats_histogram *priority;	/* one per active queue */
+	int npriorities;
 };
 
 struct event_base {
@@ -67,6 +94,8 @@ struct event_base {
 	 * */
 	const struct eventop *evsel;
 	void *evbase;
+	/* EVBASE_* flags the base was created with */
+	int flags;
 
 	/* 
 	 * active event management 
@@ -75,6 +104,25 @@ struct event_base {
 	 * */
 	struct event_list **activequeues;
 	int nactivequeues;
+	/* callbacks per priority and pass, or NULL for strict priorities */
+	int *priority_budgets;
+	/* callbacks per pass before polling again, or 0 for no limit */
+	int max_callbacks;
+	/* ready fds a backend takes per wait, or 0 for no limit */
+	int max_dispatch_events;
+	/*
+	 * the event whose callback is running and the calls left for it;
+	 * event_del() zeroes current_ncalls to stop the repeated calls
+	 */
+	struct event *current_event;
+	short current_ncalls;
+	/* run after the active events; see defer-internal.h */
+	struct event_deferred_list deferred_queue;
+	int n_deferred;
+	/* see event_base_set_busy_poll(); busy_poll_gap is in microseconds */
+	int busy_poll_on;
+	struct timeval busy_poll_max;
+	long busy_poll_gap;
 	
 	/* 
 	 * eventqueue，链表，保存了所有的注册事件event的指针
@@ -100,12 +148,77 @@ struct event_base {
 
 	// timeheap是管理定时事件的小根堆，将在后面定时事件处理时专门讲解
 	struct min_heap timeheap;
+	/* replaces timeheap for bases created with EVBASE_TIMER_WHEEL */
+	struct timer_wheel *timewheel;
+	/* per-duration timeout queues, see event_base_init_common_timeout() */
+	struct common_timeout_list **common_timeout_queues;
+	int n_common_timeouts;
+	int n_common_timeouts_allocated;
+	/* set once running out of queues has been logged */
+	int common_timeouts_full;
+	/* see event_base_set_timer_slack() */
+	int timer_slack_on;
+	struct timeval timer_slack;
 
 	// vent_tv和tv_cache是libevent用于时间管理的变量
 	struct timeval event_tv;
 	struct timeval tv_cache;
+	/* wall clock minus tv_cache, resynchronized every CLOCK_SYNC_INTERVAL */
+	struct timeval tv_clock_diff;
+	time_t last_updated_clock_diff;
+	/* read CLOCK_MONOTONIC_COARSE; see EVBASE_COARSE_CLOCK */
+	int coarse_clock;
+
+	/* see event_base_enable_stats(); kept until the base is freed */
+	struct event_stats_info *stats;
+	int stats_on;
+
+	/* slots for event_new() and event_base_once() */
+	struct event_slab *slab;
+
+	/* see event_base_set_watchdog() */
+	int watchdog_on;
+	struct timeval watchdog_threshold;
+	event_watchdog_cb watchdog_cb;
+	void *watchdog_arg;
+
+	/* cross-thread notification: eventfd or socketpair read by th_notify */
+	int th_notify_fd[2];
+	struct event th_notify;
+	/* callbacks handed over by event_base_post(), most recent first */
+	struct event_post *volatile th_posted;
 };
 
+/*
+ * Atomic pointer primitives used by the lock-free post queue.  Producers
+ * need compare-and-swap to be a full barrier; the consumer only needs the
+ * exchange to have acquire semantics.
+ */
+#ifdef WIN32
+#define EV_ATOMIC_CAS_PTR(p, o, n)					\
+	InterlockedCompareExchangePointer((PVOID volatile *)(p), (n), (o))
+#define EV_ATOMIC_XCHG_PTR(p, n)					\
+	InterlockedExchangePointer((PVOID volatile *)(p), (n))
+#else
+#define EV_ATOMIC_CAS_PTR(p, o, n)	__sync_val_compare_and_swap((p), (o), (n))
+#define EV_ATOMIC_XCHG_PTR(p, n)	__sync_lock_test_and_set((p), (n))
+#endif
+
+/* Atomic addition to a 64-bit counter */
+#ifdef WIN32
+#define EV_ATOMIC_ADD64(p, v)						\
+	InterlockedExchangeAdd64((LONGLONG volatile *)(p), (LONGLONG)(v))
+#else
+#define EV_ATOMIC_ADD64(p, v)	__sync_fetch_and_add((p), (v))
+#endif
+
+/* Full memory barrier, for the sequence counter of the loop statistics */
+#ifdef WIN32
+#define EV_MEMORY_BARRIER()	MemoryBarrier()
+#else
+#define EV_MEMORY_BARRIER()	__sync_synchronize()
+#endif
+
 /* Internal use only: Functions that might be missing from <sys/queue.h> */
 #ifndef HAVE_TAILQFOREACH
 #define	TAILQ_FIRST(head)		((head)->tqh_first)
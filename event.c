@@ -45,6 +45,15 @@
 #ifndef WIN32
 #include <unistd.h>
 #endif
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
 #include <errno.h>
 #include <signal.h>
 #include <string.h>
@@ -55,6 +64,7 @@
 #include "event-internal.h"
 #include "evutil.h"
 #include "log.h"
+#include "mm-internal.h"
 
 #ifdef HAVE_EVENT_PORTS
 extern const struct eventop evportops;
@@ -65,6 +75,9 @@ extern const struct eventop selectops;
 #ifdef HAVE_POLL
 extern const struct eventop pollops;
 #endif
+#ifdef HAVE_IO_URING
+extern const struct eventop iouringops;
+#endif
 #ifdef HAVE_EPOLL
 extern const struct eventop epollops;
 #endif
@@ -89,6 +102,9 @@ static const struct eventop *eventops[] = {
 #ifdef HAVE_EPOLL
 	&epollops,
 #endif
+#ifdef HAVE_IO_URING
+	&iouringops,
+#endif
 #ifdef HAVE_DEVPOLL
 	&devpollops,
 #endif
@@ -104,6 +120,45 @@ static const struct eventop *eventops[] = {
 	NULL
 };
 
+#ifdef HAVE_SETFD
+#define FD_CLOSEONEXEC(x) do { \
+        if (fcntl(x, F_SETFD, 1) == -1) \
+                event_warn("fcntl(%d, F_SETFD)", x); \
+} while (0)
+#else
+#define FD_CLOSEONEXEC(x)
+#endif
+
+/* A callback handed over by event_base_post() */
+struct event_post {
+	struct event_post *next;
+	void (*cb)(void *);
+	void *arg;
+};
+
+/*
+ * The timeval handed out by event_base_init_common_timeout() carries
+ * COMMON_TIMEOUT_MAGIC and the index of its queue in the bits of tv_usec
+ * above the microseconds.  Events in a common timeout queue keep these
+ * bits in ev_timeout, so it has to be masked before it is used as a time.
+ */
+#define MICROSECONDS_MASK	0x000fffff
+#define COMMON_TIMEOUT_IDX_MASK	0x0ff00000
+#define COMMON_TIMEOUT_IDX_SHIFT	20
+#define COMMON_TIMEOUT_MASK	0xf0000000
+#define COMMON_TIMEOUT_MAGIC	0x50000000
+#define COMMON_TIMEOUT_IDX(tv) \
+	(((tv)->tv_usec & COMMON_TIMEOUT_IDX_MASK) >> COMMON_TIMEOUT_IDX_SHIFT)
+#define MAX_COMMON_TIMEOUTS	256
+
+/* seconds between two reads of the wall clock by the event loop */
+#define CLOCK_SYNC_INTERVAL	5
+
+/* outcome of a busy poll, for the loop statistics */
+#define BUSY_POLL_NONE		0
+#define BUSY_POLL_HIT		1
+#define BUSY_POLL_SLEEP		2
+
 /* Global state */
 struct event_base *current_base = NULL;
 extern struct event_base *evsignal_base;
@@ -115,11 +170,31 @@ static void	event_queue_remove(struct event_base *, struct event *, int);
 static int	event_haveevents(struct event_base *);
 
 static void	event_process_active(struct event_base *);
+static int	event_busy_poll_dispatch(struct event_base *,
+		    struct timeval *, int *);
 
+static int	timeout_empty(struct event_base *);
+static void	timeout_round_up(struct timeval *, const struct timeval *);
 static int	timeout_next(struct event_base *, struct timeval **);
 static void	timeout_process(struct event_base *);
 static void	timeout_correct(struct event_base *, struct timeval *);
 
+static int	is_common_timeout(const struct timeval *,
+		    const struct event_base *);
+static void	common_timeout_insert(struct event_base *, struct event *);
+static void	common_timeout_remove(struct event_base *, struct event *);
+
+static void	event_callback_timed(struct event_base *,
+		    struct event_slow_callback *, const struct timeval *);
+static void	event_stats_wait(struct event_base *, int, int);
+static void	event_stats_iteration(struct event_base *);
+
+static void	event_slab_release(struct event_slab *);
+
+static int	evthread_notify_init(struct event_base *);
+static void	evthread_notify_close(struct event_base *);
+static void	evthread_notify(struct event_base *);
+
 static void
 detect_monotonic(void)
 {
@@ -131,6 +206,25 @@ detect_monotonic(void)
 #endif
 }
 
+static int
+gettime_uncached(struct timeval *tp)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	if (use_monotonic) {
+		struct timespec	ts;
+
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+			return (-1);
+
+		tp->tv_sec = ts.tv_sec;
+		tp->tv_usec = ts.tv_nsec / 1000;
+		return (0);
+	}
+#endif
+
+	return (evutil_gettimeofday(tp, NULL));
+}
+
 static int
 gettime(struct event_base *base, struct timeval *tp)
 {
@@ -139,11 +233,11 @@ gettime(struct event_base *base, struct timeval *tp)
 		return (0);
 	}
 
-#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
-	if (use_monotonic) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC_COARSE)
+	if (base->coarse_clock) {
 		struct timespec	ts;
 
-		if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == -1)
 			return (-1);
 
 		tp->tv_sec = ts.tv_sec;
@@ -152,7 +246,59 @@ gettime(struct event_base *base, struct timeval *tp)
 	}
 #endif
 
-	return (evutil_gettimeofday(tp, NULL));
+	return (gettime_uncached(tp));
+}
+
+/* Remembers how far the wall clock is ahead of the clock read at now */
+static void
+update_clock_diff(struct event_base *base, const struct timeval *now)
+{
+	struct timeval tv;
+
+	if (!use_monotonic)
+		return;
+
+	evutil_gettimeofday(&tv, NULL);
+	evutil_timersub(&tv, now, &base->tv_clock_diff);
+	base->last_updated_clock_diff = now->tv_sec;
+}
+
+static int
+update_time_cache(struct event_base *base)
+{
+	base->tv_cache.tv_sec = 0;
+	if (gettime(base, &base->tv_cache) == -1) {
+		base->tv_cache.tv_sec = 0;
+		return (-1);
+	}
+
+	if (base->tv_cache.tv_sec >=
+	    base->last_updated_clock_diff + CLOCK_SYNC_INTERVAL)
+		update_clock_diff(base, &base->tv_cache);
+	return (0);
+}
+
+int
+event_base_gettimeofday_cached(struct event_base *base, struct timeval *tv)
+{
+	if (base == NULL)
+		base = current_base;
+	if (base == NULL || !base->tv_cache.tv_sec)
+		return (evutil_gettimeofday(tv, NULL));
+
+	if (use_monotonic)
+		evutil_timeradd(&base->tv_cache, &base->tv_clock_diff, tv);
+	else
+		*tv = base->tv_cache;
+	return (0);
+}
+
+int
+event_base_update_cache_time(struct event_base *base)
+{
+	if (!base->tv_cache.tv_sec)
+		return (0);
+	return (update_time_cache(base));
 }
 
 struct event_base *
@@ -168,20 +314,54 @@ event_init(void)
 
 struct event_base *
 event_base_new(void)
+{
+	return (event_base_new_with_flags(0));
+}
+
+struct event_base *
+event_base_new_with_flags(int flags)
 {
 	int i;
 	struct event_base *base;
 
-	if ((base = calloc(1, sizeof(struct event_base))) == NULL)
+	if ((base = mm_calloc(1, sizeof(struct event_base))) == NULL)
 		event_err(1, "%s: calloc", __func__);
 
+	if (evutil_getenv("EVENT_TIMER_WHEEL"))
+		flags |= EVBASE_TIMER_WHEEL;
+	if (evutil_getenv("EVENT_PRECISE_TIMER"))
+		flags |= EVBASE_PRECISE_TIMER;
+	if (evutil_getenv("EVENT_COARSE_CLOCK"))
+		flags |= EVBASE_COARSE_CLOCK;
+	if (evutil_getenv("EVENT_SIGNALFD"))
+		flags |= EVBASE_SIGNALFD;
+	base->flags = flags;
+
 	detect_monotonic();
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC_COARSE)
+	if (use_monotonic && (flags & EVBASE_COARSE_CLOCK) &&
+	    !(flags & EVBASE_PRECISE_TIMER)) {
+		struct timespec	ts;
+
+		if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0)
+			base->coarse_clock = 1;
+	}
+#endif
 	gettime(base, &base->event_tv);
+	update_clock_diff(base, &base->event_tv);
 	
 	min_heap_ctor(&base->timeheap);
+	if (flags & EVBASE_TIMER_WHEEL) {
+		base->timewheel = mm_malloc(sizeof(struct timer_wheel));
+		if (base->timewheel == NULL)
+			event_err(1, "%s: malloc", __func__);
+		timer_wheel_ctor(base->timewheel, &base->event_tv);
+	}
 	TAILQ_INIT(&base->eventqueue);
+	TAILQ_INIT(&base->deferred_queue);
 	base->sig.ev_signal_pair[0] = -1;
 	base->sig.ev_signal_pair[1] = -1;
+	base->sig.sigfd = -1;
 	
 	base->evbase = NULL;
 	for (i = 0; eventops[i] && !base->evbase; i++) {
@@ -200,6 +380,9 @@ event_base_new(void)
 	/* allocate a single active event queue */
 	event_base_priority_init(base, 1);
 
+	if (evthread_notify_init(base) == -1)
+		event_err(1, "%s: evthread_notify_init", __func__);
+
 	return (base);
 }
 
@@ -208,6 +391,8 @@ event_base_free(struct event_base *base)
 {
 	int i, n_deleted=0;
 	struct event *ev;
+	struct event_post *post;
+	struct event_deferred *d;
 
 	if (base == NULL && current_base)
 		base = current_base;
@@ -225,7 +410,22 @@ event_base_free(struct event_base *base)
 		}
 		ev = next;
 	}
-	while ((ev = min_heap_top(&base->timeheap)) != NULL) {
+	for (i = 0; i < base->n_common_timeouts; ++i) {
+		struct common_timeout_list *ctl =
+		    base->common_timeout_queues[i];
+		event_del(&ctl->timeout_event);
+		while ((ev = TAILQ_FIRST(&ctl->events)) != NULL) {
+			event_del(ev);
+			++n_deleted;
+		}
+		mm_free(ctl);
+	}
+	mm_free(base->common_timeout_queues);
+	base->common_timeout_queues = NULL;
+	base->n_common_timeouts = 0;
+	while ((ev = base->timewheel != NULL ?
+		timer_wheel_first(base->timewheel) :
+		min_heap_top(&base->timeheap)) != NULL) {
 		event_del(ev);
 		++n_deleted;
 	}
@@ -245,22 +445,45 @@ event_base_free(struct event_base *base)
 		event_debug(("%s: %d events were still set in base",
 			__func__, n_deleted));
 
+	/* callbacks that were posted but never ran are dropped */
+	post = EV_ATOMIC_XCHG_PTR(&base->th_posted, NULL);
+	while (post != NULL) {
+		struct event_post *next = post->next;
+		mm_free(post);
+		post = next;
+	}
+	while ((d = TAILQ_FIRST(&base->deferred_queue)) != NULL)
+		event_deferred_cancel(base, d);
+	if (base->th_notify_fd[0] != -1) {
+		event_del(&base->th_notify);
+		evthread_notify_close(base);
+	}
+
 	if (base->evsel->dealloc != NULL)
 		base->evsel->dealloc(base, base->evbase);
 
 	for (i = 0; i < base->nactivequeues; ++i)
 		assert(TAILQ_EMPTY(base->activequeues[i]));
 
-	assert(min_heap_empty(&base->timeheap));
+	assert(timeout_empty(base));
 	min_heap_dtor(&base->timeheap);
+	mm_free(base->timewheel);
+
+	if (base->stats != NULL) {
+		mm_free(base->stats->priority);
+		mm_free(base->stats);
+	}
+	mm_free(base->priority_budgets);
+	if (base->slab != NULL)
+		event_slab_release(base->slab);
 
 	for (i = 0; i < base->nactivequeues; ++i)
-		free(base->activequeues[i]);
-	free(base->activequeues);
+		mm_free(base->activequeues[i]);
+	mm_free(base->activequeues);
 
 	assert(TAILQ_EMPTY(&base->eventqueue));
 
-	free(base);
+	mm_free(base);
 }
 
 /* reinitialized the event base after a fork */
@@ -272,9 +495,37 @@ event_reinit(struct event_base *base)
 	int res = 0;
 	struct event *ev;
 
+	/* the child must not share the notification channel with its parent */
+	if (base->th_notify_fd[0] != -1) {
+		if (evsel->need_reinit) {
+			/* the backend is rebuilt below; see the signal case */
+			event_queue_remove(base, &base->th_notify,
+			    EVLIST_INSERTED);
+			if (base->th_notify.ev_flags & EVLIST_ACTIVE)
+				event_queue_remove(base, &base->th_notify,
+				    EVLIST_ACTIVE);
+		} else {
+			event_del(&base->th_notify);
+		}
+		evthread_notify_close(base);
+	}
+
 	/* check if this event mechanism requires reinit */
-	if (!evsel->need_reinit)
-		return (0);
+	if (!evsel->need_reinit) {
+		/* the child needs a signalfd of its own, see below */
+		if (base->sig.sigfd != -1) {
+			if (base->sig.ev_signal_added)
+				event_del(&base->sig.ev_signal);
+			if (evsignal_reopen(base) == -1)
+				res = -1;
+			if (base->sig.ev_signal_added &&
+			    event_add(&base->sig.ev_signal, NULL) == -1)
+				res = -1;
+		}
+		if (evthread_notify_init(base) == -1)
+			res = -1;
+		return (res);
+	}
 
 	/* prevent internal delete */
 	if (base->sig.ev_signal_added) {
@@ -287,6 +538,9 @@ event_reinit(struct event_base *base)
 			    EVLIST_ACTIVE);
 		base->sig.ev_signal_added = 0;
 	}
+	/* changing the mask of the inherited signalfd would affect the parent */
+	if (evsignal_reopen(base) == -1)
+		res = -1;
 	
 	if (base->evsel->dealloc != NULL)
 		base->evsel->dealloc(base, base->evbase);
@@ -300,9 +554,14 @@ event_reinit(struct event_base *base)
 			res = -1;
 	}
 
+	if (evthread_notify_init(base) == -1)
+		res = -1;
+
 	return (res);
 }
 
+static int	event_stats_alloc_priorities(struct event_base *);
+
 int
 event_priority_init(int npriorities)
 {
@@ -319,32 +578,171 @@ event_base_priority_init(struct event_base *base, int npriorities)
 
 	if (base->nactivequeues && npriorities != base->nactivequeues) {
 		for (i = 0; i < base->nactivequeues; ++i) {
-			free(base->activequeues[i]);
+			mm_free(base->activequeues[i]);
 		}
-		free(base->activequeues);
+		mm_free(base->activequeues);
+		/* the budgets were for the old priorities */
+		mm_free(base->priority_budgets);
+		base->priority_budgets = NULL;
 	}
 
 	/* Allocate our priority queues */
 	base->nactivequeues = npriorities;
 	base->activequeues = (struct event_list **)
-	    calloc(base->nactivequeues, sizeof(struct event_list *));
+	    mm_calloc(base->nactivequeues, sizeof(struct event_list *));
 	if (base->activequeues == NULL)
 		event_err(1, "%s: calloc", __func__);
 
 	for (i = 0; i < base->nactivequeues; ++i) {
-		base->activequeues[i] = malloc(sizeof(struct event_list));
+		base->activequeues[i] = mm_malloc(sizeof(struct event_list));
 		if (base->activequeues[i] == NULL)
 			event_err(1, "%s: malloc", __func__);
 		TAILQ_INIT(base->activequeues[i]);
 	}
 
+	if (base->stats != NULL && event_stats_alloc_priorities(base) == -1)
+		event_err(1, "%s: calloc", __func__);
+
+	return (0);
+}
+
+int
+event_base_set_priority_budgets(struct event_base *base, const int *budgets)
+{
+	int i, *copy;
+
+	if (budgets == NULL) {
+		mm_free(base->priority_budgets);
+		base->priority_budgets = NULL;
+		return (0);
+	}
+
+	for (i = 0; i < base->nactivequeues; ++i) {
+		if (budgets[i] < 0)
+			return (-1);
+	}
+	copy = mm_malloc(base->nactivequeues * sizeof(int));
+	if (copy == NULL) {
+		event_warn("%s: malloc", __func__);
+		return (-1);
+	}
+	memcpy(copy, budgets, base->nactivequeues * sizeof(int));
+	mm_free(base->priority_budgets);
+	base->priority_budgets = copy;
+	return (0);
+}
+
+int
+event_base_set_max_callbacks(struct event_base *base, int max)
+{
+	if (max < 0)
+		return (-1);
+	base->max_callbacks = max;
+	return (0);
+}
+
+int
+event_base_set_max_dispatch_events(struct event_base *base, int max)
+{
+	if (max < 0)
+		return (-1);
+	base->max_dispatch_events = max;
+	return (0);
+}
+
+int
+event_base_set_busy_poll(struct event_base *base,
+    const struct timeval *max_spin)
+{
+	if (max_spin == NULL || !evutil_timerisset(max_spin)) {
+		base->busy_poll_on = 0;
+		return (0);
+	}
+	if (max_spin->tv_sec < 0 || max_spin->tv_usec < 0 ||
+	    max_spin->tv_usec >= 1000000)
+		return (-1);
+
+	base->busy_poll_max = *max_spin;
+	base->busy_poll_gap = 0;
+	base->busy_poll_on = 1;
+	return (0);
+}
+
+/* Microseconds in tv, capped so that they fit into a long */
+static long
+busy_poll_usec(const struct timeval *tv)
+{
+	if (tv->tv_sec >= 1000)
+		return (1000L * 1000000L);
+	return (tv->tv_sec * 1000000L + tv->tv_usec);
+}
+
+/*
+ * Polls the backend without blocking for up to busy_poll_max before it
+ * waits, so that an event arriving soon is picked up without the cost of
+ * going to sleep and being woken up.  The time it took for events to show
+ * up is averaged over the recent passes; once that exceeds busy_poll_max,
+ * spinning would only burn CPU, and the base waits right away until
+ * arrivals speed up again.
+ */
+static int
+event_busy_poll_dispatch(struct event_base *base, struct timeval *tv,
+    int *outcome)
+{
+	const struct eventop *evsel = base->evsel;
+	struct timeval start, now, end, zero;
+	int nactive = base->event_count_active;
+	long max_usec = busy_poll_usec(&base->busy_poll_max);
+
+	*outcome = BUSY_POLL_NONE;
+	if (gettime_uncached(&start) == -1)
+		return (evsel->dispatch(base, base->evbase, tv));
+	now = start;
+
+	if (base->busy_poll_gap <= max_usec) {
+		if (tv != NULL && evutil_timercmp(tv, &base->busy_poll_max, <))
+			evutil_timeradd(&start, tv, &end);
+		else
+			evutil_timeradd(&start, &base->busy_poll_max, &end);
+
+		evutil_timerclear(&zero);
+		*outcome = BUSY_POLL_SLEEP;
+		do {
+			if (evsel->dispatch(base, base->evbase, &zero) == -1)
+				return (-1);
+			gettime_uncached(&now);
+			if (base->event_count_active > nactive) {
+				*outcome = BUSY_POLL_HIT;
+				break;
+			}
+		} while (evutil_timercmp(&now, &end, <));
+	}
+
+	if (*outcome != BUSY_POLL_HIT) {
+		if (tv != NULL) {
+			/* the spin used up part of the timeout */
+			struct timeval spent;
+
+			evutil_timersub(&now, &start, &spent);
+			if (evutil_timercmp(tv, &spent, >))
+				evutil_timersub(tv, &spent, tv);
+			else
+				evutil_timerclear(tv);
+		}
+		if (evsel->dispatch(base, base->evbase, tv) == -1)
+			return (-1);
+		gettime_uncached(&now);
+	}
+
+	evutil_timersub(&now, &start, &now);
+	base->busy_poll_gap += (busy_poll_usec(&now) - base->busy_poll_gap) / 4;
 	return (0);
 }
 
 int
 event_haveevents(struct event_base *base)
 {
-	return (base->event_count > 0);
+	return (base->event_count > 0 || base->n_deferred > 0);
 }
 
 /*
@@ -353,40 +751,157 @@ event_haveevents(struct event_base *base)
  * priority ones.
  */
 
-static void
-event_process_active(struct event_base *base)
+/*
+ * Runs the callbacks of the events on activeq, up to max of them unless
+ * max is 0.  Returns the number of callbacks run, or -1 if the loop was
+ * asked to break.
+ */
+static int
+event_process_queue(struct event_base *base, struct event_list *activeq,
+    int max)
 {
+	/* a callback may run a nested loop on this base: keep our frame */
+	struct event *saved_event = base->current_event;
+	short saved_ncalls = base->current_ncalls;
 	struct event *ev;
-	struct event_list *activeq = NULL;
-	int i;
-	short ncalls;
-
-	for (i = 0; i < base->nactivequeues; ++i) {
-		if (TAILQ_FIRST(base->activequeues[i]) != NULL) {
-			activeq = base->activequeues[i];
-			break;
-		}
-	}
-
-	assert(activeq != NULL);
+	int count = 0;
 
-	for (ev = TAILQ_FIRST(activeq); ev; ev = TAILQ_FIRST(activeq)) {
+	for (ev = TAILQ_FIRST(activeq); ev && (max == 0 || count < max);
+	    ev = TAILQ_FIRST(activeq)) {
 		if (ev->ev_events & EV_PERSIST)
 			event_queue_remove(base, ev, EVLIST_ACTIVE);
 		else
 			event_del(ev);
 		
 		/* Allows deletes to work */
-		ncalls = ev->ev_ncalls;
-		ev->ev_pncalls = &ncalls;
-		while (ncalls) {
-			ncalls--;
-			ev->ev_ncalls = ncalls;
-			(*ev->ev_callback)((int)ev->ev_fd, ev->ev_res, ev->ev_arg);
-			if (base->event_break)
-				return;
+		base->current_event = ev;
+		base->current_ncalls = ev->ev_ncalls;
+		while (base->current_ncalls) {
+			base->current_ncalls--;
+			ev->ev_ncalls = base->current_ncalls;
+			count++;
+			if (base->stats_on || base->watchdog_on) {
+				struct event_slow_callback info;
+				struct timeval start;
+
+				/* the callback may free the event */
+				info.callback = ev->ev_callback;
+				info.arg = ev->ev_arg;
+				info.fd = (int)ev->ev_fd;
+				info.events = ev->ev_events;
+				info.res = ev->ev_res;
+				info.priority = ev->ev_pri;
+
+				gettime_uncached(&start);
+				(*ev->ev_callback)((int)ev->ev_fd, ev->ev_res,
+				    ev->ev_arg);
+				event_callback_timed(base, &info, &start);
+			} else {
+				(*ev->ev_callback)((int)ev->ev_fd, ev->ev_res,
+				    ev->ev_arg);
+			}
+			if (base->event_break) {
+				count = -1;
+				goto done;
+			}
 		}
+		base->current_event = NULL;
 	}
+
+ done:
+	base->current_event = saved_event;
+	base->current_ncalls = saved_ncalls;
+	return (count);
+}
+
+static void
+event_process_queues(struct event_base *base)
+{
+	struct event_list *activeq = NULL;
+	int i, n, budget, left = base->max_callbacks;
+
+	if (base->priority_budgets == NULL) {
+		for (i = 0; i < base->nactivequeues; ++i) {
+			if (TAILQ_FIRST(base->activequeues[i]) != NULL) {
+				activeq = base->activequeues[i];
+				break;
+			}
+		}
+
+		assert(activeq != NULL);
+
+		event_process_queue(base, activeq, base->max_callbacks);
+		return;
+	}
+
+	/* every priority gets its share, so none of them can starve */
+	for (i = 0; i < base->nactivequeues; ++i) {
+		budget = base->priority_budgets[i];
+		if (left > 0 && (budget == 0 || budget > left))
+			budget = left;
+
+		n = event_process_queue(base, base->activequeues[i], budget);
+		if (n == -1)
+			return;
+		if (left > 0 && (left -= n) <= 0)
+			return;
+	}
+}
+
+void
+event_deferred_init(struct event_deferred *d, event_deferred_cb cb,
+    void *arg)
+{
+	memset(d, 0, sizeof(struct event_deferred));
+	d->cb = cb;
+	d->arg = arg;
+}
+
+void
+event_deferred_schedule(struct event_base *base, struct event_deferred *d)
+{
+	if (d->queued)
+		return;
+	d->queued = 1;
+	TAILQ_INSERT_TAIL(&base->deferred_queue, d, next);
+	base->n_deferred++;
+}
+
+void
+event_deferred_cancel(struct event_base *base, struct event_deferred *d)
+{
+	if (!d->queued)
+		return;
+	d->queued = 0;
+	TAILQ_REMOVE(&base->deferred_queue, d, next);
+	base->n_deferred--;
+}
+
+/*
+ * Runs the deferred callbacks that were queued when the pass started;
+ * those they schedule again wait for the next pass.
+ */
+static void
+event_process_deferred(struct event_base *base)
+{
+	struct event_deferred *d;
+	int n = base->n_deferred;
+
+	while (n-- > 0 && (d = TAILQ_FIRST(&base->deferred_queue)) != NULL) {
+		event_deferred_cancel(base, d);
+		(*d->cb)(d, d->arg);
+		if (base->event_break)
+			return;
+	}
+}
+
+static void
+event_process_active(struct event_base *base)
+{
+	if (base->event_count_active)
+		event_process_queues(base);
+	if (base->n_deferred && !base->event_break)
+		event_process_deferred(base);
 }
 
 /*
@@ -412,6 +927,244 @@ event_base_get_method(struct event_base *base)
 	return (base->evsel->name);
 }
 
+int
+event_base_get_features(struct event_base *base)
+{
+	assert(base);
+	return (base->evsel->features);
+}
+
+struct event_foreach_ctx {
+	struct event_base *base;
+	event_base_foreach_event_cb fn;
+	void *arg;
+	int flags;		/* lists visited before this one */
+};
+
+static int
+event_foreach_one(struct event *ev, void *arg)
+{
+	struct event_foreach_ctx *ctx = arg;
+
+	/* every event is reported once, from the first list it is on */
+	if ((ev->ev_flags & (ctx->flags | EVLIST_INTERNAL)) != 0)
+		return (0);
+	return ((*ctx->fn)(ctx->base, ev, ctx->arg));
+}
+
+int
+event_base_foreach_event(struct event_base *base,
+    event_base_foreach_event_cb fn, void *arg)
+{
+	struct event_foreach_ctx ctx;
+	struct event *ev;
+	unsigned int u;
+	int i, r;
+
+	ctx.base = base;
+	ctx.fn = fn;
+	ctx.arg = arg;
+
+	/* I/O and signal events, with or without a timeout */
+	ctx.flags = 0;
+	TAILQ_FOREACH(ev, &base->eventqueue, ev_next) {
+		if ((r = event_foreach_one(ev, &ctx)) != 0)
+			return (r);
+	}
+
+	/* pure timeouts */
+	ctx.flags = EVLIST_INSERTED;
+	if (base->timewheel != NULL) {
+		r = timer_wheel_foreach(base->timewheel, event_foreach_one,
+		    &ctx);
+		if (r != 0)
+			return (r);
+	} else {
+		for (u = 0; u < base->timeheap.n; ++u) {
+			r = event_foreach_one(base->timeheap.p[u], &ctx);
+			if (r != 0)
+				return (r);
+		}
+	}
+	for (i = 0; i < base->n_common_timeouts; ++i) {
+		struct common_timeout_list *ctl =
+		    base->common_timeout_queues[i];
+
+		TAILQ_FOREACH(ev, &ctl->events,
+		    ev_timeout_pos.ev_next_with_timeout) {
+			if ((r = event_foreach_one(ev, &ctx)) != 0)
+				return (r);
+		}
+	}
+
+	/* events that were made active without being added */
+	ctx.flags = EVLIST_INSERTED | EVLIST_TIMEOUT;
+	for (i = 0; i < base->nactivequeues; ++i) {
+		TAILQ_FOREACH(ev, base->activequeues[i], ev_active_next) {
+			if ((r = event_foreach_one(ev, &ctx)) != 0)
+				return (r);
+		}
+	}
+
+	return (0);
+}
+
+/* Events of one callback, for the summary of event_base_dump_events() */
+struct event_dump_summary {
+	void (*callback)(int, short, void *);
+	int nevents;
+	int nio;
+	int nsignals;
+	int ntimeouts;
+	int nactive;
+};
+
+struct event_dump_ctx {
+	FILE *output;
+	struct timeval now;
+	int summary_mode;
+	struct event_dump_summary *summary;	/* open addressing */
+	int nsummary;
+	int nsummary_alloc;			/* a power of two */
+};
+
+static unsigned int
+event_dump_hash(void (*callback)(int, short, void *))
+{
+	/* the low bits of code addresses are mostly the same */
+	return ((unsigned int)((size_t)callback >> 4));
+}
+
+static int
+event_dump_summary_add(struct event_dump_ctx *ctx, struct event *ev)
+{
+	struct event_dump_summary *s;
+	unsigned int h;
+	int i;
+
+	if (ctx->nsummary * 2 >= ctx->nsummary_alloc) {
+		struct event_dump_summary *old = ctx->summary;
+		int nold = ctx->nsummary_alloc;
+		int n = nold ? nold * 2 : 64;
+
+		s = mm_calloc(n, sizeof(struct event_dump_summary));
+		if (s == NULL)
+			return (-1);
+		ctx->summary = s;
+		ctx->nsummary_alloc = n;
+		for (i = 0; i < nold; ++i) {
+			if (old[i].callback == NULL)
+				continue;
+			h = event_dump_hash(old[i].callback);
+			while (s[h & (n - 1)].callback != NULL)
+				++h;
+			s[h & (n - 1)] = old[i];
+		}
+		mm_free(old);
+	}
+
+	h = event_dump_hash(ev->ev_callback);
+	for (;; ++h) {
+		s = &ctx->summary[h & (ctx->nsummary_alloc - 1)];
+		if (s->callback == ev->ev_callback)
+			break;
+		if (s->callback == NULL) {
+			s->callback = ev->ev_callback;
+			ctx->nsummary++;
+			break;
+		}
+	}
+
+	s->nevents++;
+	if (ev->ev_events & EV_SIGNAL)
+		s->nsignals++;
+	else if (ev->ev_events & (EV_READ|EV_WRITE))
+		s->nio++;
+	if (ev->ev_flags & EVLIST_TIMEOUT)
+		s->ntimeouts++;
+	if (ev->ev_flags & EVLIST_ACTIVE)
+		s->nactive++;
+	return (0);
+}
+
+static int
+event_dump_one(struct event_base *base, struct event *ev, void *arg)
+{
+	struct event_dump_ctx *ctx = arg;
+
+	if (ctx->summary_mode)
+		return (event_dump_summary_add(ctx, ev));
+
+	fprintf(ctx->output, "  %p [%s %d]%s%s%s%s%s%s pri %d cb %p arg %p",
+	    (void *)ev, (ev->ev_events & EV_SIGNAL) ? "sig" : "fd",
+	    (int)ev->ev_fd,
+	    (ev->ev_events & EV_READ) ? " Read" : "",
+	    (ev->ev_events & EV_WRITE) ? " Write" : "",
+	    (ev->ev_events & EV_SIGNAL) ? " Signal" : "",
+	    (ev->ev_events & EV_PERSIST) ? " Persist" : "",
+	    (ev->ev_events & EV_ET) ? " ET" : "",
+	    (ev->ev_events & EV_EXCLUSIVE) ? " Exclusive" : "",
+	    ev->ev_pri, (void *)ev->ev_callback, ev->ev_arg);
+	if (ev->ev_flags & EVLIST_TIMEOUT) {
+		struct timeval tv = ev->ev_timeout;
+
+		if (is_common_timeout(&tv, base))
+			tv.tv_usec &= MICROSECONDS_MASK;
+		evutil_timersub(&tv, &ctx->now, &tv);
+		fprintf(ctx->output, " timeout in %ld.%06lds",
+		    (long)tv.tv_sec, (long)tv.tv_usec);
+	}
+	if (ev->ev_flags & EVLIST_ACTIVE)
+		fprintf(ctx->output, " active (res 0x%x)", ev->ev_res);
+	fputc('\n', ctx->output);
+	return (0);
+}
+
+static int
+event_dump_summary_compare(const void *a, const void *b)
+{
+	const struct event_dump_summary *x = a, *y = b;
+
+	return (y->nevents - x->nevents);
+}
+
+void
+event_base_dump_events(struct event_base *base, FILE *output, int flags)
+{
+	struct event_dump_ctx ctx;
+	int i, n;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.output = output;
+	ctx.summary_mode = (flags & EVENT_DUMP_SUMMARY) != 0;
+	gettime(base, &ctx.now);
+
+	fprintf(output, "Events of base %p (%s), %d added, %d active:\n",
+	    (void *)base, base->evsel->name, base->event_count,
+	    base->event_count_active);
+
+	if (event_base_foreach_event(base, event_dump_one, &ctx) == -1)
+		fprintf(output, "  out of memory\n");
+
+	if (ctx.summary == NULL)
+		return;
+
+	/* move the used entries to the front, busiest callback first */
+	for (i = n = 0; i < ctx.nsummary_alloc; ++i) {
+		if (ctx.summary[i].callback != NULL)
+			ctx.summary[n++] = ctx.summary[i];
+	}
+	qsort(ctx.summary, n, sizeof(struct event_dump_summary),
+	    event_dump_summary_compare);
+	for (i = 0; i < n; ++i) {
+		struct event_dump_summary *s = &ctx.summary[i];
+		fprintf(output, "  cb %p: %d events, %d I/O, %d signals, "
+		    "%d with timeout, %d active\n", (void *)s->callback,
+		    s->nevents, s->nio, s->nsignals, s->ntimeouts, s->nactive);
+	}
+	mm_free(ctx.summary);
+}
+
 static void
 event_loopexit_cb(int fd, short what, void *arg)
 {
@@ -448,6 +1201,8 @@ event_base_loopbreak(struct event_base *event_base)
 		return (-1);
 
 	event_base->event_break = 1;
+	/* the loop may be sleeping in another thread */
+	evthread_notify(event_base);
 	return (0);
 }
 
@@ -526,7 +1281,7 @@ event_base_loop(struct event_base *base, int flags)
 
 	struct timeval tv;
 	struct timeval *tv_p;
-	int res, done;
+	int res, done, nactive, spin;
 
 	/* 
 	 * clear time cache 
@@ -538,7 +1293,7 @@ event_base_loop(struct event_base *base, int flags)
 	/*
 	 * evsignal_base是全局变量，在处理signal时，用于指名signal所属的event_base实例
 	 * */
-	if (base->sig.ev_signal_added)
+	if (base->sig.ev_signal_added && base->sig.sigfd == -1)
 		evsignal_base = base;
 
 	/* 事件主循环 */
@@ -576,7 +1331,8 @@ event_base_loop(struct event_base *base, int flags)
 		 * base->event_count_active 表示就绪事件的数量
 		 * */
 		tv_p = &tv;
-		if (!base->event_count_active && !(flags & EVLOOP_NONBLOCK)) {
+		if (!base->event_count_active && !base->n_deferred &&
+		    !(flags & EVLOOP_NONBLOCK)) {
 			// 根据Timer事件计算evsel->dispatch的最大等待时间
 			timeout_next(base, &tv_p);
 		} else {
@@ -617,13 +1373,19 @@ event_base_loop(struct event_base *base, int flags)
 		 * 调用系统I/O demultiplexer等待就绪I/O events，可能是epoll_wait，或者select等；
 		 * 在evsel->dispatch()中，会把就绪signal event、I/O event插入到激活链表中
 		 * */
-		res = evsel->dispatch(base, evbase, tv_p);
+		nactive = base->event_count_active;
+		spin = BUSY_POLL_NONE;
+		if (base->busy_poll_on &&
+		    (tv_p == NULL || evutil_timerisset(tv_p)))
+			res = event_busy_poll_dispatch(base, tv_p, &spin);
+		else
+			res = evsel->dispatch(base, evbase, tv_p);
 
 		if (res == -1)
 			return (-1);
 		
 		/* 将time cache赋值为当前系统时间 */
-		gettime(base, &base->tv_cache);
+		update_time_cache(base);
 
 		/* 
 		 * 检查heap中的timer events，将就绪的timer event从heap上删除，并插入到激活链表中 
@@ -632,19 +1394,26 @@ event_base_loop(struct event_base *base, int flags)
 		 * */
 		timeout_process(base);
 
+		if (base->stats_on)
+			event_stats_wait(base, nactive, spin);
+
 		/* 
 		 * 调用event_process_active()处理激活链表中的就绪event，调用其回调函数执行事件处理
 		 * 该函数会寻找最高优先级（priority值越小优先级越高）的激活事件链表，
 		 * 然后处理链表中的所有就绪事件；
 		 * 因此低优先级的就绪事件可能得不到及时处理；
 		 * */
-		if (base->event_count_active) {
+		if (base->event_count_active || base->n_deferred) {
 			// 处理激活链表中的就绪event，调用其回调函数执行事件处理
 			event_process_active(base);
-			if (!base->event_count_active && (flags & EVLOOP_ONCE))
+			if (!base->event_count_active && !base->n_deferred &&
+			    (flags & EVLOOP_ONCE))
 				done = 1;
 		} else if (flags & EVLOOP_NONBLOCK)
 			done = 1;
+
+		if (base->stats_on)
+			event_stats_iteration(base);
 	}
 
 	/* clear time cache  循环结束，清空时间缓存 */
@@ -663,70 +1432,570 @@ struct event_once {
 	void *arg;
 };
 
-/* One-time callback, it deletes itself */
+/*
+ * Events from event_new() and event_base_once() come from a slab that
+ * belongs to the base: chunks of cache line aligned slots, with the free
+ * slots on a list.  Each slot remembers its slab, so that event_free()
+ * works even after event_base_set() moved the event to another base.
+ * A base that is freed while some of its slots are still in use leaves
+ * the slab to the last event_free().
+ */
+#define EVENT_SLAB_ALIGN	64
+#define EVENT_SLAB_CHUNK	64	/* slots per chunk */
+
+struct event_slab;
+
+struct event_slot {
+	union {
+		struct event ev;
+		struct event_once once;
+		struct event_slot *next_free;
+	} u;
+	struct event_slab *slab;
+};
+
+#define EVENT_SLOT_SIZE							\
+	((sizeof(struct event_slot) + EVENT_SLAB_ALIGN - 1) &		\
+	    ~(size_t)(EVENT_SLAB_ALIGN - 1))
+
+struct event_slab {
+	struct event_slot *free_list;
+	void *chunks;		/* linked through their first word */
+	int nused;
+	int orphaned;		/* the base is gone */
+};
+
+static void
+event_slab_destroy(struct event_slab *slab)
+{
+	void *chunk, *next;
+
+	for (chunk = slab->chunks; chunk != NULL; chunk = next) {
+		next = *(void **)chunk;
+		mm_free(chunk);
+	}
+	mm_free(slab);
+}
+
+/* Called when the base goes; events from event_new() may outlive it */
+static void
+event_slab_release(struct event_slab *slab)
+{
+	if (slab->nused == 0)
+		event_slab_destroy(slab);
+	else
+		slab->orphaned = 1;
+}
+
+static void *
+event_slab_alloc(struct event_base *base)
+{
+	struct event_slab *slab = base->slab;
+	struct event_slot *slot;
+
+	if (slab == NULL) {
+		if ((slab = mm_calloc(1, sizeof(struct event_slab))) == NULL)
+			return (NULL);
+		base->slab = slab;
+	}
+
+	if (slab->free_list == NULL) {
+		char *chunk, *p;
+		int i;
+
+		chunk = mm_malloc(EVENT_SLAB_ALIGN +
+		    EVENT_SLAB_CHUNK * EVENT_SLOT_SIZE);
+		if (chunk == NULL)
+			return (NULL);
+		*(void **)chunk = slab->chunks;
+		slab->chunks = chunk;
+
+		/* the first slot starts at the first boundary after the link */
+		p = chunk + EVENT_SLAB_ALIGN -
+		    ((uintptr_t)chunk & (EVENT_SLAB_ALIGN - 1));
+		for (i = EVENT_SLAB_CHUNK - 1; i >= 0; i--) {
+			slot = (struct event_slot *)(p + i * EVENT_SLOT_SIZE);
+			slot->u.next_free = slab->free_list;
+			slab->free_list = slot;
+		}
+	}
+
+	slot = slab->free_list;
+	slab->free_list = slot->u.next_free;
+	memset(slot, 0, sizeof(struct event_slot));
+	slot->slab = slab;
+	slab->nused++;
+
+	return (slot);
+}
+
+static void
+event_slab_free(void *p)
+{
+	struct event_slot *slot = p;
+	struct event_slab *slab = slot->slab;
+
+	slot->u.next_free = slab->free_list;
+	slab->free_list = slot;
+	if (--slab->nused == 0 && slab->orphaned)
+		event_slab_destroy(slab);
+}
+
+struct event *
+event_new(struct event_base *base, int fd, short events,
+    void (*callback)(int, short, void *), void *arg)
+{
+	struct event *ev;
+
+	if (base == NULL && (base = current_base) == NULL)
+		return (NULL);
+	if ((ev = event_slab_alloc(base)) == NULL) {
+		event_warn("%s: malloc", __func__);
+		return (NULL);
+	}
+
+	event_set(ev, fd, events, callback, arg);
+	event_base_set(base, ev);
+
+	return (ev);
+}
+
+void
+event_free(struct event *ev)
+{
+	/* the base may be gone already if the event is not pending */
+	if (ev->ev_flags & (EVLIST_INSERTED|EVLIST_ACTIVE|EVLIST_TIMEOUT))
+		event_del(ev);
+	event_slab_free(ev);
+}
+
+/* One-time callback, it deletes itself */
+
+static void
+event_once_cb(int fd, short events, void *arg)
+{
+	struct event_once *eonce = arg;
+
+	(*eonce->cb)(fd, events, eonce->arg);
+	event_slab_free(eonce);
+}
+
+/* not threadsafe, event scheduled once. */
+int
+event_once(int fd, short events,
+    void (*callback)(int, short, void *), void *arg, const struct timeval *tv)
+{
+	return event_base_once(current_base, fd, events, callback, arg, tv);
+}
+
+/* Schedules an event once */
+int
+event_base_once(struct event_base *base, int fd, short events,
+    void (*callback)(int, short, void *), void *arg, const struct timeval *tv)
+{
+	struct event_once *eonce;
+	struct timeval etv;
+	int res;
+
+	/* We cannot support signals that just fire once */
+	if (events & EV_SIGNAL)
+		return (-1);
+
+	if ((eonce = event_slab_alloc(base)) == NULL)
+		return (-1);
+
+	eonce->cb = callback;
+	eonce->arg = arg;
+
+	if (events == EV_TIMEOUT) {
+		if (tv == NULL) {
+			evutil_timerclear(&etv);
+			tv = &etv;
+		}
+
+		evtimer_set(&eonce->ev, event_once_cb, eonce);
+	} else if (events & (EV_READ|EV_WRITE)) {
+		events &= EV_READ|EV_WRITE;
+
+		event_set(&eonce->ev, fd, events, event_once_cb, eonce);
+	} else {
+		/* Bad event combination */
+		event_slab_free(eonce);
+		return (-1);
+	}
+
+	res = event_base_set(base, &eonce->ev);
+	if (res == 0)
+		res = event_add(&eonce->ev, tv);
+	if (res != 0) {
+		event_slab_free(eonce);
+		return (res);
+	}
+
+	return (0);
+}
+
+/*
+ * Cross-thread notification.  Other threads wake up the loop by writing to
+ * th_notify_fd[1]; the loop reads th_notify_fd[0] through the internal
+ * th_notify event and then runs every callback handed to event_base_post().
+ *
+ * Posted callbacks are pushed onto a lock-free LIFO stack.  The loop takes
+ * the whole stack with a single exchange and reverses it, so callbacks still
+ * run in the order they were posted.  Only the producer that finds the
+ * stack empty needs to wake up the loop; everybody else piggy-backs on the
+ * wakeup that is already pending.
+ */
+
+static void
+evthread_notify_drain_cb(int fd, short what, void *arg)
+{
+	struct event_base *base = arg;
+	struct event_post *post, *next, *fifo = NULL;
+	unsigned char buf[128];
+
+#ifdef HAVE_SYS_EVENTFD_H
+	if (base->th_notify_fd[1] == -1) {
+		ev_uint64_t count;
+		if (read(fd, &count, sizeof(count)) == -1 && errno != EAGAIN)
+			event_warn("%s: read", __func__);
+	} else
+#endif
+	while (recv(fd, (char *)buf, sizeof(buf), 0) > 0)
+		;
+
+	post = EV_ATOMIC_XCHG_PTR(&base->th_posted, NULL);
+	for (; post != NULL; post = next) {
+		next = post->next;
+		post->next = fifo;
+		fifo = post;
+	}
+
+	for (post = fifo; post != NULL; post = next) {
+		next = post->next;
+		(*post->cb)(post->arg);
+		mm_free(post);
+	}
+}
+
+static int
+evthread_notify_init(struct event_base *base)
+{
+	base->th_notify_fd[0] = base->th_notify_fd[1] = -1;
+
+#ifdef HAVE_SYS_EVENTFD_H
+	base->th_notify_fd[0] = eventfd(0, 0);
+	if (base->th_notify_fd[0] != -1) {
+		FD_CLOSEONEXEC(base->th_notify_fd[0]);
+		evutil_make_socket_nonblocking(base->th_notify_fd[0]);
+	}
+#endif
+
+	/* fall back to the same trick that signal.c uses */
+	if (base->th_notify_fd[0] == -1) {
+		if (evutil_socketpair(AF_UNIX, SOCK_STREAM, 0,
+			base->th_notify_fd) == -1) {
+			event_warn("%s: socketpair", __func__);
+			return (-1);
+		}
+		FD_CLOSEONEXEC(base->th_notify_fd[0]);
+		FD_CLOSEONEXEC(base->th_notify_fd[1]);
+		evutil_make_socket_nonblocking(base->th_notify_fd[0]);
+		evutil_make_socket_nonblocking(base->th_notify_fd[1]);
+	}
+
+	event_set(&base->th_notify, base->th_notify_fd[0],
+	    EV_READ | EV_PERSIST, evthread_notify_drain_cb, base);
+	event_base_set(base, &base->th_notify);
+	base->th_notify.ev_flags |= EVLIST_INTERNAL;
+	base->th_notify.ev_pri = 0;
+
+	if (event_add(&base->th_notify, NULL) == -1) {
+		evthread_notify_close(base);
+		return (-1);
+	}
+
+	return (0);
+}
+
+static void
+evthread_notify_close(struct event_base *base)
+{
+	if (base->th_notify_fd[0] != -1)
+		EVUTIL_CLOSESOCKET(base->th_notify_fd[0]);
+	if (base->th_notify_fd[1] != -1)
+		EVUTIL_CLOSESOCKET(base->th_notify_fd[1]);
+	base->th_notify_fd[0] = base->th_notify_fd[1] = -1;
+}
+
+/* Safe to call from any thread and from signal handlers. */
+static void
+evthread_notify(struct event_base *base)
+{
+	int save_errno = errno;
+
+#ifdef HAVE_SYS_EVENTFD_H
+	if (base->th_notify_fd[1] == -1) {
+		ev_uint64_t one = 1;
+		if (base->th_notify_fd[0] != -1)
+			(void)write(base->th_notify_fd[0], &one, sizeof(one));
+		errno = save_errno;
+		return;
+	}
+#endif
+	/* a full socket buffer means that a wakeup is already pending */
+	send(base->th_notify_fd[1], "a", 1, 0);
+	errno = save_errno;
+}
+
+int
+event_base_post(struct event_base *base, void (*cb)(void *), void *arg)
+{
+	struct event_post *post, *head;
+
+	if (base == NULL || cb == NULL)
+		return (-1);
+
+	if ((post = mm_malloc(sizeof(struct event_post))) == NULL)
+		return (-1);
+	post->cb = cb;
+	post->arg = arg;
+
+	do {
+		head = base->th_posted;
+		post->next = head;
+	} while (EV_ATOMIC_CAS_PTR(&base->th_posted, head, post) != head);
+
+	if (head == NULL)
+		evthread_notify(base);
+
+	return (0);
+}
+
+/*
+ * Loop statistics
+ */
+
+static int
+event_stats_alloc_priorities(struct event_base *base)
+{
+	struct event_stats_info *info = base->stats;
+	struct event_stats_histogram *priority;
+
+	if (info->npriorities == base->nactivequeues)
+		return (0);
+
+	priority = mm_calloc(base->nactivequeues,
+	    sizeof(struct event_stats_histogram));
+	if (priority == NULL)
+		return (-1);
+	mm_free(info->priority);
+	info->priority = priority;
+	info->npriorities = base->nactivequeues;
+	return (0);
+}
+
+int
+event_base_enable_stats(struct event_base *base, int on)
+{
+	struct event_stats_info *info = base->stats;
+
+	if (!on) {
+		base->stats_on = 0;
+		return (0);
+	}
+
+	if (info == NULL) {
+		if ((info = mm_calloc(1, sizeof(struct event_stats_info))) == NULL) {
+			event_warn("%s: calloc", __func__);
+			return (-1);
+		}
+		base->stats = info;
+	}
+	if (event_stats_alloc_priorities(base) == -1) {
+		event_warn("%s: calloc", __func__);
+		return (-1);
+	}
+
+	info->seq++;
+	EV_MEMORY_BARRIER();
+	memset(&info->stats, 0, sizeof(info->stats));
+	memset(info->priority, 0,
+	    info->npriorities * sizeof(struct event_stats_histogram));
+	EV_MEMORY_BARRIER();
+	info->seq++;
+
+	base->stats_on = 1;
+	return (0);
+}
+
+static void
+event_stats_record(struct event_stats_histogram *hist,
+    const struct timeval *tv)
+{
+	ev_uint64_t usec, v;
+	int bucket = 0;
+
+	if (tv->tv_sec < 0)
+		usec = 0;
+	else
+		usec = (ev_uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+
+	for (v = usec; v != 0 && bucket < EVENT_STATS_NBUCKETS - 1; v >>= 1)
+		bucket++;
+
+	hist->count++;
+	hist->total_usec += usec;
+	if (usec > hist->max_usec)
+		hist->max_usec = usec;
+	hist->buckets[bucket]++;
+}
+
+static void
+event_stats_callback(struct event_base *base,
+    const struct event_slow_callback *info)
+{
+	struct event_stats_info *stats = base->stats;
+
+	stats->seq++;
+	EV_MEMORY_BARRIER();
+	stats->stats.callbacks++;
+	event_stats_record(&stats->stats.callback, &info->duration);
+	if (info->priority < stats->npriorities)
+		event_stats_record(&stats->priority[info->priority],
+		    &info->duration);
+	EV_MEMORY_BARRIER();
+	stats->seq++;
+}
+
+/* Records the wait that ended with tv_cache, what it activated and spun */
+static void
+event_stats_wait(struct event_base *base, int nactive, int spin)
+{
+	struct event_stats_info *info = base->stats;
+	struct timeval tv;
+
+	evutil_timersub(&base->tv_cache, &base->event_tv, &tv);
+
+	info->seq++;
+	EV_MEMORY_BARRIER();
+	if (base->event_count_active > nactive)
+		info->stats.activated += base->event_count_active - nactive;
+	if (spin == BUSY_POLL_HIT)
+		info->stats.spin_hits++;
+	else if (spin == BUSY_POLL_SLEEP)
+		info->stats.spin_sleeps++;
+	event_stats_record(&info->stats.wait, &tv);
+	EV_MEMORY_BARRIER();
+	info->seq++;
+}
 
 static void
-event_once_cb(int fd, short events, void *arg)
+event_stats_iteration(struct event_base *base)
 {
-	struct event_once *eonce = arg;
+	struct event_stats_info *info = base->stats;
+	struct timeval now;
 
-	(*eonce->cb)(fd, events, eonce->arg);
-	free(eonce);
+	gettime_uncached(&now);
+	evutil_timersub(&now, &base->tv_cache, &now);
+
+	info->seq++;
+	EV_MEMORY_BARRIER();
+	info->stats.iterations++;
+	event_stats_record(&info->stats.iteration, &now);
+	info->stats.nevents = base->event_count;
+	info->stats.nactive = base->event_count_active;
+	info->stats.ntimers = base->timewheel != NULL ?
+	    (int)timer_wheel_size(base->timewheel) :
+	    (int)min_heap_size(&base->timeheap);
+	EV_MEMORY_BARRIER();
+	info->seq++;
 }
 
-/* not threadsafe, event scheduled once. */
-int
-event_once(int fd, short events,
-    void (*callback)(int, short, void *), void *arg, const struct timeval *tv)
+/* Copies statistics from src once the loop is not updating them */
+static void
+event_stats_snapshot(struct event_stats_info *info, void *dst,
+    const void *src, size_t len)
 {
-	return event_base_once(current_base, fd, events, callback, arg, tv);
+	unsigned int seq;
+
+	do {
+		while ((seq = info->seq) & 1)
+			;
+		EV_MEMORY_BARRIER();
+		memcpy(dst, src, len);
+		EV_MEMORY_BARRIER();
+	} while (info->seq != seq);
 }
 
-/* Schedules an event once */
 int
-event_base_once(struct event_base *base, int fd, short events,
-    void (*callback)(int, short, void *), void *arg, const struct timeval *tv)
+event_base_get_stats(struct event_base *base, struct event_base_stats *stats)
 {
-	struct event_once *eonce;
-	struct timeval etv;
-	int res;
-
-	/* We cannot support signals that just fire once */
-	if (events & EV_SIGNAL)
+	if (base->stats == NULL)
 		return (-1);
+	event_stats_snapshot(base->stats, stats, &base->stats->stats,
+	    sizeof(struct event_base_stats));
+	return (0);
+}
 
-	if ((eonce = calloc(1, sizeof(struct event_once))) == NULL)
+int
+event_base_get_priority_stats(struct event_base *base, int priority,
+    struct event_stats_histogram *hist)
+{
+	if (base->stats == NULL || priority < 0 ||
+	    priority >= base->stats->npriorities)
 		return (-1);
+	event_stats_snapshot(base->stats, hist,
+	    &base->stats->priority[priority],
+	    sizeof(struct event_stats_histogram));
+	return (0);
+}
 
-	eonce->cb = callback;
-	eonce->arg = arg;
-
-	if (events == EV_TIMEOUT) {
-		if (tv == NULL) {
-			evutil_timerclear(&etv);
-			tv = &etv;
-		}
+int
+event_base_set_watchdog(struct event_base *base,
+    const struct timeval *threshold, event_watchdog_cb cb, void *arg)
+{
+	if (threshold == NULL) {
+		base->watchdog_on = 0;
+		return (0);
+	}
 
-		evtimer_set(&eonce->ev, event_once_cb, eonce);
-	} else if (events & (EV_READ|EV_WRITE)) {
-		events &= EV_READ|EV_WRITE;
+	base->watchdog_threshold = *threshold;
+	base->watchdog_cb = cb;
+	base->watchdog_arg = arg;
+	base->watchdog_on = 1;
+	return (0);
+}
 
-		event_set(&eonce->ev, fd, events, event_once_cb, eonce);
-	} else {
-		/* Bad event combination */
-		free(eonce);
-		return (-1);
+static void
+event_watchdog_report(struct event_base *base,
+    const struct event_slow_callback *info)
+{
+	if (base->watchdog_cb != NULL) {
+		(*base->watchdog_cb)(base, info, base->watchdog_arg);
+		return;
 	}
 
-	res = event_base_set(base, &eonce->ev);
-	if (res == 0)
-		res = event_add(&eonce->ev, tv);
-	if (res != 0) {
-		free(eonce);
-		return (res);
-	}
+	event_warnx("slow callback %p(%d, 0x%x, %p) for events 0x%x "
+	    "ran for %ld.%06ld seconds",
+	    (void *)info->callback, info->fd, info->res, info->arg,
+	    info->events, (long)info->duration.tv_sec,
+	    (long)info->duration.tv_usec);
+}
 
-	return (0);
+/* Accounts for a callback that was started at start */
+static void
+event_callback_timed(struct event_base *base, struct event_slow_callback *info,
+    const struct timeval *start)
+{
+	gettime_uncached(&info->duration);
+	evutil_timersub(&info->duration, start, &info->duration);
+
+	if (base->stats_on)
+		event_stats_callback(base, info);
+	if (base->watchdog_on &&
+	    !evutil_timercmp(&info->duration, &base->watchdog_threshold, <))
+		event_watchdog_report(base, info);
 }
 
 void
@@ -743,7 +2012,6 @@ event_set(struct event *ev, int fd, short events,
 	ev->ev_res = 0;
 	ev->ev_flags = EVLIST_INIT;
 	ev->ev_ncalls = 0;
-	ev->ev_pncalls = NULL;
 
 	min_heap_elem_init(ev);
 
@@ -804,10 +2072,14 @@ event_pending(struct event *ev, short event, struct timeval *tv)
 
 	/* See if there is a timeout that we should report */
 	if (tv != NULL && (flags & event & EV_TIMEOUT)) {
+		struct timeval timeout = ev->ev_timeout;
+
+		if (is_common_timeout(&timeout, ev->ev_base))
+			timeout.tv_usec &= MICROSECONDS_MASK;
 		gettime(ev->ev_base, &now);
-		evutil_timersub(&ev->ev_timeout, &now, &res);
+		evutil_timersub(&timeout, &now, &res);
 		/* correctly remap to real time */
-		evutil_gettimeofday(&now, NULL);
+		event_base_gettimeofday_cached(ev->ev_base, &now);
 		evutil_timeradd(&now, &res, tv);
 	}
 
@@ -823,6 +2095,13 @@ event_pending(struct event *ev, short event, struct timeval *tv)
  * */
 int
 event_add(struct event *ev, const struct timeval *tv)
+{
+	return (event_add_with_slack(ev, tv, NULL));
+}
+
+int
+event_add_with_slack(struct event *ev, const struct timeval *tv,
+    const struct timeval *slack)
 {
 	struct event_base *base = ev->ev_base;		// 要注册到的event_base
 	const struct eventop *evsel = base->evsel;
@@ -839,6 +2118,15 @@ event_add(struct event *ev, const struct timeval *tv)
 
 	assert(!(ev->ev_flags & ~EVLIST_ALL));
 
+	if (slack != NULL && (slack->tv_sec < 0 || slack->tv_usec < 0))
+		return (-1);
+
+	if ((ev->ev_events & EV_ET) && !(evsel->features & EV_FEATURE_ET)) {
+		event_debug(("%s: %s does not support EV_ET",
+			__func__, evsel->name));
+		return (-1);
+	}
+
 	/*
 	 * prepare for timeout insertion further below, if we get a
 	 * failure on any step, we should not change any state.
@@ -853,7 +2141,8 @@ event_add(struct event *ev, const struct timeval *tv)
 	 * base->timeheap 管理定时事件的小根堆 （min_heap结构体）
 	 * min_heap_size() 返回 base->timeheap 结构体中的 base->timeheap->n
 	 * */
-	if (tv != NULL && !(ev->ev_flags & EVLIST_TIMEOUT)) {
+	if (tv != NULL && !(ev->ev_flags & EVLIST_TIMEOUT) &&
+	    base->timewheel == NULL && !is_common_timeout(tv, base)) {
 		if (min_heap_reserve(&base->timeheap,
 			1 + min_heap_size(&base->timeheap)) == -1)
 			return (-1);  /* ENOMEM == errno */
@@ -906,12 +2195,11 @@ event_add(struct event *ev, const struct timeval *tv)
 			 * 将ev_callback调用次数设置为0
 			 *
 			 * ev->ev_ncalls: 事件就绪执行时，调用ev_callback的次数
-			 * ev_pncalls：指针，通常指向ev_ncalls或者为NULL
 			 *
 			 */
-			if (ev->ev_ncalls && ev->ev_pncalls) {
+			if (ev->ev_ncalls && base->current_event == ev) {
 				/* Abort loop */
-				*ev->ev_pncalls = 0;
+				base->current_ncalls = 0;
 			}
 			
 			// 将事件从对应的链表中删除
@@ -920,7 +2208,18 @@ event_add(struct event *ev, const struct timeval *tv)
 
 		/* 计算时间，并插入到timer小根堆中 */
 		gettime(base, &now);
-		evutil_timeradd(&now, tv, &ev->ev_timeout);
+		if (is_common_timeout(tv, base)) {
+			struct timeval duration = *tv;
+
+			duration.tv_usec &= MICROSECONDS_MASK;
+			evutil_timeradd(&now, &duration, &ev->ev_timeout);
+			ev->ev_timeout.tv_usec |=
+			    (tv->tv_usec & ~MICROSECONDS_MASK);
+		} else {
+			evutil_timeradd(&now, tv, &ev->ev_timeout);
+			if (slack != NULL)
+				timeout_round_up(&ev->ev_timeout, slack);
+		}
 
 		event_debug((
 			 "event_add: timeout in %ld seconds, call %p",
@@ -965,9 +2264,9 @@ event_del(struct event *ev)
 	 *
 	 * 将ev_callback调用次数设置为0
 	 * */
-	if (ev->ev_ncalls && ev->ev_pncalls) {
+	if (ev->ev_ncalls && base->current_event == ev) {
 		/* Abort loop */
-		*ev->ev_pncalls = 0;
+		base->current_ncalls = 0;
 	}
 
 	/*
@@ -1000,7 +2299,6 @@ event_active(struct event *ev, int res, short ncalls)
 
 	ev->ev_res = res;
 	ev->ev_ncalls = ncalls;
-	ev->ev_pncalls = NULL;
 	event_queue_insert(ev->ev_base, ev, EVLIST_ACTIVE);
 }
 
@@ -1008,14 +2306,36 @@ event_active(struct event *ev, int res, short ncalls)
  * timeout_next()函数根据堆中具有最小超时值的事件和当前时间来计算等待时间
  * */
 static int
-timeout_next(struct event_base *base, struct timeval **tv_p)
+timeout_empty(struct event_base *base)
+{
+	if (base->timewheel != NULL)
+		return (timer_wheel_empty(base->timewheel));
+	return (min_heap_empty(&base->timeheap));
+}
+
+/* Returns an event whose timeout has passed, or NULL */
+static struct event *
+timeout_expired(struct event_base *base, struct timeval *now)
 {
-	struct timeval now;
 	struct event *ev;
+
+	if (base->timewheel != NULL)
+		return (timer_wheel_top_expired(base->timewheel, now));
+
+	ev = min_heap_top(&base->timeheap);
+	if (ev == NULL || evutil_timercmp(&ev->ev_timeout, now, >))
+		return (NULL);
+	return (ev);
+}
+
+static int
+timeout_next(struct event_base *base, struct timeval **tv_p)
+{
+	struct timeval now, deadline;
 	struct timeval *tv = *tv_p;
 
 	// 堆的首元素具有最小的超时值
-	if ((ev = min_heap_top(&base->timeheap)) == NULL) {
+	if (timeout_empty(base)) {
 		/* 
 		 * if no time-based events are active wait for I/O 
 		 *
@@ -1029,14 +2349,24 @@ timeout_next(struct event_base *base, struct timeval **tv_p)
 	if (gettime(base, &now) == -1)
 		return (-1);
 
+	if (base->timewheel != NULL) {
+		if (timer_wheel_next(base->timewheel, &now, &deadline) == -1) {
+			*tv_p = NULL;
+			return (0);
+		}
+	} else
+		deadline = min_heap_top(&base->timeheap)->ev_timeout;
+	if (base->timer_slack_on)
+		timeout_round_up(&deadline, &base->timer_slack);
+
 	// 如果超时时间<=当前值，不能等待，需要立即返回
-	if (evutil_timercmp(&ev->ev_timeout, &now, <=)) {
+	if (evutil_timercmp(&deadline, &now, <=)) {
 		evutil_timerclear(tv);
 		return (0);
 	}
 
 	// 计算等待的时间=当前时间-最小的超时时间
-	evutil_timersub(&ev->ev_timeout, &now, tv);
+	evutil_timersub(&deadline, &now, tv);
 
 	assert(tv->tv_sec >= 0);
 	assert(tv->tv_usec >= 0);
@@ -1045,6 +2375,43 @@ timeout_next(struct event_base *base, struct timeval **tv_p)
 	return (0);
 }
 
+/*
+ * Rounds tv up to the next multiple of slack.  Deadlines that are less
+ * than slack apart then mostly end up on the same multiple, and expire in
+ * the same pass of the loop.
+ */
+static void
+timeout_round_up(struct timeval *tv, const struct timeval *slack)
+{
+	ev_uint64_t t, s;
+
+	s = (ev_uint64_t)slack->tv_sec * 1000000 + slack->tv_usec;
+	if (s <= 1)
+		return;
+
+	t = (ev_uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+	t = (t + s - 1) / s * s;
+	tv->tv_sec = t / 1000000;
+	tv->tv_usec = t % 1000000;
+}
+
+int
+event_base_set_timer_slack(struct event_base *base,
+    const struct timeval *slack)
+{
+	if (slack == NULL || !evutil_timerisset(slack)) {
+		base->timer_slack_on = 0;
+		return (0);
+	}
+	if (slack->tv_sec < 0 || slack->tv_usec < 0 ||
+	    slack->tv_usec >= 1000000)
+		return (-1);
+
+	base->timer_slack = *slack;
+	base->timer_slack_on = 1;
+	return (0);
+}
+
 /*
  * Determines if the time is running backwards by comparing the current
  * time against the last time we checked.  Not needed when using clock
@@ -1055,8 +2422,10 @@ static void
 timeout_correct(struct event_base *base, struct timeval *tv)
 {
 	struct event **pev;
+	struct event *ev;
 	unsigned int size;
 	struct timeval off;
+	int i;
 
 	if (use_monotonic)
 		return;
@@ -1072,15 +2441,36 @@ timeout_correct(struct event_base *base, struct timeval *tv)
 		    __func__));
 	evutil_timersub(&base->event_tv, tv, &off);
 
-	/*
-	 * We can modify the key element of the node without destroying
-	 * the key, beause we apply it to all in the right order.
-	 */
-	pev = base->timeheap.p;
-	size = base->timeheap.n;
-	for (; size-- > 0; ++pev) {
-		struct timeval *ev_tv = &(**pev).ev_timeout;
-		evutil_timersub(ev_tv, &off, ev_tv);
+	if (base->timewheel != NULL) {
+		timer_wheel_adjust(base->timewheel, &off);
+	} else {
+		/*
+		 * We can modify the key element of the node without
+		 * destroying the key, beause we apply it to all in the
+		 * right order.
+		 */
+		pev = base->timeheap.p;
+		size = base->timeheap.n;
+		for (; size-- > 0; ++pev) {
+			struct timeval *ev_tv = &(**pev).ev_timeout;
+			evutil_timersub(ev_tv, &off, ev_tv);
+		}
+	}
+
+	/* Common timeout queues stay sorted, but keep their index bits. */
+	for (i = 0; i < base->n_common_timeouts; ++i) {
+		struct common_timeout_list *ctl =
+		    base->common_timeout_queues[i];
+
+		TAILQ_FOREACH(ev, &ctl->events,
+		    ev_timeout_pos.ev_next_with_timeout) {
+			struct timeval *ev_tv = &ev->ev_timeout;
+			long bits = ev_tv->tv_usec & ~MICROSECONDS_MASK;
+
+			ev_tv->tv_usec &= MICROSECONDS_MASK;
+			evutil_timersub(ev_tv, &off, ev_tv);
+			ev_tv->tv_usec |= bits;
+		}
 	}
 	/* Now remember what the new time turned out to be. */
 	base->event_tv = *tv;
@@ -1092,15 +2482,12 @@ timeout_process(struct event_base *base)
 	struct timeval now;
 	struct event *ev;
 
-	if (min_heap_empty(&base->timeheap))
+	if (timeout_empty(base))
 		return;
 
 	gettime(base, &now);
 
-	while ((ev = min_heap_top(&base->timeheap))) {
-		if (evutil_timercmp(&ev->ev_timeout, &now, >))
-			break;
-
+	while ((ev = timeout_expired(base, &now)) != NULL) {
 		/* delete this event from the I/O queues */
 		event_del(ev);
 
@@ -1110,6 +2497,169 @@ timeout_process(struct event_base *base)
 	}
 }
 
+/*
+ * Common timeout queues.  Events in a queue share a duration, so they
+ * expire in the order in which they were added; the queue's internal
+ * timeout_event is kept in the timer heap for the earliest of them.
+ */
+
+static int
+is_common_timeout(const struct timeval *tv, const struct event_base *base)
+{
+	if ((tv->tv_usec & COMMON_TIMEOUT_MASK) != COMMON_TIMEOUT_MAGIC)
+		return (0);
+	return (COMMON_TIMEOUT_IDX(tv) < base->n_common_timeouts);
+}
+
+static struct common_timeout_list *
+get_common_timeout_list(struct event_base *base, const struct timeval *tv)
+{
+	return (base->common_timeout_queues[COMMON_TIMEOUT_IDX(tv)]);
+}
+
+/* Arms the queue's timer to fire when head expires. */
+static void
+common_timeout_schedule(struct common_timeout_list *ctl,
+    const struct timeval *now, struct event *head)
+{
+	struct timeval timeout = head->ev_timeout;
+
+	timeout.tv_usec &= MICROSECONDS_MASK;
+	if (evutil_timercmp(&timeout, now, >))
+		evutil_timersub(&timeout, now, &timeout);
+	else
+		evutil_timerclear(&timeout);
+	event_add(&ctl->timeout_event, &timeout);
+}
+
+static void
+common_timeout_callback(int fd, short what, void *arg)
+{
+	struct common_timeout_list *ctl = arg;
+	struct event *ev;
+	struct timeval now;
+
+	gettime(ctl->base, &now);
+	while ((ev = TAILQ_FIRST(&ctl->events)) != NULL) {
+		if (ev->ev_timeout.tv_sec > now.tv_sec ||
+		    (ev->ev_timeout.tv_sec == now.tv_sec &&
+		    (ev->ev_timeout.tv_usec & MICROSECONDS_MASK) > now.tv_usec))
+			break;
+		event_del(ev);
+		event_active(ev, EV_TIMEOUT, 1);
+	}
+	if (ev != NULL)
+		common_timeout_schedule(ctl, &now, ev);
+}
+
+static void
+common_timeout_insert(struct event_base *base, struct event *ev)
+{
+	struct common_timeout_list *ctl =
+	    get_common_timeout_list(base, &ev->ev_timeout);
+	struct event *e;
+	struct timeval now;
+
+	/*
+	 * Events are nearly always added with the latest deadline, so
+	 * look for the insertion point from the tail.  All entries carry
+	 * the same index bits, so they can be compared as they are.
+	 */
+	for (e = TAILQ_LAST(&ctl->events, event_list); e != NULL;
+	     e = TAILQ_PREV(e, event_list, ev_timeout_pos.ev_next_with_timeout)) {
+		if (evutil_timercmp(&ev->ev_timeout, &e->ev_timeout, >=))
+			break;
+	}
+	if (e != NULL) {
+		TAILQ_INSERT_AFTER(&ctl->events, e, ev,
+		    ev_timeout_pos.ev_next_with_timeout);
+		return;
+	}
+
+	TAILQ_INSERT_HEAD(&ctl->events, ev,
+	    ev_timeout_pos.ev_next_with_timeout);
+	gettime(base, &now);
+	common_timeout_schedule(ctl, &now, ev);
+}
+
+/*
+ * Removing the head leaves the queue's timer armed for the old deadline;
+ * when it fires the callback simply rearms it for the new head.
+ */
+static void
+common_timeout_remove(struct event_base *base, struct event *ev)
+{
+	struct common_timeout_list *ctl =
+	    get_common_timeout_list(base, &ev->ev_timeout);
+
+	TAILQ_REMOVE(&ctl->events, ev, ev_timeout_pos.ev_next_with_timeout);
+}
+
+const struct timeval *
+event_base_init_common_timeout(struct event_base *base,
+    const struct timeval *duration)
+{
+	struct common_timeout_list *ctl;
+	struct timeval tv;
+	int i;
+
+	if (is_common_timeout(duration, base))
+		return (&get_common_timeout_list(base, duration)->duration);
+
+	tv = *duration;
+	if (tv.tv_sec < 0 || tv.tv_usec < 0)
+		return (NULL);
+	tv.tv_sec += tv.tv_usec / 1000000;
+	tv.tv_usec %= 1000000;
+
+	for (i = 0; i < base->n_common_timeouts; ++i) {
+		ctl = base->common_timeout_queues[i];
+		if (ctl->duration.tv_sec == tv.tv_sec &&
+		    (ctl->duration.tv_usec & MICROSECONDS_MASK) == tv.tv_usec)
+			return (&ctl->duration);
+	}
+
+	if (base->n_common_timeouts == MAX_COMMON_TIMEOUTS) {
+		/* callers fall back to plain timeouts; say so only once */
+		if (!base->common_timeouts_full) {
+			event_warnx("%s: too many common timeouts", __func__);
+			base->common_timeouts_full = 1;
+		}
+		return (NULL);
+	}
+	if (base->n_common_timeouts == base->n_common_timeouts_allocated) {
+		int n = base->n_common_timeouts_allocated ?
+		    base->n_common_timeouts_allocated * 2 : 16;
+		struct common_timeout_list **queues;
+
+		queues = mm_realloc(base->common_timeout_queues,
+		    n * sizeof(*queues));
+		if (queues == NULL) {
+			event_warn("%s: realloc", __func__);
+			return (NULL);
+		}
+		base->common_timeout_queues = queues;
+		base->n_common_timeouts_allocated = n;
+	}
+
+	if ((ctl = mm_calloc(1, sizeof(struct common_timeout_list))) == NULL) {
+		event_warn("%s: calloc", __func__);
+		return (NULL);
+	}
+	TAILQ_INIT(&ctl->events);
+	ctl->base = base;
+	ctl->duration.tv_sec = tv.tv_sec;
+	ctl->duration.tv_usec = tv.tv_usec | COMMON_TIMEOUT_MAGIC |
+	    (base->n_common_timeouts << COMMON_TIMEOUT_IDX_SHIFT);
+	evtimer_set(&ctl->timeout_event, common_timeout_callback, ctl);
+	event_base_set(base, &ctl->timeout_event);
+	event_priority_set(&ctl->timeout_event, 0);
+	ctl->timeout_event.ev_flags |= EVLIST_INTERNAL;
+
+	base->common_timeout_queues[base->n_common_timeouts++] = ctl;
+	return (&ctl->duration);
+}
+
 void
 event_queue_remove(struct event_base *base, struct event *ev, int queue)
 {
@@ -1131,7 +2681,12 @@ event_queue_remove(struct event_base *base, struct event *ev, int queue)
 		    ev, ev_active_next);
 		break;
 	case EVLIST_TIMEOUT:
-		min_heap_erase(&base->timeheap, ev);
+		if (is_common_timeout(&ev->ev_timeout, base))
+			common_timeout_remove(base, ev);
+		else if (base->timewheel != NULL)
+			timer_wheel_erase(base->timewheel, ev);
+		else
+			min_heap_erase(&base->timeheap, ev);
 		break;
 	default:
 		event_errx(1, "%s: unknown queue %x", __func__, queue);
@@ -1166,7 +2721,12 @@ event_queue_insert(struct event_base *base, struct event *ev, int queue)
 		    ev,ev_active_next);
 		break;
 	case EVLIST_TIMEOUT: {		// 定时事件，加入堆
-		min_heap_push(&base->timeheap, ev);
+		if (is_common_timeout(&ev->ev_timeout, base))
+			common_timeout_insert(base, ev);
+		else if (base->timewheel != NULL)
+			timer_wheel_push(base->timewheel, ev);
+		else
+			min_heap_push(&base->timeheap, ev);
 		break;
 	}
 	default:
@@ -1192,3 +2752,185 @@ event_get_method(void)
 {
 	return (current_base->evsel->name);
 }
+
+/*
+ * Memory allocation
+ */
+
+static void *(*mm_malloc_fn)(size_t sz) = NULL;
+static void *(*mm_realloc_fn)(void *p, size_t sz) = NULL;
+static void (*mm_free_fn)(void *p) = NULL;
+
+static int mm_accounting;
+static int mm_used;		/* set by the first allocation */
+static struct event_mem_stats mm_stats[EVENT_MEM_NMODULES];
+
+/* Accounted blocks start with this header */
+union mm_header {
+	struct {
+		size_t size;
+		int module;
+	} h;
+	long double align;
+};
+
+void
+event_set_mem_functions(void *(*malloc_fn)(size_t sz),
+    void *(*realloc_fn)(void *ptr, size_t sz),
+    void (*free_fn)(void *ptr))
+{
+	mm_malloc_fn = malloc_fn;
+	mm_realloc_fn = realloc_fn;
+	mm_free_fn = free_fn;
+}
+
+int
+event_enable_mem_accounting(void)
+{
+	if (mm_used)
+		return (mm_accounting ? 0 : -1);
+	mm_accounting = 1;
+	return (0);
+}
+
+int
+event_get_mem_stats(int module, struct event_mem_stats *stats)
+{
+	if (!mm_accounting || module < 0 || module >= EVENT_MEM_NMODULES)
+		return (-1);
+	*stats = mm_stats[module];
+	return (0);
+}
+
+static void *
+mm_raw_malloc(size_t sz)
+{
+	if (!mm_used)
+		mm_used = 1;
+	return (mm_malloc_fn != NULL ? (*mm_malloc_fn)(sz) : malloc(sz));
+}
+
+static void *
+mm_raw_realloc(void *p, size_t sz)
+{
+	if (!mm_used)
+		mm_used = 1;
+	return (mm_realloc_fn != NULL ?
+	    (*mm_realloc_fn)(p, sz) : realloc(p, sz));
+}
+
+static void
+mm_raw_free(void *p)
+{
+	if (mm_free_fn != NULL)
+		(*mm_free_fn)(p);
+	else
+		free(p);
+}
+
+static void
+mm_account(int module, ev_uint64_t bytes, ev_uint64_t blocks)
+{
+	struct event_mem_stats *stats = &mm_stats[module];
+
+	EV_ATOMIC_ADD64(&stats->bytes, bytes);
+	if (blocks != 0)
+		EV_ATOMIC_ADD64(&stats->blocks, blocks);
+	if (blocks == 1)
+		EV_ATOMIC_ADD64(&stats->allocations, 1);
+}
+
+void *
+event_mm_malloc_(int module, size_t sz)
+{
+	union mm_header *hdr;
+
+	if (!mm_accounting || module == EVENT_MM_EXPORT)
+		return (mm_raw_malloc(sz));
+
+	if (sz > (size_t)-1 - sizeof(union mm_header))
+		return (NULL);
+	if ((hdr = mm_raw_malloc(sizeof(union mm_header) + sz)) == NULL)
+		return (NULL);
+	hdr->h.size = sz;
+	hdr->h.module = module;
+	mm_account(module, sz, 1);
+
+	return (hdr + 1);
+}
+
+void *
+event_mm_calloc_(int module, size_t count, size_t size)
+{
+	void *p;
+
+	if (count != 0 && size > (size_t)-1 / count)
+		return (NULL);
+	if (!mm_accounting && mm_malloc_fn == NULL) {
+		mm_used = 1;
+		return (calloc(count, size));
+	}
+
+	if ((p = event_mm_malloc_(module, count * size)) != NULL)
+		memset(p, 0, count * size);
+	return (p);
+}
+
+char *
+event_mm_strdup_(int module, const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *p;
+
+	if ((p = event_mm_malloc_(module, len)) != NULL)
+		memcpy(p, s, len);
+	return (p);
+}
+
+void *
+event_mm_realloc_(int module, void *p, size_t sz)
+{
+	union mm_header *hdr;
+	size_t old;
+
+	if (!mm_accounting)
+		return (mm_raw_realloc(p, sz));
+	if (p == NULL)
+		return (event_mm_malloc_(module, sz));
+
+	if (sz > (size_t)-1 - sizeof(union mm_header))
+		return (NULL);
+	hdr = (union mm_header *)p - 1;
+	old = hdr->h.size;
+	hdr = mm_raw_realloc(hdr, sizeof(union mm_header) + sz);
+	if (hdr == NULL)
+		return (NULL);
+	hdr->h.size = sz;
+	mm_account(hdr->h.module, (ev_uint64_t)sz - old, 0);
+
+	return (hdr + 1);
+}
+
+void
+event_mm_free_(void *p)
+{
+	union mm_header *hdr;
+
+	if (p == NULL)
+		return;
+	if (!mm_accounting) {
+		mm_raw_free(p);
+		return;
+	}
+
+	hdr = (union mm_header *)p - 1;
+	mm_account(hdr->h.module, -(ev_uint64_t)hdr->h.size, -(ev_uint64_t)1);
+	mm_raw_free(hdr);
+}
+
+void
+event_mm_free_export_(void *p)
+{
+	if (p != NULL)
+		mm_raw_free(p);
+}
@@ -170,6 +170,7 @@ extern "C" {
 #include <stdint.h>
 #endif
 #include <stdarg.h>
+#include <stdio.h>
 
 /* For int types. */
 #include <evutil.h>
@@ -198,6 +199,8 @@ typedef unsigned short u_short;
 #define EV_WRITE	0x04
 #define EV_SIGNAL	0x08
 #define EV_PERSIST	0x10	/* Persistant event */
+#define EV_ET		0x20	/* Edge-triggered, see EV_FEATURE_ET */
+#define EV_EXCLUSIVE	0x40	/* Wake one base, see EV_FEATURE_EXCLUSIVE */
 
 /* Fix so that ppl dont have to run with <sys/queue.h> */
 #ifndef TAILQ_ENTRY
@@ -211,43 +214,22 @@ struct {								\
 
 struct event_base;
 #ifndef EVENT_NO_STRUCT
+/*
+ * The fields read by the dispatchers and by event_process_active() come
+ * first, so that they share one cache line on LP64 when the event starts
+ * on a line boundary, as the slots of event_new() do; the queue links and
+ * the timeout, which only event_add() and event_del() touch, follow them.
+ */
 struct event {
-	/* 
-	 * event关注的事件类型（I/O事件--EV_WRITE/EV_READ、定时事件--EV_TIMEOUT、信号--EV_SIGNAL、辅助选项）
-	 * 可以使用 “|” 进行运算，I/O事件和定时事件不能同时设置
-	 * */
-	short ev_events;	
+	// libevent将所有的激活事件放入到链表active list中，然后遍历active list执行调度，
+	// ev_active_next就指明了event在active list中的位置；
+	TAILQ_ENTRY (event) ev_active_next;
 
 	/*
 	 * ev_base该事件所属的反应堆实例，这是一个event_base结构体
 	 * */
 	struct event_base *ev_base;
 
-	/* 
-	 * ev_next  ev_active_next   ev_signal_next 双向链表的节点指针
-	 * */
-	// I/O事件在链表中的位置，此链表为“已注册事件链表”
-	TAILQ_ENTRY (event) ev_next;			
-	// libevent将所有的激活事件放入到链表active list中，然后遍历active list执行调度，
-	// ev_active_next就指明了event在active list中的位置；	
-	TAILQ_ENTRY (event) ev_active_next;		
-	// signal事件在signal事件链表中的位置
-	TAILQ_ENTRY (event) ev_signal_next;		
-
-	/* 
-	 * min_heap_idx和ev_timeout，
-	 * 如果是timeout事件，它们是event在小根堆中的索引和超时值，
-	 * libevent使用小根堆来管理定时事件
-	 * */
-	unsigned int min_heap_idx;	/* for managing timeouts */
-	struct timeval ev_timeout;
-
-
-	/*
-	 * v_fd，对于I/O事件，是绑定的文件描述符；对于signal事件，是绑定的信号；
-	 * */
-	int ev_fd;
-	
 	/*
 	 * ev_callback，event的回调函数，被ev_base调用，执行事件处理程序，这是一个函数指针，原型为：
 	 * void (*ev_callback)(int fd, short events, void *arg)
@@ -257,6 +239,11 @@ struct event {
 	// ev_arg：void*，表明可以是任意类型的数据，在设置event时指定
 	void *ev_arg;
 
+	/*
+	 * v_fd，对于I/O事件，是绑定的文件描述符；对于signal事件，是绑定的信号；
+	 * */
+	int ev_fd;
+
 	/*  
 	 * eb_flags：libevent用于标记event信息的字段，表明其当前的状态，可能的值有：
 	 *			#define EVLIST_TIMEOUT 0x01 // event在time堆中
@@ -268,16 +255,41 @@ struct event {
 	 *  */
 	int ev_flags;
 
-	// ev_ncalls：事件就绪执行时，调用ev_callback的次数，通常为1
-	short ev_ncalls;
-	// ev_pncalls：指针，通常指向ev_ncalls或者为NULL
-	short *ev_pncalls;	/* Allows deletes in callback */
-
 	// 较小的数字是较高的优先级
 	int ev_pri;		/* smaller numbers are higher priority */
 
 	// ev_res：记录了当前激活事件的类型
 	int ev_res;		/* result passed to event callback */
+
+	/* 
+	 * event关注的事件类型（I/O事件--EV_WRITE/EV_READ、定时事件--EV_TIMEOUT、信号--EV_SIGNAL、辅助选项）
+	 * 可以使用 “|” 进行运算，I/O事件和定时事件不能同时设置
+	 * */
+	short ev_events;	
+
+	// ev_ncalls：事件就绪执行时，调用ev_callback的次数，通常为1；
+	// 回调中删除事件时由event_base中的current_ncalls中止循环
+	short ev_ncalls;
+
+	/* 
+	 * ev_next   ev_signal_next 双向链表的节点指针
+	 * */
+	// I/O事件在链表中的位置，此链表为“已注册事件链表”
+	TAILQ_ENTRY (event) ev_next;			
+	// signal事件在signal事件链表中的位置
+	TAILQ_ENTRY (event) ev_signal_next;		
+
+	/* 
+	 * min_heap_idx和ev_timeout，
+	 * 如果是timeout事件，它们是event在小根堆中的索引和超时值，
+	 * libevent使用小根堆来管理定时事件
+	 * */
+	union {
+		/* links the event into a timing wheel slot */
+		TAILQ_ENTRY (event) ev_next_with_timeout;
+		unsigned int min_heap_idx;	/* for managing timeouts */
+	} ev_timeout_pos;
+	struct timeval ev_timeout;
 };
 #else
 struct event;
@@ -318,6 +330,62 @@ TAILQ_HEAD (evkeyvalq, evkeyval);
  */
 struct event_base *event_base_new(void);
 
+/**
+ event_base_new_with_flags() flags
+ */
+/*@{*/
+#define EVBASE_TIMER_WHEEL	0x01	/**< Keep timeouts in a timing wheel. */
+#define EVBASE_PRECISE_TIMER	0x02	/**< Wait with microsecond precision. */
+#define EVBASE_COARSE_CLOCK	0x04	/**< Read a cheap, coarse clock. */
+#define EVBASE_SIGNALFD		0x08	/**< Read signals from a signalfd. */
+/*@}*/
+
+/**
+  Initialize the event API with non-default settings.
+
+  Like event_base_new(), but the flags argument changes how the new event
+  base works internally.
+
+  EVBASE_TIMER_WHEEL stores timeouts in a hierarchical timing wheel with
+  1ms ticks instead of a binary heap.  Adding and removing a timeout then
+  takes constant time, which pays off for bases that keep a very large
+  number of timeouts that are frequently rescheduled.  Timeouts still fire
+  no earlier than requested.  Setting the EVENT_TIMER_WHEEL environment
+  variable turns this on for all new event bases.
+
+  EVBASE_PRECISE_TIMER makes the epoll backend, whose epoll_wait() only
+  takes a timeout in milliseconds, wait with epoll_pwait2() or a timerfd
+  instead, so that a timeout is not rounded up to the next millisecond.
+  This costs an extra system call per loop pass on kernels without
+  epoll_pwait2().  Other backends are unaffected; select, kqueue and
+  io_uring already take their timeout with microseconds.  Setting the
+  EVENT_PRECISE_TIMER environment variable turns this on for all new
+  event bases.
+
+  EVBASE_COARSE_CLOCK reads the time with CLOCK_MONOTONIC_COARSE where
+  available, which the kernel serves without touching the hardware clock
+  but only advances once per scheduler tick, typically every 1 to 4ms.
+  Timeouts then fire up to one tick late.  It is ignored together with
+  EVBASE_PRECISE_TIMER.  Setting the EVENT_COARSE_CLOCK environment
+  variable turns this on for all new event bases.
+
+  EVBASE_SIGNALFD makes the base read the signals it has events for from
+  a Linux signalfd instead of catching them with a signal handler.  Each
+  base then handles its own signals, so several bases can watch different
+  signals at the same time, and one read picks up many signals at once.
+  The signals are blocked while the base watches them; other threads must
+  block them too, or they will still be delivered there, and programs
+  started meanwhile inherit the blocked mask.  Without signalfd support the
+  flag is ignored.  Setting the EVENT_SIGNALFD environment variable turns
+  this on for all new event bases.
+
+  @param flags any combination of EVBASE_TIMER_WHEEL, EVBASE_PRECISE_TIMER,
+    EVBASE_COARSE_CLOCK and EVBASE_SIGNALFD
+  @return a new event base, like event_base_new()
+  @see event_base_new(), event_base_free()
+ */
+struct event_base *event_base_new_with_flags(int flags);
+
 /**
   Initialize the event API.
 
@@ -369,6 +437,107 @@ int event_base_dispatch(struct event_base *);
  @return a string identifying the kernel event mechanism (kqueue, epoll, etc.)
  */
 const char *event_base_get_method(struct event_base *);
+
+/** The backend can report I/O readiness edge-triggered with EV_ET. */
+#define EV_FEATURE_ET	0x01
+/** The backend wakes only one of the bases that share an EV_EXCLUSIVE fd. */
+#define EV_FEATURE_EXCLUSIVE	0x02
+
+/**
+ Get the optional features supported by the kernel event mechanism.
+
+ An event with EV_ET only fires when its file descriptor becomes readable
+ or writable, not for as long as it stays so.  Its callback has to read
+ or write until the operation would block, and the event is normally
+ made EV_PERSIST.  All events on one file descriptor must agree on EV_ET.
+ event_add() fails for EV_ET events if the base lacks EV_FEATURE_ET.
+
+ When several bases wait for the same file descriptor, typically a
+ listening socket, readiness normally wakes all of them, and all but one
+ find nothing to accept.  With EV_EXCLUSIVE, a base with
+ EV_FEATURE_EXCLUSIVE is one of the waiters of which the kernel wakes
+ only some, usually one.  Other bases treat EV_EXCLUSIVE events as plain
+ ones.  All events on one file descriptor must agree on EV_EXCLUSIVE.
+
+ @param eb the event_base structure returned by event_base_new()
+ @return a bitmask of EV_FEATURE_* values
+ */
+int event_base_get_features(struct event_base *);
+
+/**
+  A callback for event_base_foreach_event().
+
+  @return 0 to continue with the next event; any other value stops the
+    iteration and is returned by event_base_foreach_event()
+ */
+typedef int (*event_base_foreach_event_cb)(struct event_base *,
+    struct event *, void *);
+
+/**
+  Call a function for every event of an event base.
+
+  Every event that is added, has a pending timeout or is active is visited
+  once; the events libevent uses internally are not.  The function must not
+  add, delete or activate events of the base.
+
+  @param eb the event_base structure returned by event_base_new()
+  @param fn the function to call with the base, the event and arg
+  @param arg an argument passed to fn
+  @return 0 once all events were visited, or the first non-zero value
+    returned by fn
+  @see event_base_dump_events()
+ */
+int event_base_foreach_event(struct event_base *,
+    event_base_foreach_event_cb fn, void *arg);
+
+/** event_base_dump_events() prints one line per callback, not per event */
+#define EVENT_DUMP_SUMMARY	0x01
+
+/**
+  Print the events of an event base, for debugging.
+
+  Each event is printed with its fd or signal, flags, priority, callback
+  and argument, and the time left until its timeout.  With
+  EVENT_DUMP_SUMMARY, the events are counted per callback instead, busiest
+  callback first, which tells quickly what a base with a huge number of
+  events is waiting for.
+
+  @param eb the event_base structure returned by event_base_new()
+  @param output the stream to print to
+  @param flags 0 or EVENT_DUMP_SUMMARY
+  @see event_base_foreach_event()
+ */
+void event_base_dump_events(struct event_base *, FILE *output, int flags);
+
+/**
+  Get the time of day as of the last time the event loop woke up.
+
+  While callbacks run, the event loop caches the time it read after the
+  backend returned, so that callbacks that need the current time do not
+  have to ask the kernel again.  The wall clock is derived from that cache
+  and is resynchronized with gettimeofday() every few seconds.  Outside of
+  the loop, this simply calls gettimeofday().
+
+  @param base the event base, or NULL for the current base
+  @param tv the timeval to fill in
+  @return 0 on success, -1 on failure
+  @see event_base_update_cache_time()
+ */
+int event_base_gettimeofday_cached(struct event_base *base,
+    struct timeval *tv);
+
+/**
+  Refresh the time cached by the event loop.
+
+  A callback that runs for a long time can call this so that the callbacks
+  after it, and the timeouts it adds, see the current time.  It does
+  nothing outside of the event loop.
+
+  @param base the event base
+  @return 0 on success, -1 on failure
+  @see event_base_gettimeofday_cached()
+ */
+int event_base_update_cache_time(struct event_base *base);
         
         
 /**
@@ -396,6 +565,66 @@ typedef void (*event_log_cb)(int severity, const char *msg);
   */
 void event_set_log_callback(event_log_cb cb);
 
+/**
+  Replace the functions libevent uses to allocate memory.
+
+  This must be called before any other libevent function, since memory
+  allocated by one set of functions cannot be released by another.
+  Memory that libevent returns for the caller to free, like the lines of
+  evbuffer_readline(), also comes from malloc_fn, and must be released with
+  the counterpart of free_fn.
+
+  @param malloc_fn replacement for malloc(), or NULL for the default
+  @param realloc_fn replacement for realloc(), or NULL for the default
+  @param free_fn replacement for free(), or NULL for the default
+  @see event_enable_mem_accounting()
+ */
+void event_set_mem_functions(void *(*malloc_fn)(size_t sz),
+    void *(*realloc_fn)(void *ptr, size_t sz),
+    void (*free_fn)(void *ptr));
+
+/**
+ Modules for event_get_mem_stats()
+ */
+/*@{*/
+#define EVENT_MEM_CORE		0	/**< bases, events and backends */
+#define EVENT_MEM_BUFFER	1	/**< evbuffers and bufferevents */
+#define EVENT_MEM_HTTP		2	/**< HTTP connections, requests, headers */
+#define EVENT_MEM_DNS		3	/**< DNS requests, servers and names */
+#define EVENT_MEM_RPC		4	/**< RPC state and tagging */
+#define EVENT_MEM_NMODULES	5
+/*@}*/
+
+/** Memory use of a module; see event_get_mem_stats() */
+struct event_mem_stats {
+	ev_uint64_t bytes;	/**< bytes allocated and not yet freed */
+	ev_uint64_t blocks;	/**< blocks allocated and not yet freed */
+	ev_uint64_t allocations;	/**< blocks allocated so far */
+};
+
+/**
+  Count the memory used by each part of libevent.
+
+  Every block then carries a small header with its size and module.  Like
+  event_set_mem_functions(), this must be called before libevent
+  allocates any memory.  Memory returned for the caller to free is not
+  counted.
+
+  @return 0 on success, or -1 if libevent allocated memory already
+  @see event_get_mem_stats()
+ */
+int event_enable_mem_accounting(void);
+
+/**
+  Get the memory use of a part of libevent.
+
+  @param module one of the EVENT_MEM_* modules
+  @param stats filled in with the memory use of the module
+  @return 0 on success, or -1 if accounting is off or module is unknown
+  @see event_enable_mem_accounting()
+ */
+int event_get_mem_stats(int module, struct event_mem_stats *stats);
+
 /**
   Associate a different event base with an event.
 
@@ -490,6 +719,9 @@ int event_loopbreak(void);
   event_base_loopbreak() is typically invoked from this event's callback.
   This behavior is analogous to the "break;" statement.
 
+  event_base_loopbreak() may also be called from another thread; a loop
+  that is blocked waiting for events is woken up and returns.
+
   Subsequent invocations of event_loop() will proceed normally.
 
   @param eb the event_base structure returned by event_init()
@@ -498,6 +730,331 @@ int event_loopbreak(void);
  */
 int event_base_loopbreak(struct event_base *);
 
+/**
+  Run a callback in the thread that dispatches an event base.
+
+  This is the only way to hand work to an event base from another thread:
+  event_add(), event_del() and event_active() must only be called by the
+  thread running the loop.  event_base_post() queues the callback without
+  taking a lock and wakes up the loop if it is blocked waiting for events.
+  Callbacks run in the order in which they were posted, from within
+  event_base_loop().  Callbacks that are still queued when the base is
+  freed are discarded without being called.
+
+  Note that posting does not keep the loop alive: event_base_loop() still
+  returns when no events are registered.
+
+  @param base the event_base that should run the callback
+  @param cb the callback to invoke
+  @param arg an argument to be passed to the callback
+  @return 0 if successful, or -1 if an error occurred
+  @see event_base_loopbreak()
+ */
+int event_base_post(struct event_base *base, void (*cb)(void *), void *arg);
+
+/**
+  Prepare an event_base to hold many timeouts of the same duration.
+
+  Timeouts are normally kept in a binary heap, so each event_add() and
+  event_del() costs O(log n).  When a large number of events use the same
+  duration they expire in the order they were added, and can be kept in a
+  queue instead where adding and removing them costs O(1).  Only the head
+  of each queue is stored in the heap.
+
+  Passing the returned timeval to event_add() puts the event into the
+  queue for this duration.  The returned value is only meaningful to the
+  event_base it came from and must not be modified or used for anything
+  else.  Calling this function twice with the same duration returns the
+  same queue.
+
+  @param base the event_base on which the timeouts will be used
+  @param duration the duration shared by the timeouts
+  @return a timeval to pass to event_add() in place of duration, or NULL
+    if an error occurred or too many durations are in use; the latter is
+    logged only the first time for each base
+ */
+const struct timeval *event_base_init_common_timeout(struct event_base *base,
+    const struct timeval *duration);
+
+#define EVENT_STATS_NBUCKETS	32
+
+/**
+  A latency histogram kept by event_base_enable_stats().
+
+  buckets[0] counts samples below one microsecond, and buckets[i] those of
+  at least 2^(i-1) but less than 2^i microseconds.  The last bucket also
+  counts everything longer.
+ */
+struct event_stats_histogram {
+	ev_uint64_t count;
+	ev_uint64_t total_usec;
+	ev_uint64_t max_usec;
+	ev_uint64_t buckets[EVENT_STATS_NBUCKETS];
+};
+
+/** Loop statistics returned by event_base_get_stats() */
+struct event_base_stats {
+	ev_uint64_t iterations;	/**< passes through the loop */
+	ev_uint64_t activated;	/**< events activated by I/O or timeouts */
+	ev_uint64_t callbacks;	/**< callbacks run */
+	ev_uint64_t spin_hits;	/**< busy polls that found events */
+	ev_uint64_t spin_sleeps;	/**< busy polls that gave up and waited */
+	int nevents;		/**< events added at the end of the last pass */
+	int nactive;		/**< events still waiting for their callback */
+	int ntimers;		/**< entries in the timer heap or wheel */
+	/** time spent waiting in the backend, per pass */
+	struct event_stats_histogram wait;
+	/** time spent outside of the backend, per pass */
+	struct event_stats_histogram iteration;
+	/** run time of each callback */
+	struct event_stats_histogram callback;
+};
+
+/**
+  Turn the collection of loop statistics on or off.
+
+  While statistics are on, event_base_loop() reads the clock around every
+  callback and counts what it does; while they are off it costs one test
+  per pass and per callback.  Turning them on clears all counters.  Must be
+  called from the thread that runs the loop.
+
+  @param base the event_base to instrument
+  @param on non-zero to collect statistics, zero to stop
+  @return 0 on success, or -1 if memory could not be allocated
+  @see event_base_get_stats(), event_base_get_priority_stats()
+ */
+int event_base_enable_stats(struct event_base *base, int on);
+
+/**
+  Take a snapshot of the loop statistics.
+
+  The snapshot is consistent even if the loop is running in another
+  thread, but the number of priorities of the base must not change
+  meanwhile.
+
+  @param base the event_base to inspect
+  @param stats filled in with the statistics collected so far
+  @return 0 on success, or -1 if statistics were never turned on
+ */
+int event_base_get_stats(struct event_base *base,
+    struct event_base_stats *stats);
+
+/**
+  Take a snapshot of the callback run times of one priority.
+
+  @param base the event_base to inspect
+  @param priority the priority, as for event_priority_set()
+  @param hist filled in with the run times of callbacks of that priority
+  @return 0 on success, or -1 if statistics were never turned on or the
+    priority does not exist
+  @see event_base_get_stats()
+ */
+int event_base_get_priority_stats(struct event_base *base, int priority,
+    struct event_stats_histogram *hist);
+
+/** A callback that ran for too long; see event_base_set_watchdog() */
+struct event_slow_callback {
+	void (*callback)(int, short, void *);	/**< the event's callback */
+	void *arg;		/**< its argument */
+	int fd;			/**< the event's fd or signal number */
+	short events;		/**< EV_* flags the event was set up with */
+	short res;		/**< EV_* flags it was activated with */
+	int priority;		/**< the event's priority */
+	struct timeval duration;	/**< how long the callback ran */
+};
+
+typedef void (*event_watchdog_cb)(struct event_base *,
+    const struct event_slow_callback *, void *);
+
+/**
+  Report callbacks that block the loop for too long.
+
+  Once a threshold is set, event_base_loop() reads the clock around every
+  callback, and reports each callback that ran for at least that long.
+  Reports go to cb if one is given, and are otherwise logged as warnings,
+  which reach the function passed to event_set_log_callback().  The
+  report is made after the callback returned, so the event may already
+  be gone; only the values copied into the report can be relied upon.
+
+  @param base the event_base to watch
+  @param threshold the shortest run time to report, or NULL to stop
+    watching
+  @param cb the function to call for each slow callback, or NULL to log
+  @param arg an argument to pass to cb
+  @return 0 on success
+ */
+int event_base_set_watchdog(struct event_base *base,
+    const struct timeval *threshold, event_watchdog_cb cb, void *arg);
+
+struct event_base_group;
+
+#define EVGROUP_ROUND_ROBIN	0x00	/**< Hand out bases in turn. */
+#define EVGROUP_LEAST_LOADED	0x01	/**< Pick the base with fewest events. */
+#define EVGROUP_HASH		0x02	/**< Pick a base by hashing the key. */
+#define EVGROUP_POLICY_MASK	0x0f
+#define EVGROUP_PIN_THREADS	0x10	/**< Bind each thread to one CPU. */
+
+/**
+  Create a group of event bases, each dispatched by its own thread.
+
+  A group lets one process spread its connections over all CPUs.  New file
+  descriptors are placed on one of the bases by event_base_group_select()
+  or event_base_group_assign_fd(), according to the policy in flags.
+
+  Once the group is running, a base may only be touched from its own
+  thread; use event_base_post() or event_base_handoff_fd() to reach it.
+  Events must be attached to a base with event_base_set(), since event_set()
+  uses the global base.  Signal events should all be added to a single
+  base, as libevent delivers signals to only one base at a time.
+
+  @param nbases the number of bases and threads, or 0 for one per CPU
+  @param flags EVGROUP_ROUND_ROBIN, EVGROUP_LEAST_LOADED or EVGROUP_HASH,
+    optionally combined with EVGROUP_PIN_THREADS
+  @param base_flags flags for event_base_new_with_flags()
+  @return a running group, or NULL if an error occurred
+  @see event_base_group_free()
+ */
+struct event_base_group *event_base_group_new(int nbases, int flags,
+    int base_flags);
+
+/**
+  Stop the threads of a group and free all of its bases.
+
+  Must not be called from one of the group's threads.  Callbacks that were
+  posted to the bases but did not run yet are discarded.
+
+  @param group the group to be freed
+ */
+void event_base_group_free(struct event_base_group *group);
+
+/**
+  Get the number of bases in a group.
+ */
+int event_base_group_size(struct event_base_group *group);
+
+/**
+  Get one of the bases in a group.
+
+  @param group the group
+  @param idx an index between 0 and event_base_group_size() - 1
+  @return the base, or NULL if idx is out of range
+ */
+struct event_base *event_base_group_get(struct event_base_group *group,
+    int idx);
+
+/**
+  Choose the base that should handle a new file descriptor.
+
+  @param group the group
+  @param key a value to hash for EVGROUP_HASH, such as the file descriptor
+    or a hash of the peer address; ignored by the other policies
+  @return the chosen base
+ */
+struct event_base *event_base_group_select(struct event_base_group *group,
+    unsigned int key);
+
+/**
+  Hand a file descriptor over to the thread that runs another event base.
+
+  The callback is invoked from within the loop of base, where it can set up
+  the events for fd.  The caller must not use fd after a successful call.
+
+  @param base the base that should take over fd
+  @param fd the file descriptor, usually a connected socket
+  @param cb the callback to invoke with base, fd and arg
+  @param arg an argument to be passed to the callback
+  @return 0 if successful, or -1 if an error occurred
+  @see event_base_post()
+ */
+int event_base_handoff_fd(struct event_base *base, int fd,
+    void (*cb)(struct event_base *, int, void *), void *arg);
+
+/**
+  Place a file descriptor on one of the bases of a group.
+
+  Selects a base with event_base_group_select(), using fd as the key, and
+  hands fd over to it with event_base_handoff_fd().
+
+  @return 0 if successful, or -1 if an error occurred
+ */
+int event_base_group_assign_fd(struct event_base_group *group, int fd,
+    void (*cb)(struct event_base *, int, void *), void *arg);
+
+struct evlistener;
+struct sockaddr;
+
+#define EVLISTENER_CLOSE_ON_FREE	0x01	/**< Close the socket on free. */
+#define EVLISTENER_EXCLUSIVE	0x02	/**< Wake one of several waiters. */
+
+/**
+  A callback for a new connection on a listener.
+
+  @param lev the listener
+  @param fd the connected socket, already non-blocking and close-on-exec;
+    the callback owns it
+  @param sa the address of the peer
+  @param socklen the length of sa
+  @param arg the argument passed to evlistener_new()
+ */
+typedef void (*evlistener_cb)(struct evlistener *lev, int fd,
+    struct sockaddr *sa, int socklen, void *arg);
+
+/**
+  Accept connections on a listening socket.
+
+  Each time the socket becomes readable, the listener accepts connections
+  until none are pending or it has taken the number set with
+  evlistener_set_max_accepts(), and calls cb for every one of them.  Where
+  accept4() is available the new sockets are made non-blocking and
+  close-on-exec by the same system call.
+
+  When the process runs out of file descriptors, the listener closes a
+  spare descriptor it keeps for this purpose, accepts and drops one
+  pending connection, and takes the spare back, so that a full backlog
+  does not leave the socket readable in a busy loop.  If it has no spare,
+  it stops accepting for a second instead.  Only the first failure of a
+  run of them is logged.
+
+  The listener must not be freed from its own callback.
+
+  @param base the base to accept on, or NULL for the global base
+  @param cb the callback for new connections
+  @param arg an argument to be passed to cb
+  @param flags EVLISTENER_CLOSE_ON_FREE and EVLISTENER_EXCLUSIVE; the
+    latter needs EV_FEATURE_EXCLUSIVE, see event_base_get_features()
+  @param fd a socket on which listen() has been called; it is made
+    non-blocking
+  @return the listener, or NULL if an error occurred
+  @see evlistener_free()
+ */
+struct evlistener *evlistener_new(struct event_base *base, evlistener_cb cb,
+    void *arg, int flags, int fd);
+
+/**
+  Stop accepting and free a listener.
+
+  The socket is closed if the listener was created with
+  EVLISTENER_CLOSE_ON_FREE.
+ */
+void evlistener_free(struct evlistener *lev);
+
+/**
+  Set how many connections a listener accepts before it returns to the
+  loop.
+
+  A larger value accepts connection storms faster; a smaller one keeps
+  the other events of the base from waiting behind them.  The default
+  is 16.
+
+  @return 0 if successful, or -1 if max_accepts is not positive
+ */
+int evlistener_set_max_accepts(struct evlistener *lev, int max_accepts);
+
+/**
+  Get the listening socket of a listener.
+ */
+int evlistener_get_fd(struct evlistener *lev);
+
 
 /**
   Add a timer event.
@@ -578,7 +1135,8 @@ int event_base_loopbreak(struct event_base *);
   The function fn will be called with the file descriptor that triggered the
   event and the type of event which will be either EV_TIMEOUT, EV_SIGNAL,
   EV_READ, or EV_WRITE.  The additional flag EV_PERSIST makes an event_add()
-  persistent until event_del() has been called.
+  persistent until event_del() has been called.  With EV_ET, backends that
+  support it report the file descriptor only when it becomes ready.
 
   @param ev an event struct to be modified
   @param fd the file descriptor to be monitored
@@ -613,6 +1171,37 @@ int event_once(int, short, void (*)(int, short, void *), void *,
     const struct timeval *);
 
 
+/**
+  Allocate and prepare an event.
+
+  Like event_set() followed by event_base_set(), but the event is taken
+  from a pool kept by the event base, which makes allocating and freeing
+  many short-lived events much cheaper than malloc().  Events are aligned
+  to cache lines.  Pools are not locked: event_new() and event_free() must
+  be called from the thread that runs the loop of the base, or while it
+  does not run.
+
+  @param base the event base to use, or NULL for the current base
+  @param fd the file descriptor or signal to watch
+  @param events EV_READ, EV_WRITE, EV_SIGNAL, EV_PERSIST or EV_ET
+  @param callback the function to call when the event triggers
+  @param arg an argument to pass to callback
+  @return the new event, or NULL if an error occurred
+  @see event_free(), event_set()
+ */
+struct event *event_new(struct event_base *base, int fd, short events,
+    void (*callback)(int, short, void *), void *arg);
+
+/**
+  Delete and deallocate an event created with event_new().
+
+  The event may be freed after its event base; the pool goes away with
+  the last of its events.
+
+  @param ev the event to free
+ */
+void event_free(struct event *ev);
+
 /**
   Schedule a one-time event (threadsafe variant)
 
@@ -657,6 +1246,27 @@ int event_base_once(struct event_base *base, int fd, short events,
 int event_add(struct event *ev, const struct timeval *timeout);
 
 
+/**
+  Add an event whose timeout may fire a little late.
+
+  Like event_add(), but the deadline is rounded up to the next multiple of
+  slack, so that timeouts added with the same slack expire together and
+  wake the loop once instead of once each.  The event fires no earlier
+  than with event_add() and at most slack later.  The slack does not apply
+  to timeouts returned by event_base_init_common_timeout(), whose events
+  already share a single deadline per queue.
+
+  @param ev an event struct initialized via event_set()
+  @param timeout the maximum amount of time to wait for the event, or NULL
+         to wait forever
+  @param slack how much later the timeout may fire, or NULL for none
+  @return 0 if successful, or -1 if an error occurred
+  @see event_add(), event_base_set_timer_slack()
+  */
+int event_add_with_slack(struct event *ev, const struct timeval *timeout,
+    const struct timeval *slack);
+
+
 /**
   Remove an event from the set of monitored events.
 
@@ -756,6 +1366,95 @@ int	event_priority_init(int);
 int	event_base_priority_init(struct event_base *, int);
 
 
+/**
+  Share each pass through the loop between all priorities.
+
+  By default a pass runs the callbacks of the most important priority
+  that has active events only, so a steady stream of such events starves
+  all others.  With budgets, a pass runs up to budgets[i] callbacks of
+  every priority i in turn, most important first; a budget of 0 means no
+  limit.  Events left over wait for the next pass, which polls for new
+  events without blocking.
+
+  The array needs one entry per priority.  Changing the number of
+  priorities with event_base_priority_init() drops the budgets.
+
+  @param eb the event_base structure returned by event_init()
+  @param budgets the callbacks per priority and pass, or NULL to go back
+    to strict priorities
+  @return 0 if successful, or -1 if an error occurred
+  @see event_base_set_max_callbacks()
+ */
+int	event_base_set_priority_budgets(struct event_base *, const int *);
+
+
+/**
+  Limit the number of callbacks run before the loop polls for events.
+
+  An event whose callback is due several times, like a signal that was
+  caught repeatedly, runs all of them even if that exceeds the limit.
+
+  @param eb the event_base structure returned by event_init()
+  @param max the number of callbacks per pass, or 0 for no limit
+  @return 0 if successful, or -1 if an error occurred
+  @see event_base_set_priority_budgets()
+ */
+int	event_base_set_max_callbacks(struct event_base *, int);
+
+
+/**
+  Limit the number of ready file descriptors taken per wait.
+
+  The epoll backend sizes the array it passes to epoll_wait() by itself:
+  it doubles the array whenever a wait filled it, and halves it again once
+  the waits have returned less than a quarter of it for a while.  By
+  default it grows as far as bursts take it.  Other backends ignore the
+  limit.
+
+  @param eb the event_base structure returned by event_init()
+  @param max the largest number of events per wait, or 0 for no limit
+  @return 0 if successful, or -1 if an error occurred
+  @see event_base_set_max_callbacks()
+ */
+int	event_base_set_max_dispatch_events(struct event_base *, int);
+
+
+/**
+  Poll for a while before the loop goes to sleep.
+
+  When the loop would wait for events, it first polls the backend without
+  blocking for up to max_spin, which keeps a busy thread from paying for
+  a sleep and a wakeup when the next event is due within microseconds.
+  The loop averages how long events took to arrive over the recent passes
+  and stops spinning while that exceeds max_spin, so an idle base does not
+  keep a CPU busy.  With statistics on, spin_hits and spin_sleeps count
+  the passes whose spin found events and those that had to wait.
+
+  @param eb the event_base structure returned by event_init()
+  @param max_spin the longest time to poll before waiting, or NULL to
+    turn busy polling off
+  @return 0 if successful, or -1 if an error occurred
+  @see event_base_enable_stats()
+ */
+int	event_base_set_busy_poll(struct event_base *, const struct timeval *);
+
+
+/**
+  Let the loop wake up late for timeouts, to handle more of them at once.
+
+  The loop rounds the time it waits for the next timeout up to the next
+  multiple of slack, and runs all timeouts due by then in one pass.  This
+  cuts the wakeups of mostly idle bases that keep many staggered timers,
+  at the cost of firing every timeout up to slack late.
+
+  @param eb the event_base structure returned by event_init()
+  @param slack the rounding of wakeups, or NULL to turn it off
+  @return 0 if successful, or -1 if an error occurred
+  @see event_add_with_slack()
+ */
+int	event_base_set_timer_slack(struct event_base *, const struct timeval *);
+
+
 /**
   Assign a priority to an event.
 
@@ -769,16 +1468,18 @@ int	event_priority_set(struct event *, int);
 
 /* These functions deal with buffering input and output */
 
+struct evbuffer_chain;
+
 struct evbuffer {
-	u_char *buffer;
-	u_char *orig_buffer;
+	/* the data, in chunks; see evbuffer_pullup() for a contiguous view */
+	struct evbuffer_chain *first;
+	struct evbuffer_chain *last;
 
-	size_t misalign;
-	size_t totallen;
 	size_t off;
 
 	void (*cb)(struct evbuffer *, size_t, size_t, void *);
 	void *cbarg;
+	struct evbuffer_deferred *deferred;	/* see evbuffer_defer_callbacks() */
 };
 
 /* Just for error reporting - use other constants otherwise */
@@ -881,6 +1582,22 @@ int bufferevent_base_set(struct event_base *base, struct bufferevent *bufev);
 int bufferevent_priority_set(struct bufferevent *bufev, int pri);
 
 
+/**
+  Switch a bufferevent between level- and edge-triggered operation.
+
+  An edge-triggered bufferevent uses persistent EV_ET events and reads
+  and writes until the socket would block each time it is woken up, so a
+  busy socket does not wake up the loop over and over.  Must be called
+  after bufferevent_base_set().
+
+  @param bufev a bufferevent struct
+  @param on 1 for edge-triggered, 0 for level-triggered
+  @return 0 if successful, or -1 if the base lacks EV_FEATURE_ET
+  @see event_base_get_features()
+  */
+int bufferevent_set_edge_triggered(struct bufferevent *bufev, int on);
+
+
 /**
   Deallocate the storage associated with a bufferevent structure.
 
@@ -1008,7 +1725,7 @@ void bufferevent_setwatermark(struct bufferevent *bufev, short events,
     size_t lowmark, size_t highmark);
 
 #define EVBUFFER_LENGTH(x)	(x)->off
-#define EVBUFFER_DATA(x)	(x)->buffer
+#define EVBUFFER_DATA(x)	evbuffer_pullup((x), -1)
 #define EVBUFFER_INPUT(x)	(x)->input
 #define EVBUFFER_OUTPUT(x)	(x)->output
 
@@ -1033,10 +1750,11 @@ void evbuffer_free(struct evbuffer *);
 /**
   Expands the available space in an event buffer.
 
-  Expands the available space in the event buffer to at least datlen
+  Makes room for at least datlen more bytes in the last chunk of the
+  event buffer, so that they can be appended without another allocation.
 
   @param buf the event buffer to be expanded
-  @param datlen the new minimum length requirement
+  @param datlen the number of bytes to make room for
   @return 0 if successful, or -1 if an error occurred
 */
 int evbuffer_expand(struct evbuffer *, size_t);
@@ -1080,7 +1798,8 @@ char *evbuffer_readline(struct evbuffer *);
   Move data from one evbuffer into another evbuffer.
 
   This is a destructive add.  The data from one buffer moves into
-  the other buffer. The destination buffer is expanded as needed.
+  the other buffer.  The chunks of inbuf are linked into outbuf without
+  copying the data.
 
   @param outbuf the output buffer
   @param inbuf the input buffer
@@ -1089,6 +1808,37 @@ char *evbuffer_readline(struct evbuffer *);
 int evbuffer_add_buffer(struct evbuffer *, struct evbuffer *);
 
 
+/**
+  Move data from the front of one evbuffer to the end of another.
+
+  Whole chunks are moved without copying; only a chunk that is split
+  between the two buffers has part of its data copied.
+
+  @param src the buffer to take the data from
+  @param dst the buffer to append the data to
+  @param datlen the number of bytes to move
+  @return the number of bytes moved
+ */
+int evbuffer_remove_buffer(struct evbuffer *src, struct evbuffer *dst,
+    size_t datlen);
+
+
+/**
+  Make the first bytes of an evbuffer contiguous.
+
+  The data of an evbuffer is kept in a list of chunks.  This copies the
+  first size bytes into a single chunk where they are not already in one;
+  EVBUFFER_DATA() does so for the whole buffer.  The pointer is valid
+  until the buffer is next modified.
+
+  @param buf the evbuffer
+  @param size the number of bytes, or -1 for all of them
+  @return a pointer to the first byte, or NULL if the buffer has no
+    storage or memory ran out
+ */
+u_char *evbuffer_pullup(struct evbuffer *buf, size_t size);
+
+
 /**
   Append a formatted string to the end of an evbuffer.
 
@@ -1168,6 +1918,23 @@ u_char *evbuffer_find(struct evbuffer *, const u_char *, size_t);
  */
 void evbuffer_setcb(struct evbuffer *, void (*)(struct evbuffer *, size_t, size_t, void *), void *);
 
+/**
+  Run the callback of an evbuffer from the event loop.
+
+  By default the callback set with evbuffer_setcb() runs from within every
+  call that changes the buffer.  Once deferred, it runs after the active
+  events of the next pass of the loop, once for all changes since then,
+  with the length before the first change and the current length; it does
+  not run if the length ended up unchanged.  The input buffer of a
+  bufferevent defers its callback to the base of the bufferevent.
+
+  @param buffer the evbuffer whose callback should be deferred
+  @param base the event base to run the callback, or NULL to run it
+    immediately again
+  @return 0 on success, or -1 if memory could not be allocated
+ */
+int evbuffer_defer_callbacks(struct evbuffer *buffer, struct event_base *base);
+
 /*
  * Marshaling tagged data - We assume that all tags are inserted in their
  * numeric order - so that unknown tags will always be higher than the
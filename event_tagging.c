@@ -145,9 +145,15 @@ static int
 decode_tag_internal(ev_uint32_t *ptag, struct evbuffer *evbuf, int dodrain)
 {
 	ev_uint32_t number = 0;
-	ev_uint8_t *data = EVBUFFER_DATA(evbuf);
 	int len = EVBUFFER_LENGTH(evbuf);
 	int count = 0, shift = 0, done = 0;
+	ev_uint8_t *data;
+
+	/* a tag takes at most five bytes */
+	if (len > 5)
+		len = 5;
+	if ((data = evbuffer_pullup(evbuf, len)) == NULL)
+		return (-1);
 
 	while (count++ < len) {
 		ev_uint8_t lower = *data++;
@@ -224,15 +230,22 @@ evtag_marshal_timeval(struct evbuffer *evbuf, ev_uint32_t tag, struct timeval *t
 }
 
 static int
-decode_int_internal(ev_uint32_t *pnumber, struct evbuffer *evbuf, int dodrain)
+decode_int_internal(ev_uint32_t *pnumber, struct evbuffer *evbuf, int offset,
+    int dodrain)
 {
 	ev_uint32_t number = 0;
-	ev_uint8_t *data = EVBUFFER_DATA(evbuf);
-	int len = EVBUFFER_LENGTH(evbuf);
+	int len = EVBUFFER_LENGTH(evbuf) - offset;
 	int nibbles = 0;
+	ev_uint8_t *data;
 
-	if (!len)
+	if (len <= 0)
 		return (-1);
+	/* so is an integer */
+	if (len > 5)
+		len = 5;
+	if ((data = evbuffer_pullup(evbuf, offset + len)) == NULL)
+		return (-1);
+	data += offset;
 
 	nibbles = ((data[0] & 0xf0) >> 4) + 1;
 	if (nibbles > 8 || (nibbles >> 1) + 1 > len)
@@ -259,7 +272,7 @@ decode_int_internal(ev_uint32_t *pnumber, struct evbuffer *evbuf, int dodrain)
 int
 evtag_decode_int(ev_uint32_t *pnumber, struct evbuffer *evbuf)
 {
-	return (decode_int_internal(pnumber, evbuf, 1) == -1 ? -1 : 0);
+	return (decode_int_internal(pnumber, evbuf, 0, 1) == -1 ? -1 : 0);
 }
 
 int
@@ -271,18 +284,13 @@ evtag_peek(struct evbuffer *evbuf, ev_uint32_t *ptag)
 int
 evtag_peek_length(struct evbuffer *evbuf, ev_uint32_t *plength)
 {
-	struct evbuffer tmp;
 	int res, len;
 
 	len = decode_tag_internal(NULL, evbuf, 0 /* dodrain */);
 	if (len == -1)
 		return (-1);
 
-	tmp = *evbuf;
-	tmp.buffer += len;
-	tmp.off -= len;
-
-	res = decode_int_internal(plength, &tmp, 0);
+	res = decode_int_internal(plength, evbuf, len, 0);
 	if (res == -1)
 		return (-1);
 
@@ -294,18 +302,13 @@ evtag_peek_length(struct evbuffer *evbuf, ev_uint32_t *plength)
 int
 evtag_payload_length(struct evbuffer *evbuf, ev_uint32_t *plength)
 {
-	struct evbuffer tmp;
 	int res, len;
 
 	len = decode_tag_internal(NULL, evbuf, 0 /* dodrain */);
 	if (len == -1)
 		return (-1);
 
-	tmp = *evbuf;
-	tmp.buffer += len;
-	tmp.off -= len;
-
-	res = decode_int_internal(plength, &tmp, 0);
+	res = decode_int_internal(plength, evbuf, len, 0);
 	if (res == -1)
 		return (-1);
 
@@ -342,11 +345,9 @@ evtag_unmarshal(struct evbuffer *src, ev_uint32_t *ptag, struct evbuffer *dst)
 	if (EVBUFFER_LENGTH(src) < len)
 		return (-1);
 
-	if (evbuffer_add(dst, EVBUFFER_DATA(src), len) == -1)
+	if (evbuffer_remove_buffer(src, dst, len) != (int)len)
 		return (-1);
 
-	evbuffer_drain(src, len);
-
 	return (len);
 }
 
@@ -372,11 +373,9 @@ evtag_unmarshal_int(struct evbuffer *evbuf, ev_uint32_t need_tag,
 		return (-1);
 	
 	evbuffer_drain(_buf, EVBUFFER_LENGTH(_buf));
-	if (evbuffer_add(_buf, EVBUFFER_DATA(evbuf), len) == -1)
+	if (evbuffer_remove_buffer(evbuf, _buf, len) != (int)len)
 		return (-1);
 
-	evbuffer_drain(evbuf, len);
-
 	return (evtag_decode_int(pinteger, _buf));
 }
 
@@ -413,6 +412,7 @@ evtag_unmarshal_string(struct evbuffer *evbuf, ev_uint32_t need_tag,
 	if (evtag_unmarshal(evbuf, &tag, _buf) == -1 || tag != need_tag)
 		return (-1);
 
+	/* the code made by event_rpcgen.py releases this with free() */
 	*pstring = calloc(EVBUFFER_LENGTH(_buf) + 1, 1);
 	if (*pstring == NULL)
 		event_err(1, "%s: calloc", __func__);
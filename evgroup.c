@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2026 The libevent contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Event base groups: one event_base per thread, and a placement policy
+ * that decides which of them gets a new file descriptor.
+ */
+
+#ifdef __linux__
+/* for pthread_setaffinity_np() */
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else
+#include <sys/_libevent_time.h>
+#endif
+#include <sys/queue.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <sched.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "event.h"
+#include "event-internal.h"
+#include "log.h"
+#include "mm-internal.h"
+
+/* the keepalive timer only exists so that the loop never runs dry */
+#define EVGROUP_KEEPALIVE_SEC	3600
+
+struct event_base_group;
+
+struct event_base_group_member {
+	struct event_base_group *group;
+	struct event_base *base;
+	struct event keepalive;
+	int index;
+	int started;
+#ifdef HAVE_PTHREAD_H
+	pthread_t thread;
+#endif
+};
+
+struct event_base_group {
+	struct event_base_group_member *members;
+	int nbases;
+	int flags;
+	unsigned int next;		/* round-robin cursor */
+	volatile int stopping;
+};
+
+/* A file descriptor on its way to another event base */
+struct event_fd_handoff {
+	struct event_base *base;
+	int fd;
+	void (*cb)(struct event_base *, int, void *);
+	void *arg;
+};
+
+static void
+evgroup_keepalive_cb(int fd, short what, void *arg)
+{
+	struct event_base_group_member *m = arg;
+	struct timeval tv;
+
+	evutil_timerclear(&tv);
+	tv.tv_sec = EVGROUP_KEEPALIVE_SEC;
+	evtimer_add(&m->keepalive, &tv);
+}
+
+static void
+evgroup_run(struct event_base_group_member *m)
+{
+#if defined(__linux__) && defined(HAVE_PTHREAD_H) && defined(CPU_SET)
+	if (m->group->flags & EVGROUP_PIN_THREADS) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		cpu_set_t set;
+
+		if (ncpu > 0) {
+			CPU_ZERO(&set);
+			CPU_SET(m->index % ncpu, &set);
+			if (pthread_setaffinity_np(pthread_self(),
+				sizeof(set), &set) != 0)
+				event_warnx("%s: cannot pin base %d to cpu %ld",
+				    __func__, m->index, m->index % ncpu);
+		}
+	}
+#endif
+
+	/* user callbacks may break the loop; only the group may end it */
+	while (!m->group->stopping) {
+		if (event_base_loop(m->base, 0) == -1) {
+			event_warnx("%s: base %d failed", __func__, m->index);
+			break;
+		}
+	}
+}
+
+#ifdef HAVE_PTHREAD_H
+static void *
+evgroup_thread(void *arg)
+{
+	evgroup_run(arg);
+	return (NULL);
+}
+
+static int
+evgroup_start(struct event_base_group_member *m)
+{
+	if (pthread_create(&m->thread, NULL, evgroup_thread, m) != 0)
+		return (-1);
+	return (0);
+}
+
+static void
+evgroup_join(struct event_base_group_member *m)
+{
+	pthread_join(m->thread, NULL);
+}
+#else
+static int
+evgroup_start(struct event_base_group_member *m)
+{
+	event_warnx("%s: threads are not supported", __func__);
+	return (-1);
+}
+
+static void
+evgroup_join(struct event_base_group_member *m)
+{
+}
+#endif
+
+struct event_base_group *
+event_base_group_new(int nbases, int flags, int base_flags)
+{
+	struct event_base_group *group;
+	struct timeval tv;
+	int i;
+
+	if (nbases <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+		nbases = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (nbases <= 0)
+			nbases = 1;
+	}
+
+	if ((group = mm_calloc(1, sizeof(struct event_base_group))) == NULL) {
+		event_warn("%s: calloc", __func__);
+		return (NULL);
+	}
+	group->members = mm_calloc(nbases,
+	    sizeof(struct event_base_group_member));
+	if (group->members == NULL) {
+		event_warn("%s: calloc", __func__);
+		mm_free(group);
+		return (NULL);
+	}
+	group->nbases = nbases;
+	group->flags = flags;
+
+	evutil_timerclear(&tv);
+	tv.tv_sec = EVGROUP_KEEPALIVE_SEC;
+	for (i = 0; i < nbases; i++) {
+		struct event_base_group_member *m = &group->members[i];
+
+		m->group = group;
+		m->index = i;
+		m->base = event_base_new_with_flags(base_flags);
+		evtimer_set(&m->keepalive, evgroup_keepalive_cb, m);
+		event_base_set(m->base, &m->keepalive);
+		evtimer_add(&m->keepalive, &tv);
+
+		if (evgroup_start(m) == -1) {
+			event_warn("%s: cannot start thread for base %d",
+			    __func__, i);
+			event_base_group_free(group);
+			return (NULL);
+		}
+		m->started = 1;
+	}
+
+	return (group);
+}
+
+void
+event_base_group_free(struct event_base_group *group)
+{
+	int i;
+
+	group->stopping = 1;
+	for (i = 0; i < group->nbases; i++) {
+		struct event_base_group_member *m = &group->members[i];
+		if (m->started)
+			event_base_loopbreak(m->base);
+	}
+
+	for (i = 0; i < group->nbases; i++) {
+		struct event_base_group_member *m = &group->members[i];
+		if (m->base == NULL)
+			continue;
+		if (m->started)
+			evgroup_join(m);
+		event_del(&m->keepalive);
+		event_base_free(m->base);
+	}
+
+	mm_free(group->members);
+	mm_free(group);
+}
+
+int
+event_base_group_size(struct event_base_group *group)
+{
+	return (group->nbases);
+}
+
+struct event_base *
+event_base_group_get(struct event_base_group *group, int idx)
+{
+	if (idx < 0 || idx >= group->nbases)
+		return (NULL);
+	return (group->members[idx].base);
+}
+
+static int
+evgroup_load(struct event_base_group_member *m)
+{
+	return (*(volatile int *)&m->base->event_count);
+}
+
+struct event_base *
+event_base_group_select(struct event_base_group *group, unsigned int key)
+{
+	int i, best = 0;
+
+	switch (group->flags & EVGROUP_POLICY_MASK) {
+	case EVGROUP_LEAST_LOADED:
+		/*
+		 * The counts belong to other threads; a stale value only
+		 * makes the choice a little less balanced.
+		 */
+		for (i = 1; i < group->nbases; i++) {
+			if (evgroup_load(&group->members[i]) <
+			    evgroup_load(&group->members[best]))
+				best = i;
+		}
+		break;
+	case EVGROUP_HASH:
+		/* Fibonacci hashing; the high bits are the well mixed ones */
+		best = ((key * 2654435761U) >> 16) % group->nbases;
+		break;
+	case EVGROUP_ROUND_ROBIN:
+	default:
+		best = group->next++ % group->nbases;
+		break;
+	}
+
+	return (group->members[best].base);
+}
+
+static void
+event_fd_handoff_cb(void *arg)
+{
+	struct event_fd_handoff *h = arg;
+
+	(*h->cb)(h->base, h->fd, h->arg);
+	mm_free(h);
+}
+
+int
+event_base_handoff_fd(struct event_base *base, int fd,
+    void (*cb)(struct event_base *, int, void *), void *arg)
+{
+	struct event_fd_handoff *h;
+
+	if ((h = mm_malloc(sizeof(struct event_fd_handoff))) == NULL) {
+		event_warn("%s: malloc", __func__);
+		return (-1);
+	}
+	h->base = base;
+	h->fd = fd;
+	h->cb = cb;
+	h->arg = arg;
+
+	if (event_base_post(base, event_fd_handoff_cb, h) == -1) {
+		mm_free(h);
+		return (-1);
+	}
+	return (0);
+}
+
+int
+event_base_group_assign_fd(struct event_base_group *group, int fd,
+    void (*cb)(struct event_base *, int, void *), void *arg)
+{
+	struct event_base *base = event_base_group_select(group, fd);
+
+	return (event_base_handoff_fd(base, fd, cb, arg));
+}
@@ -86,6 +86,35 @@ struct evhttp *evhttp_new(struct event_base *base);
  */
 int evhttp_bind_socket(struct evhttp *http, const char *address, u_short port);
 
+/**
+ * Flags for evhttp_bind_socket_with_flags()
+ */
+/*@{*/
+/** bind with SO_REUSEPORT, so that a server per base can bind the port */
+#define EVHTTP_BIND_REUSEPORT	0x01
+/** accept with an EV_EXCLUSIVE event, to wake one of the bases sharing it */
+#define EVHTTP_BIND_EXCLUSIVE	0x02
+/*@}*/
+
+/**
+ * Binds an HTTP server on the specified address and port, with flags.
+ *
+ * To spread the connections to a port over several bases, either give
+ * each base its own evhttp bound with EVHTTP_BIND_REUSEPORT, so that the
+ * kernel hands each connection to one of their sockets, or bind one
+ * socket and pass a dup() of it to evhttp_accept_socket_with_flags() with
+ * EVHTTP_BIND_EXCLUSIVE for each of them.
+ *
+ * @param http a pointer to an evhttp object
+ * @param address a string containing the IP address to listen(2) on
+ * @param port the port number to listen on
+ * @param flags EVHTTP_BIND_REUSEPORT and EVHTTP_BIND_EXCLUSIVE
+ * @return 0 on success, -1 on failure, also if SO_REUSEPORT is missing
+ * @see evhttp_bind_socket(), evhttp_accept_socket_with_flags()
+ */
+int evhttp_bind_socket_with_flags(struct evhttp *http, const char *address,
+    u_short port, int flags);
+
 /**
  * Makes an HTTP server accept connections on the specified socket
  *
@@ -104,6 +133,20 @@ int evhttp_bind_socket(struct evhttp *http, const char *address, u_short port);
  */
 int evhttp_accept_socket(struct evhttp *http, int fd);
 
+/**
+ * Makes an HTTP server accept connections on the specified socket, with flags.
+ *
+ * Only EVHTTP_BIND_EXCLUSIVE applies here.  evhttp_free() closes the
+ * socket, so every server sharing one needs its own dup() of it.
+ *
+ * @param http a pointer to an evhttp object
+ * @param fd a socket fd that is ready for accepting connections
+ * @param flags EVHTTP_BIND_EXCLUSIVE or 0
+ * @return 0 on success, -1 on failure.
+ * @see evhttp_accept_socket(), event_base_get_features()
+ */
+int evhttp_accept_socket_with_flags(struct evhttp *http, int fd, int flags);
+
 /**
  * Free the previously created HTTP server.
  *
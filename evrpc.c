@@ -59,11 +59,13 @@
 #include "evhttp.h"
 #include "evutil.h"
 #include "log.h"
+#define EVENT_MM_MODULE EVENT_MEM_RPC
+#include "mm-internal.h"
 
 struct evrpc_base *
 evrpc_init(struct evhttp *http_server)
 {
-	struct evrpc_base* base = calloc(1, sizeof(struct evrpc_base));
+	struct evrpc_base* base = mm_calloc(1, sizeof(struct evrpc_base));
 	if (base == NULL)
 		return (NULL);
 
@@ -93,7 +95,7 @@ evrpc_free(struct evrpc_base *base)
 	while ((hook = TAILQ_FIRST(&base->output_hooks)) != NULL) {
 		assert(evrpc_remove_hook(base, EVRPC_OUTPUT, hook));
 	}
-	free(base);
+	mm_free(base);
 }
 
 void *
@@ -116,7 +118,7 @@ evrpc_add_hook(void *vbase,
 		assert(hook_type == EVRPC_INPUT || hook_type == EVRPC_OUTPUT);
 	}
 
-	hook = calloc(1, sizeof(struct evrpc_hook));
+	hook = mm_calloc(1, sizeof(struct evrpc_hook));
 	assert(hook != NULL);
 	
 	hook->process = cb;
@@ -133,7 +135,7 @@ evrpc_remove_hook_internal(struct evrpc_hook_list *head, void *handle)
 	TAILQ_FOREACH(hook, head, next) {
 		if (hook == handle) {
 			TAILQ_REMOVE(head, hook, next);
-			free(hook);
+			mm_free(hook);
 			return (1);
 		}
 	}
@@ -194,7 +196,7 @@ evrpc_construct_uri(const char *uri)
 	int constructed_uri_len;
 
 	constructed_uri_len = strlen(EVRPC_URI_PREFIX) + strlen(uri) + 1;
-	if ((constructed_uri = malloc(constructed_uri_len)) == NULL)
+	if ((constructed_uri = mm_malloc(constructed_uri_len)) == NULL)
 		event_err(1, "%s: failed to register rpc at %s",
 		    __func__, uri);
 	memcpy(constructed_uri, EVRPC_URI_PREFIX, strlen(EVRPC_URI_PREFIX));
@@ -221,7 +223,7 @@ evrpc_register_rpc(struct evrpc_base *base, struct evrpc *rpc,
 	    evrpc_request_cb,
 	    rpc);
 	
-	free(constructed_uri);
+	mm_free(constructed_uri);
 
 	return (0);
 }
@@ -243,6 +245,7 @@ evrpc_unregister_rpc(struct evrpc_base *base, const char *name)
 	}
 	TAILQ_REMOVE(&base->registered_rpcs, rpc, next);
 	
+	/* allocated with calloc() and strdup() by EVRPC_REGISTER() */
 	free((char *)rpc->uri);
 	free(rpc);
 
@@ -251,7 +254,7 @@ evrpc_unregister_rpc(struct evrpc_base *base, const char *name)
 	/* remove the http server callback */
 	assert(evhttp_del_cb(base->http_server, registered_uri) == 0);
 
-	free(registered_uri);
+	mm_free(registered_uri);
 	return (0);
 }
 
@@ -275,7 +278,7 @@ evrpc_request_cb(struct evhttp_request *req, void *arg)
 		req, req->input_buffer) == -1)
 		goto error;
 
-	rpc_state = calloc(1, sizeof(struct evrpc_req_generic));
+	rpc_state = mm_calloc(1, sizeof(struct evrpc_req_generic));
 	if (rpc_state == NULL)
 		goto error;
 
@@ -323,7 +326,7 @@ evrpc_reqstate_free(struct evrpc_req_generic* rpc_state)
 			rpc->request_free(rpc_state->request);
 		if (rpc_state->reply != NULL)
 			rpc->reply_free(rpc_state->reply);
-		free(rpc_state);
+		mm_free(rpc_state);
 	}
 }
 
@@ -382,7 +385,7 @@ static int evrpc_schedule_request(struct evhttp_connection *connection,
 struct evrpc_pool *
 evrpc_pool_new(struct event_base *base)
 {
-	struct evrpc_pool *pool = calloc(1, sizeof(struct evrpc_pool));
+	struct evrpc_pool *pool = mm_calloc(1, sizeof(struct evrpc_pool));
 	if (pool == NULL)
 		return (NULL);
 
@@ -401,6 +404,7 @@ evrpc_pool_new(struct event_base *base)
 static void
 evrpc_request_wrapper_free(struct evrpc_request_wrapper *request)
 {
+	/* allocated with malloc() and strdup() by the EVRPC_GENERATE() stubs */
 	free(request->name);
 	free(request);
 }
@@ -431,7 +435,7 @@ evrpc_pool_free(struct evrpc_pool *pool)
 		assert(evrpc_remove_hook(pool, EVRPC_OUTPUT, hook));
 	}
 
-	free(pool);
+	mm_free(pool);
 }
 
 /*
@@ -537,14 +541,17 @@ evrpc_schedule_request(struct evhttp_connection *connection,
 		 * a timeout after which the whole rpc is going to be aborted.
 		 */
 		struct timeval tv;
+		const struct timeval *ptv;
 		evutil_timerclear(&tv);
 		tv.tv_sec = pool->timeout;
-		evtimer_add(&ctx->ev_timeout, &tv);
+		ptv = event_base_init_common_timeout(ctx->ev_timeout.ev_base,
+		    &tv);
+		evtimer_add(&ctx->ev_timeout, ptv != NULL ? ptv : &tv);
 	}
 
 	/* start the request over the connection */
 	res = evhttp_make_request(connection, req, EVHTTP_REQ_POST, uri);
-	free(uri);
+	mm_free(uri);
 
 	if (res == -1)
 		goto error;
@@ -61,11 +61,23 @@ struct evsignal_info {
 	ev_sighandler_t **sh_old;
 #endif
 	int sh_old_max;
+
+	/*
+	 * With EVBASE_SIGNALFD, signals are read from sigfd instead, and
+	 * ev_signal watches it; sigfd is -1 otherwise.
+	 */
+	int sigfd;
+#ifdef HAVE_SYS_SIGNALFD_H
+	sigset_t sigfd_mask;		/* signals sigfd reports */
+	sigset_t sigfd_blocked;		/* signals we had to block for it */
+#endif
 };
 int evsignal_init(struct event_base *);
 void evsignal_process(struct event_base *);
 int evsignal_add(struct event *);
 int evsignal_del(struct event *);
 void evsignal_dealloc(struct event_base *);
+/* called in the child after a fork, with ev_signal not added */
+int evsignal_reopen(struct event_base *);
 
 #endif /* _EVSIGNAL_H_ */
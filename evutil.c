@@ -218,6 +218,20 @@ evutil_make_socket_nonblocking(int fd)
 	return 0;
 }
 
+int
+evutil_make_listen_socket_reuseable_port(int sock)
+{
+#ifdef SO_REUSEPORT
+	int on = 1;
+
+	/* the kernel spreads new connections over the sockets on the port */
+	return (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (void *)&on,
+	    sizeof(on)));
+#else
+	return (-1);
+#endif
+}
+
 ev_int64_t
 evutil_strtoll(const char *s, char **endptr, int base)
 {
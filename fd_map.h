@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2026 The libevent contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _FD_MAP_H_
+#define _FD_MAP_H_
+
+#include <string.h>
+
+#include "event.h"
+#include "mm-internal.h"
+
+/*
+ * A two-level map from file descriptors to the per-fd state of a backend.
+ *
+ * The directory has a pointer for every page of FDMAP_PAGE_SIZE fds and
+ * only grows as far as the highest page in use; a page is allocated when
+ * the first of its fds is looked up with fd_map_get() and freed when the
+ * backend marks the last of them unused.  A few high fds thus cost a few
+ * pages instead of an array up to the highest fd ever seen.
+ *
+ * Entries are zeroed when their page is allocated.  A backend marks an
+ * entry used while it holds any state and must leave it zeroed when it
+ * marks it unused, since the page may then be freed or handed out again
+ * as it is.
+ */
+
+#define FDMAP_PAGE_BITS		6
+#define FDMAP_PAGE_SIZE		(1 << FDMAP_PAGE_BITS)
+#define FDMAP_PAGE_MASK		(FDMAP_PAGE_SIZE - 1)
+
+struct fd_map_page {
+	ev_uint64_t used[FDMAP_PAGE_SIZE / 64];	/* bitmap of used entries */
+	unsigned nused;
+	/* FDMAP_PAGE_SIZE entries follow */
+};
+
+typedef struct fd_map {
+	struct fd_map_page **pages;
+	int npages;
+	size_t entsize;
+} fd_map_t;
+
+static inline void		fd_map_ctor(fd_map_t *m, size_t entsize);
+static inline void		fd_map_dtor(fd_map_t *m);
+static inline void *		fd_map_find(fd_map_t *m, int fd);
+static inline void *		fd_map_get(fd_map_t *m, int fd);
+static inline void		fd_map_mark(fd_map_t *m, int fd, int used);
+
+#define FDMAP_ENTRY_(m, p, fd)						\
+	((void *)((char *)((p) + 1) + ((fd) & FDMAP_PAGE_MASK) * (m)->entsize))
+
+static inline void
+fd_map_ctor(fd_map_t *m, size_t entsize)
+{
+	m->pages = NULL;
+	m->npages = 0;
+	m->entsize = entsize;
+}
+
+static inline void
+fd_map_dtor(fd_map_t *m)
+{
+	int i;
+
+	for (i = 0; i < m->npages; i++) {
+		if (m->pages[i] != NULL)
+			mm_free(m->pages[i]);
+	}
+	if (m->pages != NULL)
+		mm_free(m->pages);
+	m->pages = NULL;
+	m->npages = 0;
+}
+
+/* Returns the entry of fd, or NULL if its page does not exist */
+static inline void *
+fd_map_find(fd_map_t *m, int fd)
+{
+	struct fd_map_page *p;
+	int idx = fd >> FDMAP_PAGE_BITS;
+
+	if (fd < 0 || idx >= m->npages || (p = m->pages[idx]) == NULL)
+		return (NULL);
+	return (FDMAP_ENTRY_(m, p, fd));
+}
+
+/* Returns the entry of fd, allocating its page; NULL on failure */
+static inline void *
+fd_map_get(fd_map_t *m, int fd)
+{
+	struct fd_map_page *p;
+	int idx = fd >> FDMAP_PAGE_BITS;
+
+	if (fd < 0)
+		return (NULL);
+	if (idx >= m->npages) {
+		struct fd_map_page **pages;
+		int npages = m->npages ? m->npages : 1;
+
+		while (npages <= idx)
+			npages <<= 1;
+		pages = mm_realloc(m->pages, npages * sizeof(*pages));
+		if (pages == NULL)
+			return (NULL);
+		memset(pages + m->npages, 0,
+		    (npages - m->npages) * sizeof(*pages));
+		m->pages = pages;
+		m->npages = npages;
+	}
+	if ((p = m->pages[idx]) == NULL) {
+		p = mm_calloc(1, sizeof(struct fd_map_page) +
+		    FDMAP_PAGE_SIZE * m->entsize);
+		if (p == NULL)
+			return (NULL);
+		m->pages[idx] = p;
+	}
+	return (FDMAP_ENTRY_(m, p, fd));
+}
+
+/*
+ * Records whether the entry of fd is in use.  The page goes away once
+ * none of its entries is, which includes a page that fd_map_get() just
+ * allocated for an entry that ended up unused.
+ */
+static inline void
+fd_map_mark(fd_map_t *m, int fd, int used)
+{
+	struct fd_map_page *p;
+	int idx = fd >> FDMAP_PAGE_BITS, bit = fd & FDMAP_PAGE_MASK;
+	ev_uint64_t mask = ((ev_uint64_t)1) << (bit & 63);
+	ev_uint64_t *word;
+
+	if (fd < 0 || idx >= m->npages || (p = m->pages[idx]) == NULL)
+		return;
+	word = &p->used[bit >> 6];
+	if (used && !(*word & mask)) {
+		*word |= mask;
+		p->nused++;
+	} else if (!used && (*word & mask)) {
+		*word &= ~mask;
+		p->nused--;
+	}
+	if (p->nused == 0) {
+		mm_free(p);
+		m->pages[idx] = NULL;
+	}
+}
+
+#endif /* _FD_MAP_H_ */
@@ -107,7 +107,7 @@ TAILQ_HEAD(evconq, evhttp_connection);
 struct evhttp_bound_socket {
 	TAILQ_ENTRY(evhttp_bound_socket) (next);
 
-	struct event  bind_ev;
+	struct evlistener *listener;
 };
 
 struct evhttp {
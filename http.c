@@ -88,6 +88,8 @@
 #include "evutil.h"
 #include "log.h"
 #include "http-internal.h"
+#define EVENT_MM_MODULE EVENT_MEM_HTTP
+#include "mm-internal.h"
 
 #ifdef WIN32
 #define strcasecmp _stricmp
@@ -164,7 +166,7 @@ fake_getaddrinfo(const char *hostname, struct addrinfo *ai)
 	ai->ai_socktype = SOCK_STREAM;
 	ai->ai_protocol = 0;
 	ai->ai_addrlen = sizeof(struct sockaddr_in);
-	if (NULL == (ai->ai_addr = malloc(ai->ai_addrlen)))
+	if (NULL == (ai->ai_addr = mm_malloc(ai->ai_addrlen)))
 		return (-1);
 	sa = (struct sockaddr_in*)ai->ai_addr;
 	memset(sa, 0, ai->ai_addrlen);
@@ -181,7 +183,7 @@ fake_getaddrinfo(const char *hostname, struct addrinfo *ai)
 static void
 fake_freeaddrinfo(struct addrinfo *ai)
 {
-	free(ai->ai_addr);
+	mm_free(ai->ai_addr);
 }
 #endif
 
@@ -197,8 +199,8 @@ fake_freeaddrinfo(struct addrinfo *ai)
 extern int debug;
 
 static int socket_connect(int fd, const char *address, unsigned short port);
-static int bind_socket_ai(struct addrinfo *, int reuse);
-static int bind_socket(const char *, u_short, int reuse);
+static int bind_socket_ai(struct addrinfo *, int reuse, int flags);
+static int bind_socket(const char *, u_short, int reuse, int flags);
 static void name_from_addr(struct sockaddr *, socklen_t, char **, char **);
 static int evhttp_associate_new_request_with_connection(
 	struct evhttp_connection *evcon);
@@ -282,7 +284,7 @@ evhttp_htmlescape(const char *html)
 	for (i = 0; i < old_size; ++i)
           new_size += strlen(html_replace(html[i], scratch_space));
 
-	p = escaped_html = malloc(new_size + 1);
+	p = escaped_html = mm_malloc_export(new_size + 1);
 	if (escaped_html == NULL)
 		event_err(1, "%s: malloc(%d)", __func__, new_size + 1);
 	for (i = 0; i < old_size; ++i) {
@@ -325,10 +327,12 @@ evhttp_add_event(struct event *ev, int timeout, int default_timeout)
 {
 	if (timeout != 0) {
 		struct timeval tv;
+		const struct timeval *ptv;
 		
 		evutil_timerclear(&tv);
 		tv.tv_sec = timeout != -1 ? timeout : default_timeout;
-		event_add(ev, &tv);
+		ptv = event_base_init_common_timeout(ev->ev_base, &tv);
+		event_add(ev, ptv != NULL ? ptv : &tv);
 	} else {
 		event_add(ev, NULL);
 	}
@@ -419,7 +423,8 @@ evhttp_is_connection_keepalive(struct evkeyvalq* headers)
 }
 
 static void
-evhttp_maybe_add_date_header(struct evkeyvalq *headers)
+evhttp_maybe_add_date_header(struct event_base *base,
+    struct evkeyvalq *headers)
 {
 	if (evhttp_find_header(headers, "Date") == NULL) {
 		char date[50];
@@ -427,7 +432,12 @@ evhttp_maybe_add_date_header(struct evkeyvalq *headers)
 		struct tm cur;
 #endif
 		struct tm *cur_p;
-		time_t t = time(NULL);
+		struct timeval tv;
+		time_t t;
+
+		/* the loop already read the clock when it woke up */
+		event_base_gettimeofday_cached(base, &tv);
+		t = tv.tv_sec;
 #ifdef WIN32
 		cur_p = gmtime(&t);
 #else
@@ -468,7 +478,8 @@ evhttp_make_header_response(struct evhttp_connection *evcon,
 
 	if (req->major == 1) {
 		if (req->minor == 1)
-			evhttp_maybe_add_date_header(req->output_headers);
+			evhttp_maybe_add_date_header(evcon->base,
+			    req->output_headers);
 
 		/*
 		 * if the protocol is 1.0; and the connection was keep-alive
@@ -613,7 +624,7 @@ evhttp_connection_incoming_fail(struct evhttp_request *req,
 	default:	/* xxx: probably should just error on default */
 		/* the callback looks at the uri to determine errors */
 		if (req->uri) {
-			free(req->uri);
+			mm_free(req->uri);
 			req->uri = NULL;
 		}
 
@@ -796,14 +807,14 @@ evhttp_handle_chunked_read(struct evhttp_request *req, struct evbuffer *buf)
 				break;
 			/* the last chunk is on a new line? */
 			if (strlen(p) == 0) {
-				free(p);
+				mm_free_export(p);
 				continue;
 			}
 			ntoread = evutil_strtoll(p, &endp, 16);
 			error = (*p == '\0' ||
 			    (*endp != '\0' && *endp != ' ') ||
 			    ntoread < 0);
-			free(p);
+			mm_free_export(p);
 			if (error) {
 				/* could not get chunk size */
 				return (DATA_CORRUPTED);
@@ -821,9 +832,8 @@ evhttp_handle_chunked_read(struct evhttp_request *req, struct evbuffer *buf)
 			return (MORE_DATA_EXPECTED);
 
 		/* Completed chunk */
-		evbuffer_add(req->input_buffer,
-		    EVBUFFER_DATA(buf), (size_t)req->ntoread);
-		evbuffer_drain(buf, (size_t)req->ntoread);
+		evbuffer_remove_buffer(buf, req->input_buffer,
+		    (size_t)req->ntoread);
 		req->ntoread = -1;
 		if (req->chunk_cb != NULL) {
 			(*req->chunk_cb)(req, req->cb_arg);
@@ -886,9 +896,8 @@ evhttp_read_body(struct evhttp_connection *evcon, struct evhttp_request *req)
 		evbuffer_add_buffer(req->input_buffer, buf);
 	} else if (EVBUFFER_LENGTH(buf) >= req->ntoread) {
 		/* Completed content length */
-		evbuffer_add(req->input_buffer, EVBUFFER_DATA(buf),
+		evbuffer_remove_buffer(buf, req->input_buffer,
 		    (size_t)req->ntoread);
-		evbuffer_drain(buf, (size_t)req->ntoread);
 		req->ntoread = 0;
 		evhttp_connection_done(evcon);
 		return;
@@ -1011,10 +1020,10 @@ evhttp_connection_free(struct evhttp_connection *evcon)
 		EVUTIL_CLOSESOCKET(evcon->fd);
 
 	if (evcon->bind_address != NULL)
-		free(evcon->bind_address);
+		mm_free(evcon->bind_address);
 
 	if (evcon->address != NULL)
-		free(evcon->address);
+		mm_free(evcon->address);
 
 	if (evcon->input_buffer != NULL)
 		evbuffer_free(evcon->input_buffer);
@@ -1022,7 +1031,7 @@ evhttp_connection_free(struct evhttp_connection *evcon)
 	if (evcon->output_buffer != NULL)
 		evbuffer_free(evcon->output_buffer);
 
-	free(evcon);
+	mm_free(evcon);
 }
 
 void
@@ -1031,8 +1040,8 @@ evhttp_connection_set_local_address(struct evhttp_connection *evcon,
 {
 	assert(evcon->state == EVCON_DISCONNECTED);
 	if (evcon->bind_address)
-		free(evcon->bind_address);
-	if ((evcon->bind_address = strdup(address)) == NULL)
+		mm_free(evcon->bind_address);
+	if ((evcon->bind_address = mm_strdup(address)) == NULL)
 		event_err(1, "%s: strdup", __func__);
 }
 
@@ -1242,7 +1251,7 @@ evhttp_parse_response_line(struct evhttp_request *req, char *line)
 		return (-1);
 	}
 
-	if ((req->response_code_line = strdup(readable)) == NULL)
+	if ((req->response_code_line = mm_strdup(readable)) == NULL)
 		event_err(1, "%s: strdup", __func__);
 
 	return (0);
@@ -1293,7 +1302,7 @@ evhttp_parse_request_line(struct evhttp_request *req, char *line)
 		return (-1);
 	}
 
-	if ((req->uri = strdup(uri)) == NULL) {
+	if ((req->uri = mm_strdup(uri)) == NULL) {
 		event_debug(("%s: evhttp_decode_uri", __func__));
 		return (-1);
 	}
@@ -1327,9 +1336,9 @@ evhttp_clear_headers(struct evkeyvalq *headers)
 	    header != NULL;
 	    header = TAILQ_FIRST(headers)) {
 		TAILQ_REMOVE(headers, header, next);
-		free(header->key);
-		free(header->value);
-		free(header);
+		mm_free(header->key);
+		mm_free(header->value);
+		mm_free(header);
 	}
 }
 
@@ -1353,9 +1362,9 @@ evhttp_remove_header(struct evkeyvalq *headers, const char *key)
 
 	/* Free and remove the header that we found */
 	TAILQ_REMOVE(headers, header, next);
-	free(header->key);
-	free(header->value);
-	free(header);
+	mm_free(header->key);
+	mm_free(header->value);
+	mm_free(header);
 
 	return (0);
 }
@@ -1399,19 +1408,19 @@ static int
 evhttp_add_header_internal(struct evkeyvalq *headers,
     const char *key, const char *value)
 {
-	struct evkeyval *header = calloc(1, sizeof(struct evkeyval));
+	struct evkeyval *header = mm_calloc(1, sizeof(struct evkeyval));
 	if (header == NULL) {
 		event_warn("%s: calloc", __func__);
 		return (-1);
 	}
-	if ((header->key = strdup(key)) == NULL) {
-		free(header);
+	if ((header->key = mm_strdup(key)) == NULL) {
+		mm_free(header);
 		event_warn("%s: strdup", __func__);
 		return (-1);
 	}
-	if ((header->value = strdup(value)) == NULL) {
-		free(header->key);
-		free(header);
+	if ((header->value = mm_strdup(value)) == NULL) {
+		mm_free(header->key);
+		mm_free(header);
 		event_warn("%s: strdup", __func__);
 		return (-1);
 	}
@@ -1454,7 +1463,7 @@ evhttp_parse_firstline(struct evhttp_request *req, struct evbuffer *buffer)
 		status = DATA_CORRUPTED;
 	}
 
-	free(line);
+	mm_free_export(line);
 	return (status);
 }
 
@@ -1471,7 +1480,7 @@ evhttp_append_to_last_header(struct evkeyvalq *headers, const char *line)
 	old_len = strlen(header->value);
 	line_len = strlen(line);
 
-	newval = realloc(header->value, old_len + line_len + 1);
+	newval = mm_realloc(header->value, old_len + line_len + 1);
 	if (newval == NULL)
 		return (-1);
 
@@ -1494,7 +1503,7 @@ evhttp_parse_headers(struct evhttp_request *req, struct evbuffer* buffer)
 
 		if (*line == '\0') { /* Last header - Done */
 			status = ALL_DATA_READ;
-			free(line);
+			mm_free_export(line);
 			break;
 		}
 
@@ -1502,7 +1511,7 @@ evhttp_parse_headers(struct evhttp_request *req, struct evbuffer* buffer)
 		if (*line == ' ' || *line == '\t') {
 			if (evhttp_append_to_last_header(headers, line) == -1)
 				goto error;
-			free(line);
+			mm_free_export(line);
 			continue;
 		}
 
@@ -1517,13 +1526,13 @@ evhttp_parse_headers(struct evhttp_request *req, struct evbuffer* buffer)
 		if (evhttp_add_header(headers, skey, svalue) == -1)
 			goto error;
 
-		free(line);
+		mm_free_export(line);
 	}
 
 	return (status);
 
  error:
-	free(line);
+	mm_free_export(line);
 	return (DATA_CORRUPTED);
 }
 
@@ -1680,7 +1689,7 @@ evhttp_connection_new(const char *address, unsigned short port)
 	
 	event_debug(("Attempting connection to %s:%d\n", address, port));
 
-	if ((evcon = calloc(1, sizeof(struct evhttp_connection))) == NULL) {
+	if ((evcon = mm_calloc(1, sizeof(struct evhttp_connection))) == NULL) {
 		event_warn("%s: calloc failed", __func__);
 		goto error;
 	}
@@ -1691,7 +1700,7 @@ evhttp_connection_new(const char *address, unsigned short port)
 	evcon->timeout = -1;
 	evcon->retry_cnt = evcon->retry_max = 0;
 
-	if ((evcon->address = strdup(address)) == NULL) {
+	if ((evcon->address = mm_strdup(address)) == NULL) {
 		event_warn("%s: strdup failed", __func__);
 		goto error;
 	}
@@ -1767,7 +1776,7 @@ evhttp_connection_connect(struct evhttp_connection *evcon)
 	evcon->flags |= EVHTTP_CON_OUTGOING;
 	
 	evcon->fd = bind_socket(
-		evcon->bind_address, evcon->bind_port, 0 /*reuse*/);
+		evcon->bind_address, evcon->bind_port, 0 /*reuse*/, 0);
 	if (evcon->fd == -1) {
 		event_debug(("%s: failed to bind to \"%s\"",
 			__func__, evcon->bind_address));
@@ -1804,8 +1813,8 @@ evhttp_make_request(struct evhttp_connection *evcon,
 	req->kind = EVHTTP_REQUEST;
 	req->type = type;
 	if (req->uri != NULL)
-		free(req->uri);
-	if ((req->uri = strdup(uri)) == NULL)
+		mm_free(req->uri);
+	if ((req->uri = mm_strdup(uri)) == NULL)
 		event_err(1, "%s: strdup", __func__);
 
 	/* Set the protocol version if it is not supplied */
@@ -1993,8 +2002,8 @@ evhttp_response_code(struct evhttp_request *req, int code, const char *reason)
 	req->kind = EVHTTP_RESPONSE;
 	req->response_code = code;
 	if (req->response_code_line != NULL)
-		free(req->response_code_line);
-	req->response_code_line = strdup(reason);
+		mm_free(req->response_code_line);
+	req->response_code_line = mm_strdup(reason);
 }
 
 void
@@ -2055,7 +2064,7 @@ evhttp_encode_uri(const char *uri)
 		}
 	}
 	evbuffer_add(buf, "", 1);
-	p = strdup((char *)EVBUFFER_DATA(buf));
+	p = mm_strdup_export((char *)EVBUFFER_DATA(buf));
 	evbuffer_free(buf);
 	
 	return (p);
@@ -2096,7 +2105,7 @@ evhttp_decode_uri(const char *uri)
 {
 	char *ret;
 
-	if ((ret = malloc(strlen(uri) + 1)) == NULL)
+	if ((ret = mm_malloc_export(strlen(uri) + 1)) == NULL)
 		event_err(1, "%s: malloc(%lu)", __func__,
 			  (unsigned long)(strlen(uri) + 1));
 
@@ -2124,7 +2133,7 @@ evhttp_parse_query(const char *uri, struct evkeyvalq *headers)
 	if (strchr(uri, '?') == NULL)
 		return;
 
-	if ((line = strdup(uri)) == NULL)
+	if ((line = mm_strdup(uri)) == NULL)
 		event_err(1, "%s: strdup", __func__);
 
 
@@ -2143,18 +2152,18 @@ evhttp_parse_query(const char *uri, struct evkeyvalq *headers)
 		if (value == NULL)
 			goto error;
 
-		if ((decoded_value = malloc(strlen(value) + 1)) == NULL)
+		if ((decoded_value = mm_malloc(strlen(value) + 1)) == NULL)
 			event_err(1, "%s: malloc", __func__);
 
 		evhttp_decode_uri_internal(value, strlen(value),
 		    decoded_value, 1 /*always_decode_plus*/);
 		event_debug(("Query Param: %s -> %s\n", key, decoded_value));
 		evhttp_add_header_internal(headers, key, decoded_value);
-		free(decoded_value);
+		mm_free(decoded_value);
 	}
 
  error:
-	free(line);
+	mm_free(line);
 }
 
 static struct evhttp_cb *
@@ -2220,7 +2229,7 @@ evhttp_handle_request(struct evhttp_request *req, void *arg)
 
 		evbuffer_add_printf(buf, ERR_FORMAT, escaped_html);
 
-		free(escaped_html);
+		mm_free_export(escaped_html);
 
 		evhttp_send_page(req, buf);
 
@@ -2230,31 +2239,28 @@ evhttp_handle_request(struct evhttp_request *req, void *arg)
 }
 
 static void
-accept_socket(int fd, short what, void *arg)
+accept_socket(struct evlistener *lev, int nfd, struct sockaddr *sa,
+    int socklen, void *arg)
 {
 	struct evhttp *http = arg;
-	struct sockaddr_storage ss;
-	socklen_t addrlen = sizeof(ss);
-	int nfd;
 
-	if ((nfd = accept(fd, (struct sockaddr *)&ss, &addrlen)) == -1) {
-		if (errno != EAGAIN && errno != EINTR)
-			event_warn("%s: bad accept", __func__);
-		return;
-	}
-	if (evutil_make_socket_nonblocking(nfd) < 0)
-		return;
-
-	evhttp_get_request(http, nfd, (struct sockaddr *)&ss, addrlen);
+	evhttp_get_request(http, nfd, sa, socklen);
 }
 
 int
 evhttp_bind_socket(struct evhttp *http, const char *address, u_short port)
+{
+	return (evhttp_bind_socket_with_flags(http, address, port, 0));
+}
+
+int
+evhttp_bind_socket_with_flags(struct evhttp *http, const char *address,
+    u_short port, int flags)
 {
 	int fd;
 	int res;
 
-	if ((fd = bind_socket(address, port, 1 /*reuse*/)) == -1)
+	if ((fd = bind_socket(address, port, 1 /*reuse*/, flags)) == -1)
 		return (-1);
 
 	if (listen(fd, 128) == -1) {
@@ -2263,7 +2269,7 @@ evhttp_bind_socket(struct evhttp *http, const char *address, u_short port)
 		return (-1);
 	}
 
-	res = evhttp_accept_socket(http, fd);
+	res = evhttp_accept_socket_with_flags(http, fd, flags);
 	
 	if (res != -1)
 		event_debug(("Bound to port %d - Awaiting connections ... ",
@@ -2274,25 +2280,28 @@ evhttp_bind_socket(struct evhttp *http, const char *address, u_short port)
 
 int
 evhttp_accept_socket(struct evhttp *http, int fd)
+{
+	return (evhttp_accept_socket_with_flags(http, fd, 0));
+}
+
+int
+evhttp_accept_socket_with_flags(struct evhttp *http, int fd, int flags)
 {
 	struct evhttp_bound_socket *bound;
-	struct event *ev;
-	int res;
+	int lev_flags = EVLISTENER_CLOSE_ON_FREE;
 
-	bound = malloc(sizeof(struct evhttp_bound_socket));
+	bound = mm_malloc(sizeof(struct evhttp_bound_socket));
 	if (bound == NULL)
 		return (-1);
 
-	ev = &bound->bind_ev;
+	if (flags & EVHTTP_BIND_EXCLUSIVE)
+		lev_flags |= EVLISTENER_EXCLUSIVE;
 
 	/* Schedule the socket for accepting */
-	event_set(ev, fd, EV_READ | EV_PERSIST, accept_socket, http);
-	EVHTTP_BASE_SET(http, ev);
-
-	res = event_add(ev, NULL);
-
-	if (res == -1) {
-		free(bound);
+	bound->listener = evlistener_new(http->base, accept_socket, http,
+	    lev_flags, fd);
+	if (bound->listener == NULL) {
+		mm_free(bound);
 		return (-1);
 	}
 
@@ -2306,7 +2315,7 @@ evhttp_new_object(void)
 {
 	struct evhttp *http = NULL;
 
-	if ((http = calloc(1, sizeof(struct evhttp))) == NULL) {
+	if ((http = mm_calloc(1, sizeof(struct evhttp))) == NULL) {
 		event_warn("%s: calloc", __func__);
 		return (NULL);
 	}
@@ -2340,7 +2349,7 @@ evhttp_start(const char *address, u_short port)
 	struct evhttp *http = evhttp_new_object();
 
 	if (evhttp_bind_socket(http, address, port) == -1) {
-		free(http);
+		mm_free(http);
 		return (NULL);
 	}
 
@@ -2353,17 +2362,13 @@ evhttp_free(struct evhttp* http)
 	struct evhttp_cb *http_cb;
 	struct evhttp_connection *evcon;
 	struct evhttp_bound_socket *bound;
-	int fd;
 
 	/* Remove the accepting part */
 	while ((bound = TAILQ_FIRST(&http->sockets)) != NULL) {
 		TAILQ_REMOVE(&http->sockets, bound, next);
 
-		fd = bound->bind_ev.ev_fd;
-		event_del(&bound->bind_ev);
-		EVUTIL_CLOSESOCKET(fd);
-
-		free(bound);
+		evlistener_free(bound->listener);
+		mm_free(bound);
 	}
 
 	while ((evcon = TAILQ_FIRST(&http->connections)) != NULL) {
@@ -2373,11 +2378,11 @@ evhttp_free(struct evhttp* http)
 
 	while ((http_cb = TAILQ_FIRST(&http->callbacks)) != NULL) {
 		TAILQ_REMOVE(&http->callbacks, http_cb, next);
-		free(http_cb->what);
-		free(http_cb);
+		mm_free(http_cb->what);
+		mm_free(http_cb);
 	}
 	
-	free(http);
+	mm_free(http);
 }
 
 void
@@ -2392,10 +2397,10 @@ evhttp_set_cb(struct evhttp *http, const char *uri,
 {
 	struct evhttp_cb *http_cb;
 
-	if ((http_cb = calloc(1, sizeof(struct evhttp_cb))) == NULL)
+	if ((http_cb = mm_calloc(1, sizeof(struct evhttp_cb))) == NULL)
 		event_err(1, "%s: calloc", __func__);
 
-	http_cb->what = strdup(uri);
+	http_cb->what = mm_strdup(uri);
 	http_cb->cb = cb;
 	http_cb->cbarg = cbarg;
 
@@ -2415,8 +2420,8 @@ evhttp_del_cb(struct evhttp *http, const char *uri)
 		return (-1);
 
 	TAILQ_REMOVE(&http->callbacks, http_cb, next);
-	free(http_cb->what);
-	free(http_cb);
+	mm_free(http_cb->what);
+	mm_free(http_cb);
 
 	return (0);
 }
@@ -2439,20 +2444,20 @@ evhttp_request_new(void (*cb)(struct evhttp_request *, void *), void *arg)
 	struct evhttp_request *req = NULL;
 
 	/* Allocate request structure */
-	if ((req = calloc(1, sizeof(struct evhttp_request))) == NULL) {
+	if ((req = mm_calloc(1, sizeof(struct evhttp_request))) == NULL) {
 		event_warn("%s: calloc", __func__);
 		goto error;
 	}
 
 	req->kind = EVHTTP_RESPONSE;
-	req->input_headers = calloc(1, sizeof(struct evkeyvalq));
+	req->input_headers = mm_calloc(1, sizeof(struct evkeyvalq));
 	if (req->input_headers == NULL) {
 		event_warn("%s: calloc", __func__);
 		goto error;
 	}
 	TAILQ_INIT(req->input_headers);
 
-	req->output_headers = calloc(1, sizeof(struct evkeyvalq));
+	req->output_headers = mm_calloc(1, sizeof(struct evkeyvalq));
 	if (req->output_headers == NULL) {
 		event_warn("%s: calloc", __func__);
 		goto error;
@@ -2484,17 +2489,17 @@ void
 evhttp_request_free(struct evhttp_request *req)
 {
 	if (req->remote_host != NULL)
-		free(req->remote_host);
+		mm_free(req->remote_host);
 	if (req->uri != NULL)
-		free(req->uri);
+		mm_free(req->uri);
 	if (req->response_code_line != NULL)
-		free(req->response_code_line);
+		mm_free(req->response_code_line);
 
 	evhttp_clear_headers(req->input_headers);
-	free(req->input_headers);
+	mm_free(req->input_headers);
 
 	evhttp_clear_headers(req->output_headers);
-	free(req->output_headers);
+	mm_free(req->output_headers);
 
 	if (req->input_buffer != NULL)
 		evbuffer_free(req->input_buffer);
@@ -2502,7 +2507,7 @@ evhttp_request_free(struct evhttp_request *req)
 	if (req->output_buffer != NULL)
 		evbuffer_free(req->output_buffer);
 
-	free(req);
+	mm_free(req);
 }
 
 void
@@ -2538,8 +2543,8 @@ evhttp_get_request_connection(
 
 	name_from_addr(sa, salen, &hostname, &portname);
 	if (hostname == NULL || portname == NULL) {
-		if (hostname) free(hostname);
-		if (portname) free(portname);
+		if (hostname) mm_free(hostname);
+		if (portname) mm_free(portname);
 		return (NULL);
 	}
 
@@ -2548,8 +2553,8 @@ evhttp_get_request_connection(
 
 	/* we need a connection object to put the http request on */
 	evcon = evhttp_connection_new(hostname, atoi(portname));
-	free(hostname);
-	free(portname);
+	mm_free(hostname);
+	mm_free(portname);
 	if (evcon == NULL)
 		return (NULL);
 
@@ -2579,7 +2584,7 @@ evhttp_associate_new_request_with_connection(struct evhttp_connection *evcon)
 	
 	req->kind = EVHTTP_REQUEST;
 	
-	if ((req->remote_host = strdup(evcon->address)) == NULL)
+	if ((req->remote_host = mm_strdup(evcon->address)) == NULL)
 		event_err(1, "%s: strdup", __func__);
 	req->remote_port = evcon->port;
 
@@ -2672,14 +2677,14 @@ name_from_addr(struct sockaddr *sa, socklen_t salen,
 	if (ni_result != 0)
 			return;
 #endif
-	*phost = strdup(ntop);
-	*pport = strdup(strport);
+	*phost = mm_strdup(ntop);
+	*pport = mm_strdup(strport);
 }
 
 /* Create a non-blocking socket and bind it */
 /* todo: rename this function */
 static int
-bind_socket_ai(struct addrinfo *ai, int reuse)
+bind_socket_ai(struct addrinfo *ai, int reuse, int flags)
 {
         int fd, on = 1, r;
 	int serrno;
@@ -2706,6 +2711,11 @@ bind_socket_ai(struct addrinfo *ai, int reuse)
 		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
 		    (void *)&on, sizeof(on));
 	}
+	if ((flags & EVHTTP_BIND_REUSEPORT) &&
+	    evutil_make_listen_socket_reuseable_port(fd) == -1) {
+		event_warn("%s: SO_REUSEPORT", __func__);
+		goto out;
+	}
 
 	if (ai != NULL) {
 		r = bind(fd, ai->ai_addr, ai->ai_addrlen);
@@ -2761,21 +2771,21 @@ make_addrinfo(const char *address, u_short port)
 }
 
 static int
-bind_socket(const char *address, u_short port, int reuse)
+bind_socket(const char *address, u_short port, int reuse, int flags)
 {
 	int fd;
 	struct addrinfo *aitop = NULL;
 
 	/* just create an unbound socket */
 	if (address == NULL && port == 0)
-		return bind_socket_ai(NULL, 0);
+		return bind_socket_ai(NULL, 0, 0);
 		
 	aitop = make_addrinfo(address, port);
 
 	if (aitop == NULL)
 		return (-1);
 
-	fd = bind_socket_ai(aitop, reuse);
+	fd = bind_socket_ai(aitop, reuse, flags);
 
 #ifdef HAVE_GETADDRINFO
 	freeaddrinfo(aitop);
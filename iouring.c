@@ -0,0 +1,548 @@
+/*
+ * Copyright (c) 2026 The libevent contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else
+#include <sys/_libevent_time.h>
+#endif
+#include <sys/queue.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#include "event.h"
+#include "event-internal.h"
+#include "evsignal.h"
+#include "fd_map.h"
+#include "log.h"
+#include "mm-internal.h"
+
+/*
+ * The io_uring backend arms a one-shot IORING_OP_POLL_ADD request for
+ * every file descriptor with pending events, and waits for completions
+ * with a single io_uring_enter() that also submits all new requests and
+ * the IORING_OP_TIMEOUT for the loop's next deadline.  Interest changes
+ * are collected on a changelist as in the epoll backend, so an fd that is
+ * added and removed within one pass never reaches the kernel.
+ */
+struct eviouring {
+	struct event *evread;
+	struct event *evwrite;
+	unsigned int gen;	/* generation of the armed poll request */
+	short armed;		/* poll mask of the armed request, or 0 */
+	short changed;		/* EVIOURING_CHANGED, EVIOURING_CLEARED */
+};
+
+#define EVIOURING_CHANGED	0x01	/* fd is on the changelist */
+#define EVIOURING_CLEARED	0x02	/* all interest was dropped meanwhile */
+
+/* user_data of poll requests is the fd and the generation it was armed */
+#define IOURING_DATA(fd, gen)	(((uint64_t)(gen) << 32) | (uint32_t)(fd))
+/* user_data of timeouts and poll removals, whose results we ignore */
+#define IOURING_DATA_INTERNAL	((uint64_t)-1)
+
+struct iouringop {
+	fd_map_t fds;		/* struct eviouring by fd */
+	int *changes;
+	int nchanges;
+	int changes_alloc;
+
+	int ringfd;
+	void *sq_ring;
+	size_t sq_ring_sz;
+	void *cq_ring;
+	size_t cq_ring_sz;
+	struct io_uring_sqe *sqes;
+	size_t sqes_sz;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned sq_entries;
+	unsigned sq_local_tail;	/* filled in, but not yet published */
+	unsigned to_submit;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/* the kernel reads it when the timeout is submitted */
+	struct __kernel_timespec ts;
+};
+
+static void *iouring_init	(struct event_base *);
+static int iouring_add	(void *, struct event *);
+static int iouring_del	(void *, struct event *);
+static int iouring_dispatch	(struct event_base *, void *, struct timeval *);
+static void iouring_dealloc	(struct event_base *, void *);
+
+const struct eventop iouringops = {
+	"io_uring",
+	iouring_init,
+	iouring_add,
+	iouring_del,
+	iouring_dispatch,
+	iouring_dealloc,
+	1, /* need reinit */
+	0 /* no EV_ET, and no EV_EXCLUSIVE for one-shot polls */
+};
+
+#ifdef HAVE_SETFD
+#define FD_CLOSEONEXEC(x) do { \
+        if (fcntl(x, F_SETFD, 1) == -1) \
+                event_warn("fcntl(%d, F_SETFD)", x); \
+} while (0)
+#else
+#define FD_CLOSEONEXEC(x)
+#endif
+
+#define IOURING_ENTRIES 256
+#define INITIAL_NCHANGES 32
+
+static int
+iouring_enter(struct iouringop *iop, unsigned int min_complete)
+{
+	/*
+	 * Completions that did not fit into the completion queue are only
+	 * flushed into it when we ask for events, even if we do not wait.
+	 */
+	unsigned int flags = IORING_ENTER_GETEVENTS;
+	int res;
+
+	__atomic_store_n(iop->sq_tail, iop->sq_local_tail, __ATOMIC_RELEASE);
+
+	res = syscall(__NR_io_uring_enter, iop->ringfd, iop->to_submit,
+	    min_complete, flags, NULL, 0);
+	if (res >= 0)
+		iop->to_submit -= res;
+	return (res);
+}
+
+static struct io_uring_sqe *
+iouring_get_sqe(struct iouringop *iop)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int idx;
+
+	if (iop->sq_local_tail -
+	    __atomic_load_n(iop->sq_head, __ATOMIC_ACQUIRE) >=
+	    iop->sq_entries) {
+		/* the ring is full; hand what we have to the kernel */
+		if (iouring_enter(iop, 0) == -1 ||
+		    iop->sq_local_tail -
+		    __atomic_load_n(iop->sq_head, __ATOMIC_ACQUIRE) >=
+		    iop->sq_entries) {
+			event_warn("%s: submission queue is full", __func__);
+			return (NULL);
+		}
+	}
+
+	idx = iop->sq_local_tail & *iop->sq_mask;
+	sqe = &iop->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	iop->sq_array[idx] = idx;
+	iop->sq_local_tail++;
+	iop->to_submit++;
+	return (sqe);
+}
+
+static void *
+iouring_init(struct event_base *base)
+{
+	struct io_uring_params p;
+	struct iouringop *iop;
+	int ringfd;
+
+	/* Disable io_uring when this environment variable is set */
+	if (evutil_getenv("EVENT_NOIOURING"))
+		return (NULL);
+
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_NODROP)
+	memset(&p, 0, sizeof(p));
+	if ((ringfd = syscall(__NR_io_uring_setup, IOURING_ENTRIES, &p)) == -1) {
+		if (errno != ENOSYS && errno != EPERM)
+			event_warn("io_uring_setup");
+		return (NULL);
+	}
+
+	/* without NODROP a busy ring could lose completions */
+	if (!(p.features & IORING_FEAT_NODROP)) {
+		close(ringfd);
+		return (NULL);
+	}
+
+	FD_CLOSEONEXEC(ringfd);
+
+	if (!(iop = mm_calloc(1, sizeof(struct iouringop)))) {
+		close(ringfd);
+		return (NULL);
+	}
+	iop->ringfd = ringfd;
+	iop->sq_ring = iop->cq_ring = iop->sqes = MAP_FAILED;
+
+	iop->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	iop->cq_ring_sz = p.cq_off.cqes +
+	    p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (iop->cq_ring_sz > iop->sq_ring_sz)
+			iop->sq_ring_sz = iop->cq_ring_sz;
+		iop->cq_ring_sz = 0;
+	}
+	iop->sq_ring = mmap(NULL, iop->sq_ring_sz, PROT_READ|PROT_WRITE,
+	    MAP_SHARED|MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+	if (iop->sq_ring == MAP_FAILED)
+		goto error;
+	if (iop->cq_ring_sz == 0) {
+		iop->cq_ring = iop->sq_ring;
+	} else {
+		iop->cq_ring = mmap(NULL, iop->cq_ring_sz,
+		    PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+		    ringfd, IORING_OFF_CQ_RING);
+		if (iop->cq_ring == MAP_FAILED)
+			goto error;
+	}
+	iop->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	iop->sqes = mmap(NULL, iop->sqes_sz, PROT_READ|PROT_WRITE,
+	    MAP_SHARED|MAP_POPULATE, ringfd, IORING_OFF_SQES);
+	if (iop->sqes == MAP_FAILED)
+		goto error;
+
+	iop->sq_head = (unsigned *)((char *)iop->sq_ring + p.sq_off.head);
+	iop->sq_tail = (unsigned *)((char *)iop->sq_ring + p.sq_off.tail);
+	iop->sq_mask = (unsigned *)((char *)iop->sq_ring + p.sq_off.ring_mask);
+	iop->sq_array = (unsigned *)((char *)iop->sq_ring + p.sq_off.array);
+	iop->sq_entries = p.sq_entries;
+	iop->sq_local_tail = *iop->sq_tail;
+
+	iop->cq_head = (unsigned *)((char *)iop->cq_ring + p.cq_off.head);
+	iop->cq_tail = (unsigned *)((char *)iop->cq_ring + p.cq_off.tail);
+	iop->cq_mask = (unsigned *)((char *)iop->cq_ring + p.cq_off.ring_mask);
+	iop->cqes = (struct io_uring_cqe *)
+	    ((char *)iop->cq_ring + p.cq_off.cqes);
+
+	fd_map_ctor(&iop->fds, sizeof(struct eviouring));
+
+	evsignal_init(base);
+
+	return (iop);
+
+ error:
+	event_warn("%s: mmap", __func__);
+	iouring_dealloc(NULL, iop);
+	return (NULL);
+#else
+	return (NULL);
+#endif
+}
+
+/* Lets the fd map free the entry of fd once it holds no state */
+static void
+iouring_release_fd(struct iouringop *iop, int fd)
+{
+	struct eviouring *evio = fd_map_find(&iop->fds, fd);
+
+	if (evio != NULL)
+		fd_map_mark(&iop->fds, fd, evio->evread != NULL ||
+		    evio->evwrite != NULL || evio->armed != 0 ||
+		    evio->changed != 0);
+}
+
+static int
+iouring_queue_change(struct iouringop *iop, int fd)
+{
+	struct eviouring *evio = fd_map_find(&iop->fds, fd);
+
+	if (evio->changed & EVIOURING_CHANGED)
+		return (0);
+
+	if (iop->nchanges == iop->changes_alloc) {
+		int n = iop->changes_alloc ? iop->changes_alloc * 2 :
+		    INITIAL_NCHANGES;
+		int *changes = mm_realloc(iop->changes, n * sizeof(int));
+		if (changes == NULL) {
+			event_warn("realloc");
+			return (-1);
+		}
+		iop->changes = changes;
+		iop->changes_alloc = n;
+	}
+
+	iop->changes[iop->nchanges++] = fd;
+	evio->changed |= EVIOURING_CHANGED;
+	return (0);
+}
+
+/* Queues poll requests so that the armed mask of fd matches its events */
+static void
+iouring_sync_fd(struct iouringop *iop, int fd)
+{
+	struct eviouring *evio = fd_map_find(&iop->fds, fd);
+	struct io_uring_sqe *sqe;
+	int want, cleared;
+
+	cleared = evio->changed & EVIOURING_CLEARED;
+	evio->changed = 0;
+
+	want = 0;
+	if (evio->evread != NULL)
+		want |= POLLIN;
+	if (evio->evwrite != NULL)
+		want |= POLLOUT;
+
+	/*
+	 * A poll request holds on to the file it was armed for, so an fd
+	 * that was closed and reopened needs a new one.
+	 */
+	if (want == evio->armed && (want == 0 || !cleared))
+		return;
+
+	if (evio->armed) {
+		if ((sqe = iouring_get_sqe(iop)) == NULL)
+			return;
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = IOURING_DATA(fd, evio->gen);
+		sqe->user_data = IOURING_DATA_INTERNAL;
+		evio->armed = 0;
+	}
+
+	if (want) {
+		if ((sqe = iouring_get_sqe(iop)) == NULL)
+			return;
+		evio->gen++;
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = fd;
+		sqe->poll_events = want;
+		sqe->user_data = IOURING_DATA(fd, evio->gen);
+		evio->armed = want;
+	}
+}
+
+static void
+iouring_reap(struct iouringop *iop)
+{
+	unsigned int head, tail;
+
+	head = *iop->cq_head;
+	tail = __atomic_load_n(iop->cq_tail, __ATOMIC_ACQUIRE);
+
+	event_debug(("%s: %u completions", __func__, tail - head));
+
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &iop->cqes[head & *iop->cq_mask];
+		struct event *evread = NULL, *evwrite = NULL;
+		struct eviouring *evio;
+		uint64_t data = cqe->user_data;
+		int fd = (int)(uint32_t)data;
+		int what = cqe->res;
+
+		if (data == IOURING_DATA_INTERNAL ||
+		    (evio = fd_map_find(&iop->fds, fd)) == NULL)
+			continue;
+		/* completion of a request that was removed or replaced */
+		if (!evio->armed || evio->gen != (unsigned int)(data >> 32))
+			continue;
+
+		/* the request is done; rearm it next time if still wanted */
+		evio->armed = 0;
+		if (iouring_queue_change(iop, fd) == -1) {
+			iouring_sync_fd(iop, fd);
+			iouring_release_fd(iop, fd);
+			evio = fd_map_find(&iop->fds, fd);
+			if (evio == NULL)
+				continue;
+		}
+
+		if (what < 0 || (what & (POLLHUP|POLLERR|POLLNVAL))) {
+			evread = evio->evread;
+			evwrite = evio->evwrite;
+		} else {
+			if (what & POLLIN)
+				evread = evio->evread;
+			if (what & POLLOUT)
+				evwrite = evio->evwrite;
+		}
+
+		if (evread != NULL)
+			event_active(evread, EV_READ, 1);
+		if (evwrite != NULL)
+			event_active(evwrite, EV_WRITE, 1);
+	}
+
+	__atomic_store_n(iop->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static int
+iouring_dispatch(struct event_base *base, void *arg, struct timeval *tv)
+{
+	struct iouringop *iop = arg;
+	struct io_uring_sqe *sqe;
+	unsigned int min_complete = 1;
+	int i, res;
+
+	for (i = 0; i < iop->nchanges; i++) {
+		iouring_sync_fd(iop, iop->changes[i]);
+		iouring_release_fd(iop, iop->changes[i]);
+	}
+	iop->nchanges = 0;
+
+	if (tv != NULL && !evutil_timerisset(tv)) {
+		min_complete = 0;
+	} else if (tv != NULL && (sqe = iouring_get_sqe(iop)) != NULL) {
+		/* completes at the deadline or with the first other event */
+		iop->ts.tv_sec = tv->tv_sec;
+		iop->ts.tv_nsec = tv->tv_usec * 1000;
+		sqe->opcode = IORING_OP_TIMEOUT;
+		sqe->fd = -1;
+		sqe->addr = (uintptr_t)&iop->ts;
+		sqe->len = 1;
+		sqe->off = 1;
+		sqe->user_data = IOURING_DATA_INTERNAL;
+	}
+
+	res = iouring_enter(iop, min_complete);
+
+	if (res == -1) {
+		if (errno == EINTR) {
+			evsignal_process(base);
+			return (0);
+		}
+		/* the completion queue is backed up; drain it first */
+		if (errno != EBUSY && errno != EAGAIN) {
+			event_warn("io_uring_enter");
+			return (-1);
+		}
+	} else if (base->sig.evsignal_caught) {
+		evsignal_process(base);
+	}
+
+	iouring_reap(iop);
+
+	return (0);
+}
+
+static int
+iouring_add(void *arg, struct event *ev)
+{
+	struct iouringop *iop = arg;
+	struct eviouring *evio;
+	int fd;
+
+	if (ev->ev_events & EV_SIGNAL)
+		return (evsignal_add(ev));
+
+	fd = ev->ev_fd;
+	if ((evio = fd_map_get(&iop->fds, fd)) == NULL) {
+		event_warn("%s: malloc", __func__);
+		return (-1);
+	}
+	if (iouring_queue_change(iop, fd) == -1) {
+		/* do not keep a page for nothing */
+		iouring_release_fd(iop, fd);
+		return (-1);
+	}
+
+	/* Update events responsible */
+	if (ev->ev_events & EV_READ)
+		evio->evread = ev;
+	if (ev->ev_events & EV_WRITE)
+		evio->evwrite = ev;
+	fd_map_mark(&iop->fds, fd, 1);
+
+	return (0);
+}
+
+static int
+iouring_del(void *arg, struct event *ev)
+{
+	struct iouringop *iop = arg;
+	struct eviouring *evio;
+	int fd;
+
+	if (ev->ev_events & EV_SIGNAL)
+		return (evsignal_del(ev));
+
+	fd = ev->ev_fd;
+	if ((evio = fd_map_find(&iop->fds, fd)) == NULL)
+		return (0);
+
+	if (ev->ev_events & EV_READ)
+		evio->evread = NULL;
+	if (ev->ev_events & EV_WRITE)
+		evio->evwrite = NULL;
+	if (evio->evread == NULL && evio->evwrite == NULL)
+		evio->changed |= EVIOURING_CLEARED;
+
+	/* without room on the changelist, update the kernel right away */
+	if (iouring_queue_change(iop, fd) == -1) {
+		iouring_sync_fd(iop, fd);
+		iouring_release_fd(iop, fd);
+	}
+
+	return (0);
+}
+
+static void
+iouring_dealloc(struct event_base *base, void *arg)
+{
+	struct iouringop *iop = arg;
+
+	if (base != NULL)
+		evsignal_dealloc(base);
+	fd_map_dtor(&iop->fds);
+	if (iop->changes)
+		mm_free(iop->changes);
+	if (iop->sqes != MAP_FAILED)
+		munmap(iop->sqes, iop->sqes_sz);
+	if (iop->cq_ring != MAP_FAILED && iop->cq_ring != iop->sq_ring)
+		munmap(iop->cq_ring, iop->cq_ring_sz);
+	if (iop->sq_ring != MAP_FAILED)
+		munmap(iop->sq_ring, iop->sq_ring_sz);
+	if (iop->ringfd >= 0)
+		close(iop->ringfd);
+
+	memset(iop, 0, sizeof(struct iouringop));
+	mm_free(iop);
+}
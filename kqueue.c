@@ -63,6 +63,7 @@
 #include "event.h"
 #include "event-internal.h"
 #include "log.h"
+#include "mm-internal.h"
 
 #define EVLIST_X_KQINKERNEL	0x1000
 
@@ -92,7 +93,8 @@ const struct eventop kqops = {
 	kq_del,
 	kq_dispatch,
 	kq_dealloc,
-	1 /* need reinit */
+	1, /* need reinit */
+	0 /* features */
 };
 
 static void *
@@ -105,14 +107,14 @@ kq_init(struct event_base *base)
 	if (evutil_getenv("EVENT_NOKQUEUE"))
 		return (NULL);
 
-	if (!(kqueueop = calloc(1, sizeof(struct kqop))))
+	if (!(kqueueop = mm_calloc(1, sizeof(struct kqop))))
 		return (NULL);
 
 	/* Initalize the kernel queue */
 	
 	if ((kq = kqueue()) == -1) {
 		event_warn("kqueue");
-		free (kqueueop);
+		mm_free (kqueueop);
 		return (NULL);
 	}
 
@@ -121,15 +123,15 @@ kq_init(struct event_base *base)
 	kqueueop->pid = getpid();
 
 	/* Initalize fields */
-	kqueueop->changes = malloc(NEVENT * sizeof(struct kevent));
+	kqueueop->changes = mm_malloc(NEVENT * sizeof(struct kevent));
 	if (kqueueop->changes == NULL) {
-		free (kqueueop);
+		mm_free (kqueueop);
 		return (NULL);
 	}
-	kqueueop->events = malloc(NEVENT * sizeof(struct kevent));
+	kqueueop->events = mm_malloc(NEVENT * sizeof(struct kevent));
 	if (kqueueop->events == NULL) {
-		free (kqueueop->changes);
-		free (kqueueop);
+		mm_free (kqueueop->changes);
+		mm_free (kqueueop);
 		return (NULL);
 	}
 	kqueueop->nevents = NEVENT;
@@ -153,9 +155,9 @@ kq_init(struct event_base *base)
 	    kqueueop->events[0].ident != -1 ||
 	    kqueueop->events[0].flags != EV_ERROR) {
 		event_warn("%s: detected broken kqueue; not using.", __func__);
-		free(kqueueop->changes);
-		free(kqueueop->events);
-		free(kqueueop);
+		mm_free(kqueueop->changes);
+		mm_free(kqueueop->events);
+		mm_free(kqueueop);
 		close(kq);
 		return (NULL);
 	}
@@ -174,7 +176,7 @@ kq_insert(struct kqop *kqop, struct kevent *kev)
 
 		nevents *= 2;
 
-		newchange = realloc(kqop->changes,
+		newchange = mm_realloc(kqop->changes,
 				    nevents * sizeof(struct kevent));
 		if (newchange == NULL) {
 			event_warn("%s: malloc", __func__);
@@ -182,7 +184,7 @@ kq_insert(struct kqop *kqop, struct kevent *kev)
 		}
 		kqop->changes = newchange;
 
-		newresult = realloc(kqop->events,
+		newresult = mm_realloc(kqop->events,
 				    nevents * sizeof(struct kevent));
 
 		/*
@@ -440,11 +442,11 @@ kq_dealloc(struct event_base *base, void *arg)
 	struct kqop *kqop = arg;
 
 	if (kqop->changes)
-		free(kqop->changes);
+		mm_free(kqop->changes);
 	if (kqop->events)
-		free(kqop->events);
+		mm_free(kqop->events);
 	if (kqop->kq >= 0 && kqop->pid == getpid())
 		close(kqop->kq);
 	memset(kqop, 0, sizeof(struct kqop));
-	free(kqop);
+	mm_free(kqop);
 }
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2026 The libevent contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Listeners: accept connections on a listening socket in batches and hand
+ * them to a callback, already non-blocking and close-on-exec.
+ */
+
+#ifdef __linux__
+/* for accept4() */
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#undef WIN32_LEAN_AND_MEAN
+#endif
+#include <sys/types.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else
+#include <sys/_libevent_time.h>
+#endif
+#include <sys/queue.h>
+#ifndef WIN32
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "event.h"
+#include "evutil.h"
+#include "log.h"
+#include "mm-internal.h"
+
+/* connections taken per callback unless evlistener_set_max_accepts() */
+#define EVLISTENER_MAX_ACCEPTS	16
+/* seconds a listener without a spare descriptor stops accepting */
+#define EVLISTENER_PAUSE	1
+
+struct evlistener {
+	struct event ev;
+	/* re-enables ev after a pause for lack of descriptors */
+	struct event pause_ev;
+	evlistener_cb cb;
+	void *arg;
+	int flags;
+	int max_accepts;
+	/* spare descriptor given up to shed a connection on EMFILE */
+	int reserve_fd;
+	/* set from the first EMFILE until an accept succeeds again */
+	int out_of_fds;
+};
+
+static int
+evlistener_open_reserve(void)
+{
+#ifdef WIN32
+	return (-1);
+#elif defined(O_CLOEXEC)
+	return (open("/dev/null", O_RDONLY | O_CLOEXEC));
+#else
+	int fd = open("/dev/null", O_RDONLY);
+
+#ifdef FD_CLOEXEC
+	if (fd != -1 && fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+		event_warn("%s: fcntl(FD_CLOEXEC)", __func__);
+#endif
+	return (fd);
+#endif
+}
+
+/*
+ * Returns the connected socket, non-blocking and close-on-exec, or -1 with
+ * the socket error set.
+ */
+static int
+evlistener_accept(int fd, struct sockaddr *sa, socklen_t *socklen)
+{
+	int nfd;
+
+#if defined(HAVE_ACCEPT4) && defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+	nfd = accept4(fd, sa, socklen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (nfd != -1 || errno != ENOSYS)
+		return (nfd);
+#endif
+	if ((nfd = accept(fd, sa, socklen)) == -1)
+		return (-1);
+	if (evutil_make_socket_nonblocking(nfd) == -1) {
+		EVUTIL_CLOSESOCKET(nfd);
+		return (-1);
+	}
+#ifdef FD_CLOEXEC
+	if (fcntl(nfd, F_SETFD, FD_CLOEXEC) == -1)
+		event_warn("%s: fcntl(FD_CLOEXEC)", __func__);
+#endif
+	return (nfd);
+}
+
+static void
+evlistener_pause_cb(int fd, short what, void *arg)
+{
+	struct evlistener *lev = arg;
+
+	if (lev->reserve_fd == -1)
+		lev->reserve_fd = evlistener_open_reserve();
+	event_add(&lev->ev, NULL);
+}
+
+/*
+ * Out of descriptors: the pending connection would keep the listener
+ * readable forever, so close the reserve to make room, accept and drop
+ * the connection, and take the reserve back.  Without a reserve the
+ * listener stops for a while instead.  Only the first failure of a run
+ * is logged.
+ */
+static void
+evlistener_shed(struct evlistener *lev, int fd)
+{
+	struct timeval tv;
+	int nfd;
+
+	if (!lev->out_of_fds) {
+		event_warnx("%s: out of file descriptors, %s", __func__,
+		    lev->reserve_fd != -1 ?
+		    "dropping connections" : "pausing the listener");
+		lev->out_of_fds = 1;
+	}
+
+	if (lev->reserve_fd == -1) {
+		event_del(&lev->ev);
+		tv.tv_sec = EVLISTENER_PAUSE;
+		tv.tv_usec = 0;
+		evtimer_add(&lev->pause_ev, &tv);
+		return;
+	}
+
+	close(lev->reserve_fd);
+	if ((nfd = accept(fd, NULL, NULL)) != -1)
+		EVUTIL_CLOSESOCKET(nfd);
+	lev->reserve_fd = evlistener_open_reserve();
+}
+
+static void
+evlistener_read_cb(int fd, short what, void *arg)
+{
+	struct evlistener *lev = arg;
+	struct sockaddr_storage ss;
+	socklen_t socklen;
+	int nfd, n;
+
+	for (n = 0; n < lev->max_accepts; n++) {
+		socklen = sizeof(ss);
+		nfd = evlistener_accept(fd, (struct sockaddr *)&ss, &socklen);
+		if (nfd == -1) {
+			int err = EVUTIL_SOCKET_ERROR();
+#ifdef WIN32
+			if (err == WSAEWOULDBLOCK || err == WSAEINTR ||
+			    err == WSAECONNRESET)
+				return;
+#else
+			if (err == EAGAIN || err == EWOULDBLOCK || err == EINTR)
+				return;
+			/* the peer went away before we got to it */
+			if (err == ECONNABORTED || err == EPROTO)
+				continue;
+			if (err == EMFILE || err == ENFILE) {
+				evlistener_shed(lev, fd);
+				return;
+			}
+#endif
+			event_warn("%s: accept", __func__);
+			return;
+		}
+
+		lev->out_of_fds = 0;
+		(*lev->cb)(lev, nfd, (struct sockaddr *)&ss, socklen,
+		    lev->arg);
+	}
+}
+
+struct evlistener *
+evlistener_new(struct event_base *base, evlistener_cb cb, void *arg,
+    int flags, int fd)
+{
+	struct evlistener *lev;
+	short events = EV_READ | EV_PERSIST;
+
+	if ((lev = mm_calloc(1, sizeof(struct evlistener))) == NULL) {
+		event_warn("%s: calloc", __func__);
+		return (NULL);
+	}
+	lev->cb = cb;
+	lev->arg = arg;
+	lev->flags = flags;
+	lev->max_accepts = EVLISTENER_MAX_ACCEPTS;
+	lev->reserve_fd = evlistener_open_reserve();
+
+	if (flags & EVLISTENER_EXCLUSIVE)
+		events |= EV_EXCLUSIVE;
+
+	evutil_make_socket_nonblocking(fd);
+	event_set(&lev->ev, fd, events, evlistener_read_cb, lev);
+	evtimer_set(&lev->pause_ev, evlistener_pause_cb, lev);
+	if (base != NULL) {
+		event_base_set(base, &lev->ev);
+		event_base_set(base, &lev->pause_ev);
+	}
+	if (event_add(&lev->ev, NULL) == -1) {
+		if (lev->reserve_fd != -1)
+			close(lev->reserve_fd);
+		mm_free(lev);
+		return (NULL);
+	}
+
+	return (lev);
+}
+
+void
+evlistener_free(struct evlistener *lev)
+{
+	event_del(&lev->ev);
+	event_del(&lev->pause_ev);
+	if (lev->flags & EVLISTENER_CLOSE_ON_FREE)
+		EVUTIL_CLOSESOCKET(lev->ev.ev_fd);
+	if (lev->reserve_fd != -1)
+		close(lev->reserve_fd);
+	mm_free(lev);
+}
+
+int
+evlistener_set_max_accepts(struct evlistener *lev, int max_accepts)
+{
+	if (max_accepts <= 0)
+		return (-1);
+	lev->max_accepts = max_accepts;
+	return (0);
+}
+
+int
+evlistener_get_fd(struct evlistener *lev)
+{
+	return (lev->ev.ev_fd);
+}
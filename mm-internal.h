@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2026 The libevent contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _MM_INTERNAL_H_
+#define _MM_INTERNAL_H_
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * All allocations of the library go through these, so that they reach
+ * the functions passed to event_set_mem_functions() and are counted for
+ * the module of the file that defines EVENT_MM_MODULE before including
+ * this header.
+ */
+#ifndef EVENT_MM_MODULE
+#define EVENT_MM_MODULE EVENT_MEM_CORE
+#endif
+
+/*
+ * memory handed to the application, which releases it with the
+ * counterpart of the free_fn given to event_set_mem_functions()
+ */
+#define EVENT_MM_EXPORT (-1)
+
+void *event_mm_malloc_(int module, size_t sz);
+void *event_mm_calloc_(int module, size_t count, size_t size);
+char *event_mm_strdup_(int module, const char *s);
+void *event_mm_realloc_(int module, void *p, size_t sz);
+void event_mm_free_(void *p);
+void event_mm_free_export_(void *p);
+
+#define mm_malloc(sz)		event_mm_malloc_(EVENT_MM_MODULE, (sz))
+#define mm_calloc(n, sz)	event_mm_calloc_(EVENT_MM_MODULE, (n), (sz))
+#define mm_strdup(s)		event_mm_strdup_(EVENT_MM_MODULE, (s))
+#define mm_realloc(p, sz)	event_mm_realloc_(EVENT_MM_MODULE, (p), (sz))
+#define mm_free(p)		event_mm_free_(p)
+
+/*
+ * Exported memory is never accounted for, since it does not come back
+ * through mm_free().
+ */
+#define mm_malloc_export(sz)	event_mm_malloc_(EVENT_MM_EXPORT, (sz))
+#define mm_calloc_export(n, sz)	event_mm_calloc_(EVENT_MM_EXPORT, (n), (sz))
+#define mm_strdup_export(s)	event_mm_strdup_(EVENT_MM_EXPORT, (s))
+#define mm_free_export(p)	event_mm_free_export_(p)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MM_INTERNAL_H_ */
@@ -51,18 +51,19 @@
 #include "event.h"
 #include "event-internal.h"
 #include "evsignal.h"
+#include "fd_map.h"
 #include "log.h"
+#include "mm-internal.h"
 
 struct pollop {
 	int event_count;		/* Highest number alloc */
 	int nfds;                       /* Size of event_* */
-	int fd_count;                   /* Size of idxplus1_by_fd */
 	struct pollfd *event_set;
 	struct event **event_r_back;
 	struct event **event_w_back;
-	int *idxplus1_by_fd; /* Index into event_set by fd; we add 1 so
-			      * that 0 (which is easy to memset) can mean
-			      * "no entry." */
+	fd_map_t idxplus1_by_fd; /* Index into event_set by fd; we add 1 so
+				  * that 0 (which is how entries start) can
+				  * mean "no entry." */
 };
 
 static void *poll_init	(struct event_base *);
@@ -78,7 +79,8 @@ const struct eventop pollops = {
 	poll_del,
 	poll_dispatch,
 	poll_dealloc,
-    0
+	0, /* need reinit */
+	0 /* features */
 };
 
 static void *
@@ -90,8 +92,9 @@ poll_init(struct event_base *base)
 	if (evutil_getenv("EVENT_NOPOLL"))
 		return (NULL);
 
-	if (!(pollop = calloc(1, sizeof(struct pollop))))
+	if (!(pollop = mm_calloc(1, sizeof(struct pollop))))
 		return (NULL);
+	fd_map_ctor(&pollop->idxplus1_by_fd, sizeof(int));
 
 	evsignal_init(base);
 
@@ -102,12 +105,12 @@ poll_init(struct event_base *base)
 static void
 poll_check_ok(struct pollop *pop)
 {
-	int i, idx;
+	int i, idx, *idxp;
 	struct event *ev;
 
-	for (i = 0; i < pop->fd_count; ++i) {
-		idx = pop->idxplus1_by_fd[i]-1;
-		if (idx < 0)
+	for (i = 0; i < pop->idxplus1_by_fd.npages * FDMAP_PAGE_SIZE; ++i) {
+		idxp = fd_map_find(&pop->idxplus1_by_fd, i);
+		if (idxp == NULL || (idx = *idxp - 1) < 0)
 			continue;
 		assert(pop->event_set[idx].fd == i);
 		if (pop->event_set[idx].events & POLLIN) {
@@ -125,7 +128,8 @@ poll_check_ok(struct pollop *pop)
 	}
 	for (i = 0; i < pop->nfds; ++i) {
 		struct pollfd *pfd = &pop->event_set[i];
-		assert(pop->idxplus1_by_fd[pfd->fd] == i+1);
+		idxp = fd_map_find(&pop->idxplus1_by_fd, pfd->fd);
+		assert(idxp != NULL && *idxp == i+1);
 	}
 }
 #else
@@ -206,7 +210,7 @@ poll_add(void *arg, struct event *ev)
 {
 	struct pollop *pop = arg;
 	struct pollfd *pfd = NULL;
-	int i;
+	int i, *idxp;
 
 	if (ev->ev_events & EV_SIGNAL)
 		return (evsignal_add(ev));
@@ -226,7 +230,7 @@ poll_add(void *arg, struct event *ev)
 			tmp_event_count = pop->event_count * 2;
 
 		/* We need more file descriptors */
-		tmp_event_set = realloc(pop->event_set,
+		tmp_event_set = mm_realloc(pop->event_set,
 				 tmp_event_count * sizeof(struct pollfd));
 		if (tmp_event_set == NULL) {
 			event_warn("realloc");
@@ -234,7 +238,7 @@ poll_add(void *arg, struct event *ev)
 		}
 		pop->event_set = tmp_event_set;
 
-		tmp_event_r_back = realloc(pop->event_r_back,
+		tmp_event_r_back = mm_realloc(pop->event_r_back,
 			    tmp_event_count * sizeof(struct event *));
 		if (tmp_event_r_back == NULL) {
 			/* event_set overallocated; that's okay. */
@@ -243,7 +247,7 @@ poll_add(void *arg, struct event *ev)
 		}
 		pop->event_r_back = tmp_event_r_back;
 
-		tmp_event_w_back = realloc(pop->event_w_back,
+		tmp_event_w_back = mm_realloc(pop->event_w_back,
 			    tmp_event_count * sizeof(struct event *));
 		if (tmp_event_w_back == NULL) {
 			/* event_set and event_r_back overallocated; that's
@@ -255,28 +259,12 @@ poll_add(void *arg, struct event *ev)
 
 		pop->event_count = tmp_event_count;
 	}
-	if (ev->ev_fd >= pop->fd_count) {
-		int *tmp_idxplus1_by_fd;
-		int new_count;
-		if (pop->fd_count < 32)
-			new_count = 32;
-		else
-			new_count = pop->fd_count * 2;
-		while (new_count <= ev->ev_fd)
-			new_count *= 2;
-		tmp_idxplus1_by_fd =
-			realloc(pop->idxplus1_by_fd, new_count * sizeof(int));
-		if (tmp_idxplus1_by_fd == NULL) {
-			event_warn("realloc");
-			return (-1);
-		}
-		pop->idxplus1_by_fd = tmp_idxplus1_by_fd;
-		memset(pop->idxplus1_by_fd + pop->fd_count,
-		       0, sizeof(int)*(new_count - pop->fd_count));
-		pop->fd_count = new_count;
+	if ((idxp = fd_map_get(&pop->idxplus1_by_fd, ev->ev_fd)) == NULL) {
+		event_warn("malloc");
+		return (-1);
 	}
 
-	i = pop->idxplus1_by_fd[ev->ev_fd] - 1;
+	i = *idxp - 1;
 	if (i >= 0) {
 		pfd = &pop->event_set[i];
 	} else {
@@ -285,7 +273,8 @@ poll_add(void *arg, struct event *ev)
 		pfd->events = 0;
 		pfd->fd = ev->ev_fd;
 		pop->event_w_back[i] = pop->event_r_back[i] = NULL;
-		pop->idxplus1_by_fd[ev->ev_fd] = i + 1;
+		*idxp = i + 1;
+		fd_map_mark(&pop->idxplus1_by_fd, ev->ev_fd, 1);
 	}
 
 	pfd->revents = 0;
@@ -311,7 +300,7 @@ poll_del(void *arg, struct event *ev)
 {
 	struct pollop *pop = arg;
 	struct pollfd *pfd = NULL;
-	int i;
+	int i, *idxp;
 
 	if (ev->ev_events & EV_SIGNAL)
 		return (evsignal_del(ev));
@@ -320,8 +309,8 @@ poll_del(void *arg, struct event *ev)
 		return (0);
 
 	poll_check_ok(pop);
-	i = pop->idxplus1_by_fd[ev->ev_fd] - 1;
-	if (i < 0)
+	idxp = fd_map_find(&pop->idxplus1_by_fd, ev->ev_fd);
+	if (idxp == NULL || (i = *idxp - 1) < 0)
 		return (-1);
 
 	/* Do we still want to read or write? */
@@ -340,7 +329,8 @@ poll_del(void *arg, struct event *ev)
 		return (0);
 
 	/* Okay, so we aren't interested in that fd anymore. */
-	pop->idxplus1_by_fd[ev->ev_fd] = 0;
+	*idxp = 0;
+	fd_map_mark(&pop->idxplus1_by_fd, ev->ev_fd, 0);
 
 	--pop->nfds;
 	if (i != pop->nfds) {
@@ -352,7 +342,8 @@ poll_del(void *arg, struct event *ev)
 		       sizeof(struct pollfd));
 		pop->event_r_back[i] = pop->event_r_back[pop->nfds];
 		pop->event_w_back[i] = pop->event_w_back[pop->nfds];
-		pop->idxplus1_by_fd[pop->event_set[i].fd] = i + 1;
+		idxp = fd_map_find(&pop->idxplus1_by_fd, pop->event_set[i].fd);
+		*idxp = i + 1;
 	}
 
 	poll_check_ok(pop);
@@ -366,14 +357,13 @@ poll_dealloc(struct event_base *base, void *arg)
 
 	evsignal_dealloc(base);
 	if (pop->event_set)
-		free(pop->event_set);
+		mm_free(pop->event_set);
 	if (pop->event_r_back)
-		free(pop->event_r_back);
+		mm_free(pop->event_r_back);
 	if (pop->event_w_back)
-		free(pop->event_w_back);
-	if (pop->idxplus1_by_fd)
-		free(pop->idxplus1_by_fd);
+		mm_free(pop->event_w_back);
+	fd_map_dtor(&pop->idxplus1_by_fd);
 
 	memset(pop, 0, sizeof(struct pollop));
-	free(pop);
+	mm_free(pop);
 }
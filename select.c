@@ -55,6 +55,7 @@
 #include "event-internal.h"
 #include "evsignal.h"
 #include "log.h"
+#include "mm-internal.h"
 
 #ifndef howmany
 #define        howmany(x, y)   (((x)+((y)-1))/(y))
@@ -91,7 +92,8 @@ const struct eventop selectops = {
 	select_del,
 	select_dispatch,
 	select_dealloc,
-	0
+	0, /* need reinit */
+	0 /* features */
 };
 
 static int select_resize(struct selectop *sop, int fdsz);
@@ -105,7 +107,7 @@ select_init(struct event_base *base)
 	if (evutil_getenv("EVENT_NOSELECT"))
 		return (NULL);
 
-	if (!(sop = calloc(1, sizeof(struct selectop))))
+	if (!(sop = mm_calloc(1, sizeof(struct selectop))))
 		return (NULL);
 
 	select_resize(sop, howmany(32 + 1, NFDBITS)*sizeof(fd_mask));
@@ -221,23 +223,23 @@ select_resize(struct selectop *sop, int fdsz)
 	if (sop->event_readset_in)
 		check_selectop(sop);
 
-	if ((readset_in = realloc(sop->event_readset_in, fdsz)) == NULL)
+	if ((readset_in = mm_realloc(sop->event_readset_in, fdsz)) == NULL)
 		goto error;
 	sop->event_readset_in = readset_in;
-	if ((readset_out = realloc(sop->event_readset_out, fdsz)) == NULL)
+	if ((readset_out = mm_realloc(sop->event_readset_out, fdsz)) == NULL)
 		goto error;
 	sop->event_readset_out = readset_out;
-	if ((writeset_in = realloc(sop->event_writeset_in, fdsz)) == NULL)
+	if ((writeset_in = mm_realloc(sop->event_writeset_in, fdsz)) == NULL)
 		goto error;
 	sop->event_writeset_in = writeset_in;
-	if ((writeset_out = realloc(sop->event_writeset_out, fdsz)) == NULL)
+	if ((writeset_out = mm_realloc(sop->event_writeset_out, fdsz)) == NULL)
 		goto error;
 	sop->event_writeset_out = writeset_out;
-	if ((r_by_fd = realloc(sop->event_r_by_fd,
+	if ((r_by_fd = mm_realloc(sop->event_r_by_fd,
 		 n_events*sizeof(struct event*))) == NULL)
 		goto error;
 	sop->event_r_by_fd = r_by_fd;
-	if ((w_by_fd = realloc(sop->event_w_by_fd,
+	if ((w_by_fd = mm_realloc(sop->event_w_by_fd,
 		 n_events * sizeof(struct event*))) == NULL)
 		goto error;
 	sop->event_w_by_fd = w_by_fd;
@@ -347,18 +349,18 @@ select_dealloc(struct event_base *base, void *arg)
 
 	evsignal_dealloc(base);
 	if (sop->event_readset_in)
-		free(sop->event_readset_in);
+		mm_free(sop->event_readset_in);
 	if (sop->event_writeset_in)
-		free(sop->event_writeset_in);
+		mm_free(sop->event_writeset_in);
 	if (sop->event_readset_out)
-		free(sop->event_readset_out);
+		mm_free(sop->event_readset_out);
 	if (sop->event_writeset_out)
-		free(sop->event_writeset_out);
+		mm_free(sop->event_writeset_out);
 	if (sop->event_r_by_fd)
-		free(sop->event_r_by_fd);
+		mm_free(sop->event_r_by_fd);
 	if (sop->event_w_by_fd)
-		free(sop->event_w_by_fd);
+		mm_free(sop->event_w_by_fd);
 
 	memset(sop, 0, sizeof(struct selectop));
-	free(sop);
+	mm_free(sop);
 }
@@ -56,16 +56,27 @@
 #include <fcntl.h>
 #endif
 #include <assert.h>
+#ifdef HAVE_SYS_SIGNALFD_H
+#include <sys/signalfd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "event.h"
 #include "event-internal.h"
 #include "evsignal.h"
 #include "evutil.h"
 #include "log.h"
+#include "mm-internal.h"
 
 struct event_base *evsignal_base = NULL;
 
 static void evsignal_handler(int sig);
+#ifdef HAVE_SYS_SIGNALFD_H
+static int evsignal_fd_init(struct event_base *);
+static void evsignal_fd_del(struct event_base *, int);
+#endif
 
 /* Callback for when the signal handler write a byte to our signaling socket */
 static void
@@ -97,6 +108,20 @@ evsignal_init(struct event_base *base)
 {
 	int i;
 
+	base->sig.sh_old = NULL;
+	base->sig.sh_old_max = 0;
+	base->sig.evsignal_caught = 0;
+	memset(&base->sig.evsigcaught, 0, sizeof(sig_atomic_t)*NSIG);
+	/* initialize the queues for all events */
+	for (i = 0; i < NSIG; ++i)
+		TAILQ_INIT(&base->sig.evsigevents[i]);
+
+	base->sig.sigfd = -1;
+#ifdef HAVE_SYS_SIGNALFD_H
+	if ((base->flags & EVBASE_SIGNALFD) && evsignal_fd_init(base) == 0)
+		return (0);
+#endif
+
 	/* 
 	 * Our signal handler is going to write to one end of the socket
 	 * pair to wake up our event loop.  The event loop then scans for
@@ -116,13 +141,6 @@ evsignal_init(struct event_base *base)
 
 	FD_CLOSEONEXEC(base->sig.ev_signal_pair[0]);
 	FD_CLOSEONEXEC(base->sig.ev_signal_pair[1]);
-	base->sig.sh_old = NULL;
-	base->sig.sh_old_max = 0;
-	base->sig.evsignal_caught = 0;
-	memset(&base->sig.evsigcaught, 0, sizeof(sig_atomic_t)*NSIG);
-	/* initialize the queues for all events */
-	for (i = 0; i < NSIG; ++i)
-		TAILQ_INIT(&base->sig.evsigevents[i]);
 
         evutil_make_socket_nonblocking(base->sig.ev_signal_pair[0]);
 
@@ -134,6 +152,164 @@ evsignal_init(struct event_base *base)
 	return 0;
 }
 
+#ifdef HAVE_SYS_SIGNALFD_H
+/*
+ * The signals of a base with EVBASE_SIGNALFD stay blocked and pending
+ * until the loop reads them from a signalfd; no handler runs, nothing is
+ * shared with other bases, and one read picks up several signals.
+ */
+
+#ifdef HAVE_PTHREAD_H
+#define evsignal_setmask(how, set, old)	pthread_sigmask((how), (set), (old))
+#else
+#define evsignal_setmask(how, set, old)	sigprocmask((how), (set), (old))
+#endif
+
+/* signals read from the signalfd at once */
+#define EVSIGNAL_FD_BATCH	16
+
+static void
+evsignal_fd_cb(int fd, short what, void *arg)
+{
+	struct event_base *base = arg;
+	struct signalfd_siginfo info[EVSIGNAL_FD_BATCH];
+	ssize_t n;
+	size_t i;
+
+	for (;;) {
+		n = read(fd, info, sizeof(info));
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN)
+				event_warn("%s: read", __func__);
+			break;
+		}
+
+		for (i = 0; i < (size_t)n / sizeof(info[0]); i++) {
+			int evsignal = (int)info[i].ssi_signo;
+			if (evsignal > 0 && evsignal < NSIG)
+				base->sig.evsigcaught[evsignal]++;
+		}
+		if ((size_t)n < sizeof(info))
+			break;
+	}
+
+	evsignal_process(base);
+}
+
+static int
+evsignal_fd_init(struct event_base *base)
+{
+	struct evsignal_info *sig = &base->sig;
+
+	sigemptyset(&sig->sigfd_mask);
+	sigemptyset(&sig->sigfd_blocked);
+	sig->sigfd = signalfd(-1, &sig->sigfd_mask,
+	    SFD_NONBLOCK | SFD_CLOEXEC);
+	if (sig->sigfd == -1) {
+		event_warn("%s: signalfd", __func__);
+		return (-1);
+	}
+
+	event_set(&sig->ev_signal, sig->sigfd, EV_READ | EV_PERSIST,
+	    evsignal_fd_cb, base);
+	sig->ev_signal.ev_base = base;
+	sig->ev_signal.ev_flags |= EVLIST_INTERNAL;
+
+	return (0);
+}
+
+/*
+ * After a fork, parent and child share the mask of the signalfd, so the
+ * child must get its own before it changes it.  ev_signal must not be
+ * added meanwhile.
+ */
+static int
+evsignal_fd_reopen(struct event_base *base)
+{
+	struct evsignal_info *sig = &base->sig;
+	int fd;
+
+	fd = signalfd(-1, &sig->sigfd_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (fd == -1) {
+		event_warn("%s: signalfd", __func__);
+		return (-1);
+	}
+	close(sig->sigfd);
+	sig->sigfd = fd;
+
+	event_set(&sig->ev_signal, sig->sigfd, EV_READ | EV_PERSIST,
+	    evsignal_fd_cb, base);
+	sig->ev_signal.ev_base = base;
+	sig->ev_signal.ev_flags |= EVLIST_INTERNAL;
+
+	return (0);
+}
+
+static int
+evsignal_fd_add(struct event_base *base, int evsignal)
+{
+	struct evsignal_info *sig = &base->sig;
+	sigset_t set, old;
+
+	/* a signal only shows up on the signalfd while it is blocked */
+	sigemptyset(&set);
+	sigaddset(&set, evsignal);
+	if (evsignal_setmask(SIG_BLOCK, &set, &old) != 0) {
+		event_warn("%s: sigprocmask", __func__);
+		return (-1);
+	}
+	if (!sigismember(&old, evsignal))
+		sigaddset(&sig->sigfd_blocked, evsignal);
+
+	sigaddset(&sig->sigfd_mask, evsignal);
+	if (signalfd(sig->sigfd, &sig->sigfd_mask, 0) == -1) {
+		event_warn("%s: signalfd", __func__);
+		evsignal_fd_del(base, evsignal);
+		return (-1);
+	}
+
+	return (0);
+}
+
+static void
+evsignal_fd_del(struct event_base *base, int evsignal)
+{
+	struct evsignal_info *sig = &base->sig;
+	struct timespec ts;
+	sigset_t set;
+
+	sigdelset(&sig->sigfd_mask, evsignal);
+	if (signalfd(sig->sigfd, &sig->sigfd_mask, 0) == -1)
+		event_warn("%s: signalfd", __func__);
+
+	if (!sigismember(&sig->sigfd_blocked, evsignal))
+		return;
+	sigdelset(&sig->sigfd_blocked, evsignal);
+
+	/* once unblocked, a signal still pending would kill us */
+	sigemptyset(&set);
+	sigaddset(&set, evsignal);
+	ts.tv_sec = 0;
+	ts.tv_nsec = 0;
+	while (sigtimedwait(&set, NULL, &ts) == evsignal)
+		;
+	if (evsignal_setmask(SIG_UNBLOCK, &set, NULL) != 0)
+		event_warn("%s: sigprocmask", __func__);
+}
+#endif
+
+int
+evsignal_reopen(struct event_base *base)
+{
+#ifdef HAVE_SYS_SIGNALFD_H
+	if (base->sig.sigfd != -1)
+		return (evsignal_fd_reopen(base));
+#endif
+	return (0);
+}
+
 /* Helper: set the signal handler for evsignal to handler in base, so that
  * we can restore the original handler when we clear the current one. */
 int
@@ -156,7 +332,7 @@ _evsignal_set_handler(struct event_base *base,
 		int new_max = evsignal + 1;
 		event_debug(("%s: evsignal (%d) >= sh_old_max (%d), resizing",
 			    __func__, evsignal, sig->sh_old_max));
-		p = realloc(sig->sh_old, new_max * sizeof(*sig->sh_old));
+		p = mm_realloc(sig->sh_old, new_max * sizeof(*sig->sh_old));
 		if (p == NULL) {
 			event_warn("realloc");
 			return (-1);
@@ -170,7 +346,7 @@ _evsignal_set_handler(struct event_base *base,
 	}
 
 	/* allocate space for previous handler out of dynamic array */
-	sig->sh_old[evsignal] = malloc(sizeof *sig->sh_old[evsignal]);
+	sig->sh_old[evsignal] = mm_malloc(sizeof *sig->sh_old[evsignal]);
 	if (sig->sh_old[evsignal] == NULL) {
 		event_warn("malloc");
 		return (-1);
@@ -185,13 +361,13 @@ _evsignal_set_handler(struct event_base *base,
 
 	if (sigaction(evsignal, &sa, sig->sh_old[evsignal]) == -1) {
 		event_warn("sigaction");
-		free(sig->sh_old[evsignal]);
+		mm_free(sig->sh_old[evsignal]);
 		return (-1);
 	}
 #else
 	if ((sh = signal(evsignal, handler)) == SIG_ERR) {
 		event_warn("signal");
-		free(sig->sh_old[evsignal]);
+		mm_free(sig->sh_old[evsignal]);
 		return (-1);
 	}
 	*sig->sh_old[evsignal] = sh;
@@ -228,13 +404,24 @@ evsignal_add(struct event *ev)
 
 	// 数组，evsigevents[signo]表示注册到信号signo的事件链表
 	if (TAILQ_EMPTY(&sig->evsigevents[evsignal])) {
-		event_debug(("%s: %p: changing signal handler", __func__, ev));
-		if (_evsignal_set_handler(
-			    base, evsignal, evsignal_handler) == -1)
-			return (-1);
+#ifdef HAVE_SYS_SIGNALFD_H
+		if (sig->sigfd != -1) {
+			event_debug(("%s: %p: adding signal to signalfd",
+				__func__, ev));
+			if (evsignal_fd_add(base, evsignal) == -1)
+				return (-1);
+		} else
+#endif
+		{
+			event_debug(("%s: %p: changing signal handler",
+				__func__, ev));
+			if (_evsignal_set_handler(
+				    base, evsignal, evsignal_handler) == -1)
+				return (-1);
 
-		/* catch signals if they happen quickly */
-		evsignal_base = base;
+			/* catch signals if they happen quickly */
+			evsignal_base = base;
+		}
 
 		if (!sig->ev_signal_added) {
 			if (event_add(&sig->ev_signal, NULL))
@@ -274,7 +461,7 @@ _evsignal_restore_handler(struct event_base *base, int evsignal)
 		ret = -1;
 	}
 #endif
-	free(sh);
+	mm_free(sh);
 
 	return ret;
 }
@@ -298,6 +485,13 @@ evsignal_del(struct event *ev)
 	if (!TAILQ_EMPTY(&sig->evsigevents[evsignal]))
 		return (0);
 
+#ifdef HAVE_SYS_SIGNALFD_H
+	if (sig->sigfd != -1) {
+		evsignal_fd_del(base, evsignal);
+		return (0);
+	}
+#endif
+
 	event_debug(("%s: %p: restoring signal handler", __func__, ev));
 
 	return (_evsignal_restore_handler(ev->ev_base, EVENT_SIGNAL(ev)));
@@ -376,12 +570,27 @@ evsignal_dealloc(struct event_base *base)
 			_evsignal_restore_handler(base, i);
 	}
 
-	EVUTIL_CLOSESOCKET(base->sig.ev_signal_pair[0]);
-	base->sig.ev_signal_pair[0] = -1;
-	EVUTIL_CLOSESOCKET(base->sig.ev_signal_pair[1]);
-	base->sig.ev_signal_pair[1] = -1;
+#ifdef HAVE_SYS_SIGNALFD_H
+	if (base->sig.sigfd != -1) {
+		for (i = 1; i < NSIG; ++i) {
+			if (sigismember(&base->sig.sigfd_mask, i) == 1)
+				evsignal_fd_del(base, i);
+		}
+		close(base->sig.sigfd);
+		base->sig.sigfd = -1;
+	}
+#endif
+
+	if (base->sig.ev_signal_pair[0] != -1) {
+		EVUTIL_CLOSESOCKET(base->sig.ev_signal_pair[0]);
+		base->sig.ev_signal_pair[0] = -1;
+	}
+	if (base->sig.ev_signal_pair[1] != -1) {
+		EVUTIL_CLOSESOCKET(base->sig.ev_signal_pair[1]);
+		base->sig.ev_signal_pair[1] = -1;
+	}
 	base->sig.sh_old_max = 0;
 
 	/* per index frees are handled in evsignal_del() */
-	free(base->sig.sh_old);
+	mm_free(base->sig.sh_old);
 }
@@ -40,6 +40,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/queue.h>
 #ifdef WIN32
 #include <windows.h>
 #else
@@ -53,15 +54,25 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 #include <event.h>
 #include <evutil.h>
+#include <evhttp.h>
 
 
 static int count, writes, fired;
 static int *pipes;
 static int num_pipes, num_active, num_writes;
 static struct event *events;
+static int num_timers, num_churn;
+static int num_layout;
+static int fd_spread;
+static int stream_kbytes;
 
 static void
 read_cb(int fd, short which, void *arg)
@@ -118,6 +129,231 @@ run_once(void)
 	return (&te);
 }
 
+static void
+timer_cb(int fd, short which, void *arg)
+{
+	fired++;
+}
+
+static void
+timer_random(struct timeval *tv)
+{
+	/* idle and I/O timeouts between one second and a minute */
+	long usec = 1000000L + random() % 59000000L;
+	tv->tv_sec = usec / 1000000L;
+	tv->tv_usec = usec % 1000000L;
+}
+
+/*
+ * Timeout churn: every round reschedules num_churn random timeouts out of
+ * num_timers, the way bufferevents refresh their read and write timeouts,
+ * and then runs the loop once.
+ */
+static struct timeval *
+run_timers(int flags)
+{
+	struct event_base *base;
+	struct timeval tv;
+	static struct timeval ts, te;
+	int i, round;
+
+	base = event_base_new_with_flags(flags);
+	srandom(1);
+	for (i = 0; i < num_timers; i++) {
+		evtimer_set(&events[i], timer_cb, NULL);
+		event_base_set(base, &events[i]);
+		timer_random(&tv);
+		evtimer_add(&events[i], &tv);
+	}
+
+	fired = 0;
+	gettimeofday(&ts, NULL);
+	for (round = 0; round < 100; round++) {
+		for (i = 0; i < num_churn; i++) {
+			timer_random(&tv);
+			evtimer_add(&events[random() % num_timers], &tv);
+		}
+		event_base_loop(base, EVLOOP_ONCE | EVLOOP_NONBLOCK);
+	}
+	gettimeofday(&te, NULL);
+
+	for (i = 0; i < num_timers; i++)
+		evtimer_del(&events[i]);
+	event_base_free(base);
+
+	evutil_timersub(&te, &ts, &te);
+
+	return (&te);
+}
+
+#ifdef __linux__
+/* counts the cache misses of this thread, or returns -1 without a PMU */
+static int
+cache_miss_counter(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+static void
+layout_cb(int fd, short which, void *arg)
+{
+	fired++;
+}
+
+/*
+ * Layout: activates num_layout events in random order and runs their
+ * callbacks, so that nearly every struct event is a cold cache line.
+ * Reports microseconds and, where perf counters exist, cache misses.
+ */
+static struct timeval *
+run_layout(struct event_base *base, struct event **evs, long long *misses)
+{
+	static struct timeval ts, te;
+	int i, round, mfd = -1;
+
+#ifdef __linux__
+	if ((mfd = cache_miss_counter()) != -1) {
+		ioctl(mfd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(mfd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+	fired = 0;
+	gettimeofday(&ts, NULL);
+	for (round = 0; round < 10; round++) {
+		for (i = 0; i < num_layout; i++)
+			event_active(evs[i], EV_READ, 1);
+		event_base_loop(base, EVLOOP_ONCE | EVLOOP_NONBLOCK);
+	}
+	gettimeofday(&te, NULL);
+
+	*misses = -1;
+#ifdef __linux__
+	if (mfd != -1) {
+		ioctl(mfd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(mfd, misses, sizeof(*misses)) != sizeof(*misses))
+			*misses = -1;
+		close(mfd);
+	}
+#endif
+
+	evutil_timersub(&te, &ts, &te);
+
+	return (&te);
+}
+
+static ev_uint64_t
+mem_in_use(void)
+{
+	struct event_mem_stats stats;
+	ev_uint64_t bytes = 0;
+	int i;
+
+	for (i = 0; i < EVENT_MEM_NMODULES; i++) {
+		event_get_mem_stats(i, &stats);
+		bytes += stats.bytes;
+	}
+
+	return (bytes);
+}
+
+static void
+layout_report(void)
+{
+	size_t ev = sizeof(struct event);
+	struct bufferevent *bev;
+	struct evhttp_connection *evcon;
+	ev_uint64_t before;
+
+	fprintf(stdout, "struct event %lu bytes\n", (unsigned long)ev);
+
+	before = mem_in_use();
+	bev = bufferevent_new(-1, NULL, NULL, NULL, NULL);
+	fprintf(stdout, "bufferevent %lu bytes per connection (%lu in events)\n",
+	    (unsigned long)(mem_in_use() - before), (unsigned long)(2 * ev));
+	bufferevent_free(bev);
+
+	before = mem_in_use();
+	evcon = evhttp_connection_new("127.0.0.1", 80);
+	fprintf(stdout, "evhttp_connection %lu bytes per connection "
+	    "(%lu in events)\n",
+	    (unsigned long)(mem_in_use() - before), (unsigned long)(2 * ev));
+	evhttp_connection_free(evcon);
+}
+
+#define STREAM_BLOCK	16384
+
+static void
+stream_request_cb(struct evhttp_request *req, void *arg)
+{
+	static char block[STREAM_BLOCK];
+	struct evbuffer *chunk = evbuffer_new();
+	int i;
+
+	/* the whole response is queued before the first byte goes out */
+	evhttp_send_reply_start(req, HTTP_OK, "OK");
+	for (i = 0; i < stream_kbytes / (STREAM_BLOCK / 1024); i++) {
+		evbuffer_add(chunk, block, sizeof(block));
+		evhttp_send_reply_chunk(req, chunk);
+	}
+	evhttp_send_reply_end(req);
+	evbuffer_free(chunk);
+}
+
+static void
+stream_response_cb(struct evhttp_request *req, void *arg)
+{
+	struct event_base *base = arg;
+
+	if (req == NULL ||
+	    EVBUFFER_LENGTH(req->input_buffer) < (size_t)stream_kbytes * 1024) {
+		fprintf(stderr, "short response\n");
+		exit(1);
+	}
+	event_base_loopexit(base, NULL);
+}
+
+/*
+ * Stream: fetches a chunked response of stream_kbytes over loopback from
+ * an evhttp server in the same loop, ten times.
+ */
+static struct timeval *
+run_stream(struct event_base *base, int port)
+{
+	static struct timeval ts, te;
+	struct evhttp_connection *evcon;
+	struct evhttp_request *req;
+	int round;
+
+	gettimeofday(&ts, NULL);
+	for (round = 0; round < 10; round++) {
+		evcon = evhttp_connection_new("127.0.0.1", port);
+		evhttp_connection_set_base(evcon, base);
+		req = evhttp_request_new(stream_response_cb, base);
+		evhttp_add_header(req->output_headers, "Host", "localhost");
+		if (evhttp_make_request(evcon, req, EVHTTP_REQ_GET, "/") == -1) {
+			fprintf(stderr, "cannot make request\n");
+			exit(1);
+		}
+		event_base_dispatch(base);
+		evhttp_connection_free(evcon);
+	}
+	gettimeofday(&te, NULL);
+
+	evutil_timersub(&te, &ts, &te);
+
+	return (&te);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -131,8 +367,28 @@ main (int argc, char **argv)
 	num_pipes = 100;
 	num_active = 1;
 	num_writes = num_pipes;
-	while ((c = getopt(argc, argv, "n:a:w:")) != -1) {
+	num_timers = 0;
+	num_churn = 10000;
+	num_layout = 0;
+	fd_spread = 0;
+	stream_kbytes = 0;
+	while ((c = getopt(argc, argv, "n:a:w:t:c:l:d:s:")) != -1) {
 		switch (c) {
+		case 's':
+			stream_kbytes = atoi(optarg);
+			break;
+		case 'd':
+			fd_spread = atoi(optarg);
+			break;
+		case 'l':
+			num_layout = atoi(optarg);
+			break;
+		case 't':
+			num_timers = atoi(optarg);
+			break;
+		case 'c':
+			num_churn = atoi(optarg);
+			break;
 		case 'n':
 			num_pipes = atoi(optarg);
 			break;
@@ -148,8 +404,110 @@ main (int argc, char **argv)
 		}
 	}
 
+	if (num_timers > 0) {
+		/* compare the timeout stores: bench -t timers [-c churn] */
+		events = calloc(num_timers, sizeof(struct event));
+		if (events == NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		for (i = 0; i < 5; i++) {
+			tv = run_timers(0);
+			fprintf(stdout, "heap %ld",
+			    tv->tv_sec * 1000000L + tv->tv_usec);
+			tv = run_timers(EVBASE_TIMER_WHEEL);
+			fprintf(stdout, " wheel %ld\n",
+			    tv->tv_sec * 1000000L + tv->tv_usec);
+		}
+		exit(0);
+	}
+
+	if (num_layout > 0) {
+		/* event footprint and dispatch cost: bench -l events */
+		struct event_base *base;
+		struct event **evs;
+		long long misses;
+
+		/* sizes of the private structures come from the allocator */
+		if (event_enable_mem_accounting() == -1) {
+			fprintf(stderr, "cannot count memory\n");
+			exit(1);
+		}
+		base = event_base_new();
+		evs = calloc(num_layout, sizeof(struct event *));
+		if (evs == NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		for (i = 0; i < num_layout; i++)
+			evs[i] = event_new(base, -1, 0, layout_cb, NULL);
+		/* shuffle, so that the callbacks do not walk memory in order */
+		srandom(1);
+		for (i = num_layout - 1; i > 0; i--) {
+			int j = random() % (i + 1);
+			struct event *tmp = evs[i];
+			evs[i] = evs[j];
+			evs[j] = tmp;
+		}
+
+		layout_report();
+		for (i = 0; i < 5; i++) {
+			tv = run_layout(base, evs, &misses);
+			fprintf(stdout, "%ld us", tv->tv_sec * 1000000L + tv->tv_usec);
+			if (misses >= 0)
+				fprintf(stdout, " %.2f misses/callback",
+				    (double)misses / fired);
+			fprintf(stdout, "\n");
+		}
+
+		for (i = 0; i < num_layout; i++)
+			event_free(evs[i]);
+		free(evs);
+		event_base_free(base);
+		exit(0);
+	}
+
+	if (stream_kbytes > 0) {
+		/* large evhttp responses: bench -s kbytes */
+		struct event_base *base = event_base_new();
+		struct evhttp *http = evhttp_new(base);
+		int port;
+
+		for (port = 8080; port < 8180; port++) {
+			if (evhttp_bind_socket(http, "127.0.0.1", port) != -1)
+				break;
+		}
+		if (port == 8180) {
+			fprintf(stderr, "cannot bind\n");
+			exit(1);
+		}
+		evhttp_set_gencb(http, stream_request_cb, NULL);
+
+		for (i = 0; i < 5; i++) {
+			long us;
+
+			tv = run_stream(base, port);
+			us = tv->tv_sec * 1000000L + tv->tv_usec;
+			fprintf(stdout, "%ld us %.1f MB/s\n", us,
+			    us > 0 ? 10.0 * stream_kbytes / 1024 * 1000000 / us :
+			    0);
+		}
+
+		evhttp_free(http);
+		event_base_free(base);
+		exit(0);
+	}
+
+	/* sparse against dense fds: bench -n pipes -d spread, 1 is dense */
+	if (fd_spread > 0 && event_enable_mem_accounting() == -1) {
+		fprintf(stderr, "cannot count memory\n");
+		exit(1);
+	}
+
 #ifndef WIN32
 	rl.rlim_cur = rl.rlim_max = num_pipes * 2 + 50;
+	if (fd_spread > 1)
+		rl.rlim_cur = rl.rlim_max += num_pipes * fd_spread;
 	if (setrlimit(RLIMIT_NOFILE, &rl) == -1) {
 		perror("setrlimit");
 		exit(1);
@@ -176,6 +534,19 @@ main (int argc, char **argv)
 		}
 	}
 
+	if (fd_spread > 1) {
+		/* the read ends end up fd_spread apart, as after dup2() */
+		for (cp = pipes, i = 0; i < num_pipes; i++, cp += 2) {
+			int fd = num_pipes * 2 + 50 + i * fd_spread;
+			if (dup2(cp[0], fd) == -1) {
+				perror("dup2");
+				exit(1);
+			}
+			close(cp[0]);
+			cp[0] = fd;
+		}
+	}
+
 	for (i = 0; i < 25; i++) {
 		tv = run_once();
 		if (tv == NULL)
@@ -184,5 +555,14 @@ main (int argc, char **argv)
 			tv->tv_sec * 1000000L + tv->tv_usec);
 	}
 
+	if (fd_spread > 0) {
+		struct event_mem_stats stats;
+
+		event_get_mem_stats(EVENT_MEM_CORE, &stats);
+		fprintf(stdout, "core %llu bytes in %llu blocks\n",
+		    (unsigned long long)stats.bytes,
+		    (unsigned long long)stats.blocks);
+	}
+
 	exit(0);
 }
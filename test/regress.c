@@ -42,7 +42,9 @@
 #include <sys/queue.h>
 #ifndef WIN32
 #include <sys/socket.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
+#include <netinet/in.h>
 #include <signal.h>
 #include <unistd.h>
 #include <netdb.h>
@@ -54,6 +56,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "event.h"
 #include "evutil.h"
@@ -76,6 +81,7 @@ static int usepersist;
 static struct timeval tset;
 static struct timeval tcalled;
 static struct event_base *global_base;
+static struct event_base *post_base;
 
 #define TEST1	"this is a test"
 #define SECONDS	1
@@ -1002,258 +1008,2051 @@ test_loopbreak(void)
 	cleanup_test();
 }
 
-static void
-test_evbuffer(void) {
-
-	struct evbuffer *evb = evbuffer_new();
-	setup_test("Testing Evbuffer: ");
-
-	evbuffer_add_printf(evb, "%s/%d", "hello", 1);
-
-	if (EVBUFFER_LENGTH(evb) == 7 &&
-	    strcmp((char*)EVBUFFER_DATA(evb), "hello/1") == 0)
-	    test_ok = 1;
-	
-	evbuffer_free(evb);
+static int post_order[3];
+static int post_count;
 
-	cleanup_test();
+static void
+post_cb(void *arg)
+{
+	if (post_count < 3)
+		post_order[post_count] = (int)(long)arg;
+	if (++post_count == 3)
+		event_base_loopbreak(post_base);
 }
 
 static void
-test_evbuffer_find(void)
+test_base_post(void)
 {
-	u_char* p;
-	const char* test1 = "1234567890\r\n";
-	const char* test2 = "1234567890\r";
-#define EVBUFFER_INITIAL_LENGTH 256
-	char test3[EVBUFFER_INITIAL_LENGTH];
-	unsigned int i;
-	struct evbuffer * buf = evbuffer_new();
+	struct event ev;
+	struct timeval tv, tv_start, tv_end;
+	long i;
 
-	/* make sure evbuffer_find doesn't match past the end of the buffer */
-	fprintf(stdout, "Testing evbuffer_find 1: ");
-	evbuffer_add(buf, (u_char*)test1, strlen(test1));
-	evbuffer_drain(buf, strlen(test1));	  
-	evbuffer_add(buf, (u_char*)test2, strlen(test2));
-	p = evbuffer_find(buf, (u_char*)"\r\n", 2);
-	if (p == NULL) {
-		fprintf(stdout, "OK\n");
-	} else {
-		fprintf(stdout, "FAILED\n");
-		exit(1);
-	}
+	setup_test("Event base post: ");
 
-	/*
-	 * drain the buffer and do another find; in r309 this would
-	 * read past the allocated buffer causing a valgrind error.
-	 */
-	fprintf(stdout, "Testing evbuffer_find 2: ");
-	evbuffer_drain(buf, strlen(test2));
-	for (i = 0; i < EVBUFFER_INITIAL_LENGTH; ++i)
-		test3[i] = 'a';
-	test3[EVBUFFER_INITIAL_LENGTH - 1] = 'x';
-	evbuffer_add(buf, (u_char *)test3, EVBUFFER_INITIAL_LENGTH);
-	p = evbuffer_find(buf, (u_char *)"xy", 2);
-	if (p == NULL) {
-		printf("OK\n");
-	} else {
-		fprintf(stdout, "FAILED\n");
-		exit(1);
-	}
+	post_base = event_base_new();
 
-	/* simple test for match at end of allocated buffer */
-	fprintf(stdout, "Testing evbuffer_find 3: ");
-	p = evbuffer_find(buf, (u_char *)"ax", 2);
-	if (p != NULL && strncmp((char*)p, "ax", 2) == 0) {
-		printf("OK\n");
-	} else {
-		fprintf(stdout, "FAILED\n");
-		exit(1);
+	/* keep the loop busy with a timer that must not fire */
+	tv.tv_sec = 60;
+	tv.tv_usec = 0;
+	evtimer_set(&ev, timeout_cb, NULL);
+	event_base_set(post_base, &ev);
+	evtimer_add(&ev, &tv);
+
+	post_count = 0;
+	for (i = 0; i < 3; i++) {
+		if (event_base_post(post_base, post_cb, (void *)i) == -1)
+			goto end;
 	}
 
-	evbuffer_free(buf);
-}
+	evutil_gettimeofday(&tv_start, NULL);
+	event_base_dispatch(post_base);
+	evutil_gettimeofday(&tv_end, NULL);
+	evutil_timersub(&tv_end, &tv_start, &tv_end);
 
-/*
- * simple bufferevent test
- */
+	if (post_count == 3 && post_order[0] == 0 && post_order[1] == 1 &&
+	    post_order[2] == 2 && tv_end.tv_sec < 5)
+		test_ok = 1;
 
-static void
-readcb(struct bufferevent *bev, void *arg)
-{
-	if (EVBUFFER_LENGTH(bev->input) == 8333) {
-		bufferevent_disable(bev, EV_READ);
-		test_ok++;
-	}
+end:
+	evtimer_del(&ev);
+	event_base_free(post_base);
+	post_base = NULL;
+
+	cleanup_test();
 }
 
+#ifdef HAVE_PTHREAD_H
+static volatile int post_thread_ran;
+
 static void
-writecb(struct bufferevent *bev, void *arg)
+post_thread_cb(void *arg)
 {
-	if (EVBUFFER_LENGTH(bev->output) == 0)
-		test_ok++;
+	post_thread_ran = 1;
 }
 
-static void
-errorcb(struct bufferevent *bev, short what, void *arg)
+/* Posts to the sleeping loop, waits for the callback, then breaks */
+static void *
+post_thread(void *arg)
 {
-	test_ok = -2;
+	struct event_base *base = arg;
+	int i;
+
+	usleep(100 * 1000);
+	if (event_base_post(base, post_thread_cb, NULL) == -1)
+		return (NULL);
+	for (i = 0; i < 200 && !post_thread_ran; i++)
+		usleep(10 * 1000);
+	if (post_thread_ran)
+		event_base_loopbreak(base);
+	return (NULL);
 }
 
 static void
-test_bufferevent(void)
+test_base_post_thread(void)
 {
-	struct bufferevent *bev1, *bev2;
-	char buffer[8333];
-	int i;
-
-	setup_test("Bufferevent: ");
+	struct event_base *base;
+	struct event ev;
+	struct timeval tv, tv_start, tv_end;
+	pthread_t thread;
 
-	bev1 = bufferevent_new(pair[0], readcb, writecb, errorcb, NULL);
-	bev2 = bufferevent_new(pair[1], readcb, writecb, errorcb, NULL);
+	setup_test("Event base post from a thread: ");
 
-	bufferevent_disable(bev1, EV_READ);
-	bufferevent_enable(bev2, EV_READ);
+	base = event_base_new();
 
-	for (i = 0; i < sizeof(buffer); i++)
-		buffer[i] = i;
+	/* the loop sleeps on a timer that must not fire */
+	tv.tv_sec = 5;
+	tv.tv_usec = 0;
+	evtimer_set(&ev, fail_cb, NULL);
+	event_base_set(base, &ev);
+	evtimer_add(&ev, &tv);
 
-	bufferevent_write(bev1, buffer, sizeof(buffer));
+	post_thread_ran = 0;
+	if (pthread_create(&thread, NULL, post_thread, base) != 0)
+		goto end;
 
-	event_dispatch();
+	evutil_gettimeofday(&tv_start, NULL);
+	event_base_dispatch(base);
+	evutil_gettimeofday(&tv_end, NULL);
+	evutil_timersub(&tv_end, &tv_start, &tv_end);
+	pthread_join(thread, NULL);
 
-	bufferevent_free(bev1);
-	bufferevent_free(bev2);
+	/* both the post and the break woke the loop up */
+	if (post_thread_ran && tv_end.tv_sec < 3)
+		test_ok = 1;
 
-	if (test_ok != 2)
-		test_ok = 0;
+end:
+	evtimer_del(&ev);
+	event_base_free(base);
 
 	cleanup_test();
 }
+#endif
 
-/*
- * test watermarks and bufferevent
- */
+static int wheel_order[4];
+static int wheel_count;
 
 static void
-wm_readcb(struct bufferevent *bev, void *arg)
+wheel_cb(int fd, short event, void *arg)
 {
-	int len = EVBUFFER_LENGTH(bev->input);
-	static int nread;
+	if (wheel_count < 4)
+		wheel_order[wheel_count] = (int)(long)arg;
+	wheel_count++;
+}
 
-	assert(len >= 10 && len <= 20);
+static void
+test_timer_wheel(void)
+{
+	/* the last two land on higher levels of the wheel */
+	static const long msec[4] = { 0, 20, 300, 700 };
+	struct event_base *base;
+	struct event ev[4];
+	struct timeval tv, tv_start, tv_end;
+	long i;
 
-	evbuffer_drain(bev->input, len);
+	setup_test("Timer wheel: ");
 
-	nread += len;
-	if (nread == 65000) {
-		bufferevent_disable(bev, EV_READ);
-		test_ok++;
+	base = event_base_new_with_flags(EVBASE_TIMER_WHEEL);
+	for (i = 3; i >= 0; i--) {
+		tv.tv_sec = 0;
+		tv.tv_usec = msec[i] * 1000;
+		evtimer_set(&ev[i], wheel_cb, (void *)i);
+		event_base_set(base, &ev[i]);
+		evtimer_add(&ev[i], &tv);
 	}
+	/* rescheduling must move the timeout, not add another one */
+	tv.tv_usec = 500 * 1000;
+	evtimer_add(&ev[3], &tv);
+
+	wheel_count = 0;
+	evutil_gettimeofday(&tv_start, NULL);
+	event_base_dispatch(base);
+	evutil_gettimeofday(&tv_end, NULL);
+	evutil_timersub(&tv_end, &tv_start, &tv_end);
+
+	if (wheel_count == 4 && wheel_order[0] == 0 && wheel_order[1] == 1 &&
+	    wheel_order[2] == 2 && wheel_order[3] == 3 &&
+	    tv_end.tv_sec == 0 && tv_end.tv_usec >= 500 * 1000)
+		test_ok = 1;
+
+	event_base_free(base);
+
+	cleanup_test();
 }
 
+static int common_order[4];
+static int common_count;
+
 static void
-wm_writecb(struct bufferevent *bev, void *arg)
+common_cb(int fd, short event, void *arg)
 {
-	if (EVBUFFER_LENGTH(bev->output) == 0)
-		test_ok++;
+	if (common_count < 4)
+		common_order[common_count] = (int)(long)arg;
+	common_count++;
 }
 
+static int common_logged;
+
 static void
-wm_errorcb(struct bufferevent *bev, short what, void *arg)
+common_log_cb(int severity, const char *msg)
 {
-	test_ok = -2;
+	++common_logged;
 }
 
 static void
-test_bufferevent_watermarks(void)
+test_common_timeout(void)
 {
-	struct bufferevent *bev1, *bev2;
-	char buffer[65000];
-	int i;
-
-	setup_test("Bufferevent Watermarks: ");
-
-	bev1 = bufferevent_new(pair[0], NULL, wm_writecb, wm_errorcb, NULL);
-	bev2 = bufferevent_new(pair[1], wm_readcb, NULL, wm_errorcb, NULL);
-
-	bufferevent_disable(bev1, EV_READ);
-	bufferevent_enable(bev2, EV_READ);
+	struct event_base *base;
+	struct event ev[5];
+	struct timeval tv, tv_start, tv_end;
+	const struct timeval *common, *again;
+	long i;
 
-	for (i = 0; i < sizeof(buffer); i++)
-		buffer[i] = i;
+	setup_test("Common timeout: ");
 
-	bufferevent_write(bev1, buffer, sizeof(buffer));
+	base = event_base_new();
+	tv.tv_sec = 0;
+	tv.tv_usec = 100 * 1000;
+	common = event_base_init_common_timeout(base, &tv);
+	again = event_base_init_common_timeout(base, &tv);
+	if (common == NULL || common != again)
+		goto end;
+
+	for (i = 0; i < 4; i++) {
+		evtimer_set(&ev[i], common_cb, (void *)i);
+		event_base_set(base, &ev[i]);
+		evtimer_add(&ev[i], common);
+	}
+	if (!evtimer_pending(&ev[1], &tv))
+		goto end;
+	/* removing the head must not disturb the rest of the queue */
+	evtimer_del(&ev[0]);
+	/* an ordinary timeout that expires first */
+	tv.tv_sec = 0;
+	tv.tv_usec = 50 * 1000;
+	evtimer_set(&ev[4], common_cb, (void *)4);
+	event_base_set(base, &ev[4]);
+	evtimer_add(&ev[4], &tv);
 
-	/* limit the reading on the receiving bufferevent */
-	bufferevent_setwatermark(bev2, EV_READ, 10, 20);
+	common_count = 0;
+	evutil_gettimeofday(&tv_start, NULL);
+	event_base_dispatch(base);
+	evutil_gettimeofday(&tv_end, NULL);
+	evutil_timersub(&tv_end, &tv_start, &tv_end);
 
-	event_dispatch();
+	if (common_count != 4 || common_order[0] != 4 ||
+	    common_order[1] != 1 || common_order[2] != 2 ||
+	    common_order[3] != 3 ||
+	    tv_end.tv_sec != 0 || tv_end.tv_usec < 90 * 1000)
+		goto end;
 
-	bufferevent_free(bev1);
-	bufferevent_free(bev2);
+	/* running out of queues is logged once, not on every call */
+	event_set_log_callback(common_log_cb);
+	common_logged = 0;
+	tv.tv_sec = 1;
+	for (i = 0; i < 300; i++) {
+		tv.tv_usec = i;
+		common = event_base_init_common_timeout(base, &tv);
+	}
+	event_set_log_callback(NULL);
+	if (common == NULL && common_logged == 1)
+		test_ok = 1;
 
-	if (test_ok != 2)
-		test_ok = 0;
+end:
+	event_base_free(base);
 
 	cleanup_test();
 }
 
-struct test_pri_event {
-	struct event ev;
-	int count;
-};
+#define PRECISE_ROUNDS	50
+
+static int precise_count;
 
 static void
-test_priorities_cb(int fd, short what, void *arg)
+precise_cb(int fd, short event, void *arg)
 {
-	struct test_pri_event *pri = arg;
+	struct event *ev = arg;
 	struct timeval tv;
 
-	if (pri->count == 3) {
-		event_loopexit(NULL);
+	if (++precise_count == PRECISE_ROUNDS)
 		return;
-	}
-
-	pri->count++;
-
-	evutil_timerclear(&tv);
-	event_add(&pri->ev, &tv);
+	tv.tv_sec = 0;
+	tv.tv_usec = 100;
+	evtimer_add(ev, &tv);
 }
 
 static void
-test_priorities(int npriorities)
+test_precise_timer(void)
 {
-	char buf[32];
-	struct test_pri_event one, two;
-	struct timeval tv;
-
-	evutil_snprintf(buf, sizeof(buf), "Testing Priorities %d: ", npriorities);
-	setup_test(buf);
+	struct event_base *base;
+	struct event ev;
+	struct timeval tv, tv_start, tv_end;
+	const char *method;
 
-	event_base_priority_init(global_base, npriorities);
+	setup_test("Precise timer: ");
 
-	memset(&one, 0, sizeof(one));
-	memset(&two, 0, sizeof(two));
+	base = event_base_new_with_flags(EVBASE_PRECISE_TIMER);
+	evtimer_set(&ev, precise_cb, &ev);
+	event_base_set(base, &ev);
+	tv.tv_sec = 0;
+	tv.tv_usec = 100;
+	evtimer_add(&ev, &tv);
 
-	timeout_set(&one.ev, test_priorities_cb, &one);
-	if (event_priority_set(&one.ev, 0) == -1) {
-		fprintf(stderr, "%s: failed to set priority", __func__);
-		exit(1);
-	}
+	precise_count = 0;
+	evutil_gettimeofday(&tv_start, NULL);
+	event_base_dispatch(base);
+	evutil_gettimeofday(&tv_end, NULL);
+	evutil_timersub(&tv_end, &tv_start, &tv_end);
 
-	timeout_set(&two.ev, test_priorities_cb, &two);
-	if (event_priority_set(&two.ev, npriorities - 1) == -1) {
-		fprintf(stderr, "%s: failed to set priority", __func__);
-		exit(1);
-	}
+	/*
+	 * Rounded up to milliseconds the chain would take at least 50ms;
+	 * only check that for the backends that must not round.
+	 */
+	method = event_base_get_method(base);
+	if (precise_count == PRECISE_ROUNDS &&
+	    tv_end.tv_sec == 0 && tv_end.tv_usec >= PRECISE_ROUNDS * 100 &&
+	    (strcmp(method, "poll") == 0 || tv_end.tv_usec < 40 * 1000))
+		test_ok = 1;
 
-	evutil_timerclear(&tv);
+	event_base_free(base);
 
-	if (event_add(&one.ev, &tv) == -1)
-		exit(1);
-	if (event_add(&two.ev, &tv) == -1)
-		exit(1);
+	cleanup_test();
+}
+
+static void
+stats_cb(int fd, short event, void *arg)
+{
+}
+
+static int
+stats_histogram_ok(const struct event_stats_histogram *hist)
+{
+	ev_uint64_t n = 0;
+	int i;
+
+	for (i = 0; i < EVENT_STATS_NBUCKETS; i++)
+		n += hist->buckets[i];
+	return (n == hist->count && hist->total_usec >= hist->max_usec);
+}
+
+static void
+test_base_stats(void)
+{
+	struct event_base *base;
+	struct event_base_stats stats;
+	struct event_stats_histogram hist;
+	struct event ev[3];
+	struct timeval tv;
+	int i;
+
+	setup_test("Loop statistics: ");
+
+	base = event_base_new();
+	event_base_priority_init(base, 2);
+	if (event_base_get_stats(base, &stats) != -1)
+		goto end;
+	if (event_base_enable_stats(base, 1) == -1)
+		goto end;
+
+	for (i = 0; i < 3; i++) {
+		evtimer_set(&ev[i], stats_cb, NULL);
+		event_base_set(base, &ev[i]);
+		event_priority_set(&ev[i], i == 0 ? 0 : 1);
+		tv.tv_sec = 0;
+		tv.tv_usec = (i + 1) * 10 * 1000;
+		evtimer_add(&ev[i], &tv);
+	}
+	event_base_dispatch(base);
+
+	if (event_base_get_stats(base, &stats) == -1)
+		goto end;
+	if (stats.callbacks != 3 || stats.callback.count != 3 ||
+	    stats.activated != 3 || stats.iterations < 3 ||
+	    stats.wait.count != stats.iterations ||
+	    stats.iteration.count != stats.iterations ||
+	    stats.wait.total_usec < 25 * 1000 ||
+	    stats.nevents != 0 || stats.ntimers != 0 ||
+	    !stats_histogram_ok(&stats.wait) ||
+	    !stats_histogram_ok(&stats.iteration) ||
+	    !stats_histogram_ok(&stats.callback))
+		goto end;
+
+	if (event_base_get_priority_stats(base, 1, &hist) == -1 ||
+	    hist.count != 2 || !stats_histogram_ok(&hist))
+		goto end;
+	if (event_base_get_priority_stats(base, 2, &hist) != -1)
+		goto end;
+
+	/* turning statistics on again starts over */
+	event_base_enable_stats(base, 0);
+	event_base_enable_stats(base, 1);
+	event_base_get_stats(base, &stats);
+	if (stats.iterations == 0 && stats.callbacks == 0)
+		test_ok = 1;
+
+end:
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+static int watchdog_reports;
+static struct event_slow_callback watchdog_last;
+static int watchdog_logged;
+
+static void
+watchdog_slow_cb(int fd, short event, void *arg)
+{
+#ifdef WIN32
+	Sleep(30);
+#else
+	usleep(30 * 1000);
+#endif
+}
+
+static void
+watchdog_report_cb(struct event_base *base,
+    const struct event_slow_callback *info, void *arg)
+{
+	watchdog_reports++;
+	watchdog_last = *info;
+}
+
+static void
+watchdog_log_cb(int severity, const char *msg)
+{
+	if (severity == _EVENT_LOG_WARN && strstr(msg, "slow callback"))
+		watchdog_logged++;
+}
+
+static void
+test_watchdog(void)
+{
+	struct event_base *base;
+	struct event slow, fast;
+	struct timeval tv;
+
+	setup_test("Slow callback watchdog: ");
+
+	base = event_base_new();
+	tv.tv_sec = 0;
+	tv.tv_usec = 20 * 1000;
+	event_base_set_watchdog(base, &tv, watchdog_report_cb, &slow);
+
+	evtimer_set(&slow, watchdog_slow_cb, &slow);
+	event_base_set(base, &slow);
+	evtimer_set(&fast, stats_cb, NULL);
+	event_base_set(base, &fast);
+	tv.tv_usec = 1000;
+	evtimer_add(&slow, &tv);
+	evtimer_add(&fast, &tv);
+
+	watchdog_reports = 0;
+	event_base_dispatch(base);
+
+	if (watchdog_reports != 1 ||
+	    watchdog_last.callback != watchdog_slow_cb ||
+	    watchdog_last.arg != &slow || watchdog_last.fd != -1 ||
+	    watchdog_last.res != EV_TIMEOUT ||
+	    watchdog_last.duration.tv_usec < 20 * 1000)
+		goto end;
+
+	/* without a hook the report is logged */
+	event_base_set_watchdog(base, &tv, NULL, NULL);
+	event_set_log_callback(watchdog_log_cb);
+	evtimer_add(&slow, &tv);
+	watchdog_logged = 0;
+	event_base_dispatch(base);
+	event_set_log_callback(NULL);
+	if (watchdog_logged != 1)
+		goto end;
+
+	event_base_set_watchdog(base, NULL, NULL, NULL);
+	evtimer_add(&slow, &tv);
+	event_base_dispatch(base);
+	if (watchdog_reports == 1)
+		test_ok = 1;
+
+end:
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+static int budget_flood_count;
+static int budget_low_ran;
+
+static void
+budget_flood_cb(int fd, short event, void *arg)
+{
+	struct event *ev = arg;
+
+	/* stays active for as long as it runs */
+	budget_flood_count++;
+	if (budget_low_ran)
+		return;
+	event_active(ev, EV_TIMEOUT, 1);
+}
+
+static void
+budget_low_cb(int fd, short event, void *arg)
+{
+	budget_low_ran = 1;
+}
+
+static void
+test_priority_budgets(void)
+{
+	struct event_base *base;
+	struct event_base_stats stats;
+	struct event flood, low, ev[3];
+	int budgets[2] = { 4, 1 };
+	int i;
+
+	setup_test("Priority budgets: ");
+
+	base = event_base_new();
+	event_base_priority_init(base, 2);
+	if (event_base_set_priority_budgets(base, budgets) == -1)
+		goto end;
+
+	evtimer_set(&flood, budget_flood_cb, &flood);
+	event_base_set(base, &flood);
+	event_priority_set(&flood, 0);
+	evtimer_set(&low, budget_low_cb, NULL);
+	event_base_set(base, &low);
+	event_priority_set(&low, 1);
+	event_active(&flood, EV_TIMEOUT, 1);
+	event_active(&low, EV_TIMEOUT, 1);
+
+	budget_flood_count = budget_low_ran = 0;
+	event_base_dispatch(base);
+	/* the first pass ran four flood callbacks and then the low one */
+	if (!budget_low_ran || budget_flood_count != 5)
+		goto end;
+
+	/* a cap on the callbacks per pass, with strict priorities */
+	event_base_set_priority_budgets(base, NULL);
+	event_base_set_max_callbacks(base, 1);
+	event_base_enable_stats(base, 1);
+	for (i = 0; i < 3; i++) {
+		evtimer_set(&ev[i], stats_cb, NULL);
+		event_base_set(base, &ev[i]);
+		event_active(&ev[i], EV_TIMEOUT, 1);
+	}
+	event_base_loop(base, EVLOOP_NONBLOCK);
+	event_base_get_stats(base, &stats);
+	if (stats.callbacks == 3 && stats.iterations >= 3)
+		test_ok = 1;
+
+end:
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+static int event_new_count;
+
+static void
+event_new_cb(int fd, short event, void *arg)
+{
+	struct event **evp = arg;
+
+	event_new_count++;
+	event_free(*evp);
+	*evp = NULL;
+}
+
+static struct event nested_outer, nested_inner;
+static int nested_outer_calls, nested_inner_calls;
+
+static void
+nested_inner_cb(int fd, short what, void *arg)
+{
+	++nested_inner_calls;
+}
+
+static void
+nested_outer_cb(int fd, short what, void *arg)
+{
+	struct event_base *base = arg;
+
+	/* the first call runs a nested loop, the second stops the rest */
+	if (++nested_outer_calls == 1) {
+		event_active(&nested_inner, EV_TIMEOUT, 1);
+		event_base_loop(base, EVLOOP_ONCE | EVLOOP_NONBLOCK);
+	} else
+		event_del(&nested_outer);
+}
+
+static void
+test_nested_loop(void)
+{
+	struct event_base *base;
+
+	setup_test("Nested loop in a callback: ");
+
+	base = event_base_new();
+	nested_outer_calls = nested_inner_calls = 0;
+	evtimer_set(&nested_outer, nested_outer_cb, base);
+	event_base_set(base, &nested_outer);
+	evtimer_set(&nested_inner, nested_inner_cb, NULL);
+	event_base_set(base, &nested_inner);
+
+	event_active(&nested_outer, EV_TIMEOUT, 3);
+	event_base_loop(base, EVLOOP_NONBLOCK);
+
+	if (nested_outer_calls == 2 && nested_inner_calls == 1)
+		test_ok = 1;
+
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+static void
+test_event_new(void)
+{
+	struct event_base *base;
+	struct event *ev[200], *again;
+	struct timeval tv;
+	int i;
+
+	setup_test("event_new: ");
+
+	base = event_base_new();
+	for (i = 0; i < 200; i++) {
+		ev[i] = event_new(base, -1, 0, event_new_cb, &ev[i]);
+		if (ev[i] == NULL || ((unsigned long)ev[i] & 63) != 0)
+			goto end;
+		tv.tv_sec = 0;
+		tv.tv_usec = (i % 10) * 1000;
+		event_add(ev[i], &tv);
+	}
+
+	event_new_count = 0;
+	event_base_dispatch(base);
+	if (event_new_count != 200)
+		goto end;
+
+	/* freed slots are handed out again */
+	ev[0] = event_new(base, -1, 0, event_new_cb, &ev[0]);
+	again = ev[0];
+	event_free(ev[0]);
+	ev[0] = event_new(base, -1, 0, event_new_cb, &ev[0]);
+	if (ev[0] != again)
+		goto end;
+
+	/* an event may outlive its base */
+	event_base_free(base);
+	base = NULL;
+	event_free(ev[0]);
+
+	test_ok = 1;
+
+end:
+	if (base != NULL)
+		event_base_free(base);
+
+	cleanup_test();
+}
+
+static int regress_mallocs;
+
+static void *
+regress_malloc(size_t sz)
+{
+	regress_mallocs++;
+	return (malloc(sz));
+}
+
+static void *
+regress_realloc(void *p, size_t sz)
+{
+	if (p == NULL)
+		regress_mallocs++;
+	return (realloc(p, sz));
+}
+
+static void
+regress_free(void *p)
+{
+	free(p);
+}
+
+static void
+test_mem_accounting(void)
+{
+	struct event_mem_stats before, during, after;
+	struct evbuffer *buf;
+	int mallocs = regress_mallocs;
+
+	setup_test("Memory accounting: ");
+
+	if (event_get_mem_stats(EVENT_MEM_NMODULES, &before) != -1 ||
+	    event_get_mem_stats(EVENT_MEM_BUFFER, &before) == -1)
+		goto end;
+	/* the core allocated the global base */
+	if (event_get_mem_stats(EVENT_MEM_CORE, &during) == -1 ||
+	    during.bytes == 0 || during.blocks == 0)
+		goto end;
+
+	buf = evbuffer_new();
+	evbuffer_expand(buf, 1000);
+	event_get_mem_stats(EVENT_MEM_BUFFER, &during);
+	evbuffer_free(buf);
+	event_get_mem_stats(EVENT_MEM_BUFFER, &after);
+
+	if (regress_mallocs > mallocs &&
+	    during.bytes >= before.bytes + 1000 &&
+	    during.blocks == before.blocks + 2 &&
+	    during.allocations == before.allocations + 2 &&
+	    after.bytes == before.bytes && after.blocks == before.blocks)
+		test_ok = 1;
+
+end:
+	cleanup_test();
+}
+
+static struct event_base *cached_time_base;
+static int cached_time_ok;
+
+static int
+cached_time_near(const struct timeval *tv)
+{
+	struct timeval now;
+
+	evutil_gettimeofday(&now, NULL);
+	evutil_timersub(&now, tv, &now);
+	return (now.tv_sec == 0 || (now.tv_sec == -1 && now.tv_usec > 0));
+}
+
+static void
+cached_time_cb(int fd, short what, void *arg)
+{
+	struct timeval tv1, tv2, tv3;
+
+	event_base_gettimeofday_cached(cached_time_base, &tv1);
+	event_base_gettimeofday_cached(cached_time_base, &tv2);
+	if (event_base_update_cache_time(cached_time_base) == -1)
+		return;
+	event_base_gettimeofday_cached(cached_time_base, &tv3);
+
+	cached_time_ok = evutil_timercmp(&tv1, &tv2, ==) &&
+	    evutil_timercmp(&tv3, &tv1, >=) && cached_time_near(&tv3);
+}
+
+static void
+test_cached_time(void)
+{
+	struct event ev;
+	struct timeval tv, tv_start, tv_end;
+
+	setup_test("Cached time: ");
+
+	cached_time_base = event_base_new_with_flags(EVBASE_COARSE_CLOCK);
+	evtimer_set(&ev, cached_time_cb, NULL);
+	event_base_set(cached_time_base, &ev);
+	tv.tv_sec = 0;
+	tv.tv_usec = 50 * 1000;
+	evtimer_add(&ev, &tv);
+
+	cached_time_ok = 0;
+	evutil_gettimeofday(&tv_start, NULL);
+	event_base_dispatch(cached_time_base);
+	evutil_gettimeofday(&tv_end, NULL);
+	evutil_timersub(&tv_end, &tv_start, &tv_end);
+
+	/* the coarse clock may lag the start by a scheduler tick */
+	if (cached_time_ok && tv_end.tv_sec == 0 &&
+	    tv_end.tv_usec >= 40 * 1000 &&
+	    event_base_update_cache_time(cached_time_base) == 0 &&
+	    event_base_gettimeofday_cached(cached_time_base, &tv) == 0 &&
+	    cached_time_near(&tv))
+		test_ok = 1;
+
+	event_base_free(cached_time_base);
+
+	cleanup_test();
+}
+
+static void
+busy_poll_read_cb(int fd, short what, void *arg)
+{
+	char buf[16];
+
+	if (read(fd, buf, sizeof(buf)) == 1)
+		++called;
+}
+
+static void
+test_busy_poll(void)
+{
+	struct event_base *base;
+	struct event_base_stats stats;
+	struct event ev, timer;
+	struct timeval tv, tv_start, tv_end;
+
+	setup_test("Busy polling: ");
+
+	base = event_base_new();
+	tv.tv_sec = 0;
+	tv.tv_usec = 1000000;
+	if (event_base_set_busy_poll(base, &tv) != -1)
+		goto end;
+	tv.tv_usec = 10 * 1000;
+	if (event_base_set_busy_poll(base, &tv) == -1 ||
+	    event_base_enable_stats(base, 1) == -1)
+		goto end;
+
+	/* the first spin finds the byte, the second runs into the timer */
+	write(pair[0], "x", 1);
+	event_set(&ev, pair[1], EV_READ, busy_poll_read_cb, NULL);
+	event_base_set(base, &ev);
+	event_add(&ev, NULL);
+	evtimer_set(&timer, stats_cb, NULL);
+	event_base_set(base, &timer);
+	tv.tv_usec = 30 * 1000;
+	evtimer_add(&timer, &tv);
+
+	evutil_gettimeofday(&tv_start, NULL);
+	event_base_dispatch(base);
+	evutil_gettimeofday(&tv_end, NULL);
+	evutil_timersub(&tv_end, &tv_start, &tv_end);
+
+	if (event_base_get_stats(base, &stats) == -1)
+		goto end;
+	if (called == 1 && stats.spin_hits >= 1 && stats.spin_sleeps >= 1 &&
+	    tv_end.tv_sec == 0 && tv_end.tv_usec >= 25 * 1000 &&
+	    event_base_set_busy_poll(base, NULL) == 0)
+		test_ok = 1;
+
+end:
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+#define SLACK_TIMERS	10
+
+static struct timeval slack_start;
+static int slack_early;
+
+static void
+slack_cb(int fd, short what, void *arg)
+{
+	struct timeval now;
+
+	/* arg is the timeout in milliseconds */
+	evutil_gettimeofday(&now, NULL);
+	evutil_timersub(&now, &slack_start, &now);
+	if (now.tv_sec == 0 && now.tv_usec < (long)arg * 1000 - 1000)
+		++slack_early;
+	++called;
+}
+
+/* Runs staggered timers and returns the number of loop passes */
+static int
+slack_run(struct event_base *base, const struct timeval *slack)
+{
+	struct event ev[SLACK_TIMERS];
+	struct event_base_stats stats;
+	struct timeval tv;
+	long i;
+
+	event_base_enable_stats(base, 1);
+	evutil_gettimeofday(&slack_start, NULL);
+	for (i = 0; i < SLACK_TIMERS; i++) {
+		evtimer_set(&ev[i], slack_cb, (void *)(i + 1));
+		event_base_set(base, &ev[i]);
+		tv.tv_sec = 0;
+		tv.tv_usec = (i + 1) * 1000;
+		event_add_with_slack(&ev[i], &tv, slack);
+	}
+	event_base_dispatch(base);
+	event_base_get_stats(base, &stats);
+	return ((int)stats.iterations);
+}
+
+static void
+test_timer_slack(void)
+{
+	struct event_base *base;
+	struct timeval slack;
+	int plain, per_event, per_base;
+
+	setup_test("Timer slack: ");
+
+	slack.tv_sec = 0;
+	slack.tv_usec = 40 * 1000;
+	slack_early = 0;
+
+	base = event_base_new();
+	plain = slack_run(base, NULL);
+	per_event = slack_run(base, &slack);
+	event_base_free(base);
+
+	base = event_base_new();
+	if (event_base_set_timer_slack(base, &slack) == -1)
+		goto end;
+	per_base = slack_run(base, NULL);
+
+	/* the deadlines may straddle a multiple of the slack */
+	if (called == 3 * SLACK_TIMERS && slack_early == 0 &&
+	    plain > 2 && per_event <= 2 && per_base <= 2 &&
+	    event_base_set_timer_slack(base, NULL) == 0)
+		test_ok = 1;
+
+end:
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+static size_t deferred_old, deferred_new;
+
+static void
+deferred_buffer_cb(struct evbuffer *buf, size_t old, size_t now, void *arg)
+{
+	deferred_old = old;
+	deferred_new = now;
+	++called;
+}
+
+static void
+test_deferred_callbacks(void)
+{
+	struct event_base *base;
+	struct evbuffer *buf;
+
+	setup_test("Deferred callbacks: ");
+
+	base = event_base_new();
+	buf = evbuffer_new();
+	evbuffer_setcb(buf, deferred_buffer_cb, NULL);
+
+	evbuffer_add(buf, "abc", 3);
+	if (called != 1 || evbuffer_defer_callbacks(buf, base) == -1)
+		goto end;
+
+	/* three changes, one callback with the net change */
+	evbuffer_add(buf, "def", 3);
+	evbuffer_drain(buf, 1);
+	evbuffer_add(buf, "g", 1);
+	if (called != 1)
+		goto end;
+	/* a pending deferred callback keeps the loop running */
+	if (event_base_dispatch(base) != 1 || called != 2 ||
+	    deferred_old != 3 || deferred_new != 6)
+		goto end;
+
+	/* no callback when the length ends up where it was */
+	evbuffer_add(buf, "h", 1);
+	evbuffer_drain(buf, 1);
+	event_base_loop(base, EVLOOP_NONBLOCK);
+	if (called != 2)
+		goto end;
+
+	/* a buffer freed with a callback pending is forgotten */
+	evbuffer_add(buf, "i", 1);
+	evbuffer_free(buf);
+	buf = NULL;
+	event_base_loop(base, EVLOOP_NONBLOCK);
+	if (called == 2)
+		test_ok = 1;
+
+end:
+	if (buf != NULL)
+		evbuffer_free(buf);
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+#ifdef HAVE_SYS_SIGNALFD_H
+static void
+signalfd_cb(int fd, short what, void *arg)
+{
+	++*(int *)arg;
+}
+
+static void
+test_signalfd(void)
+{
+	struct event_base *base1, *base2;
+	struct event ev1, ev2;
+	int calls1 = 0, calls2 = 0;
+	sigset_t mask;
+
+	setup_test("Signals from a signalfd: ");
+
+	/* each base only sees its own signal */
+	base1 = event_base_new_with_flags(EVBASE_SIGNALFD);
+	base2 = event_base_new_with_flags(EVBASE_SIGNALFD);
+	signal_set(&ev1, SIGUSR1, signalfd_cb, &calls1);
+	event_base_set(base1, &ev1);
+	signal_add(&ev1, NULL);
+	signal_set(&ev2, SIGUSR2, signalfd_cb, &calls2);
+	event_base_set(base2, &ev2);
+	signal_add(&ev2, NULL);
+
+	raise(SIGUSR1);
+	raise(SIGUSR2);
+	event_base_loop(base1, EVLOOP_NONBLOCK);
+	if (calls1 != 1 || calls2 != 0)
+		goto end;
+	event_base_loop(base2, EVLOOP_NONBLOCK);
+	if (calls1 != 1 || calls2 != 1)
+		goto end;
+
+	/* the signals are unblocked again once nobody watches them */
+	signal_del(&ev1);
+	signal_del(&ev2);
+	sigprocmask(SIG_BLOCK, NULL, &mask);
+	if (!sigismember(&mask, SIGUSR1) && !sigismember(&mask, SIGUSR2))
+		test_ok = 1;
+
+end:
+	event_base_free(base1);
+	event_base_free(base2);
+
+	cleanup_test();
+}
+#endif
+
+static int
+foreach_count_cb(struct event_base *base, struct event *ev, void *arg)
+{
+	int *n = arg;
+
+	/* stop at the sixth event when asked to */
+	if (++n[0] == n[1])
+		return (42);
+	return (0);
+}
+
+/* Counts the lines of the stream that contain what */
+static int
+dump_count_lines(FILE *f, const char *what)
+{
+	char line[256];
+	int n = 0;
+
+	rewind(f);
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (strstr(line, what) != NULL)
+			++n;
+	}
+	return (n);
+}
+
+static void
+test_foreach_event(void)
+{
+	struct event_base *base;
+	struct event io[3], timers[5], active;
+	const struct timeval *common;
+	struct timeval tv;
+	int i, n[2];
+	FILE *f = NULL;
+
+	setup_test("Foreach event and dump: ");
+
+	base = event_base_new();
+	tv.tv_sec = 10;
+	tv.tv_usec = 0;
+	common = event_base_init_common_timeout(base, &tv);
+
+	for (i = 0; i < 3; i++) {
+		event_set(&io[i], pair[0], EV_READ | EV_PERSIST, stats_cb,
+		    NULL);
+		event_base_set(base, &io[i]);
+		event_add(&io[i], i == 0 ? &tv : NULL);
+	}
+	for (i = 0; i < 5; i++) {
+		evtimer_set(&timers[i], slack_cb, NULL);
+		event_base_set(base, &timers[i]);
+		evtimer_add(&timers[i], i < 2 && common != NULL ? common : &tv);
+	}
+	evtimer_set(&active, simple_read_cb, NULL);
+	event_base_set(base, &active);
+	event_active(&active, EV_TIMEOUT, 1);
+
+	n[0] = 0;
+	n[1] = 0;
+	if (event_base_foreach_event(base, foreach_count_cb, n) != 0 ||
+	    n[0] != 9)
+		goto end;
+	n[0] = 0;
+	n[1] = 6;
+	if (event_base_foreach_event(base, foreach_count_cb, n) != 42 ||
+	    n[0] != 6)
+		goto end;
+
+	if ((f = tmpfile()) == NULL)
+		goto end;
+	event_base_dump_events(base, f, 0);
+	if (dump_count_lines(f, " cb ") != 9 ||
+	    dump_count_lines(f, "timeout in ") != 6 ||
+	    dump_count_lines(f, " active") != 2)
+		goto end;
+
+	fclose(f);
+	if ((f = tmpfile()) == NULL)
+		goto end;
+	event_base_dump_events(base, f, EVENT_DUMP_SUMMARY);
+	if (dump_count_lines(f, " cb ") == 3 &&
+	    dump_count_lines(f, "5 events, 0 I/O, 0 signals, 5 with timeout") == 1 &&
+	    dump_count_lines(f, "3 events, 3 I/O, 0 signals, 1 with timeout") == 1 &&
+	    dump_count_lines(f, "1 events, 0 I/O, 0 signals, 0 with timeout, 1 active") == 1)
+		test_ok = 1;
+
+end:
+	if (f != NULL)
+		fclose(f);
+	for (i = 0; i < 3; i++)
+		event_del(&io[i]);
+	for (i = 0; i < 5; i++)
+		event_del(&timers[i]);
+	event_del(&active);
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+#define SPARSE_FD	4000
+
+static void
+sparse_fd_cb(int fd, short what, void *arg)
+{
+	char c;
+
+	if (read(fd, &c, 1) == 1)
+		called++;
+}
+
+static void
+test_sparse_fd(void)
+{
+	struct event_mem_stats before, during, after;
+	struct event_base *base;
+	struct event ev;
+	struct timeval tv;
+	int fd, dense;
+
+	setup_test("Sparse fd: ");
+
+	/* an fd limit below SPARSE_FD leaves nothing to test */
+	if ((fd = dup2(pair[0], SPARSE_FD)) == -1) {
+		test_ok = 1;
+		goto end;
+	}
+
+	base = event_base_new();
+	/* select needs its fd_sets up to the highest fd anyway */
+	dense = !strcmp(event_base_get_method(base), "select");
+	/* the slot of event_base_loopexit() must not count below */
+	evutil_timerclear(&tv);
+	event_base_loopexit(base, &tv);
+	event_base_dispatch(base);
+	event_get_mem_stats(EVENT_MEM_CORE, &before);
+
+	event_set(&ev, fd, EV_READ, sparse_fd_cb, NULL);
+	event_base_set(base, &ev);
+	event_add(&ev, NULL);
+	event_get_mem_stats(EVENT_MEM_CORE, &during);
+	write(pair[1], "x", 1);
+	event_base_loop(base, EVLOOP_ONCE);
+	/* the backend lets go of the fd in the next pass */
+	event_base_loopexit(base, &tv);
+	event_base_dispatch(base);
+	event_get_mem_stats(EVENT_MEM_CORE, &after);
+
+	if (called == 1 && (dense ||
+	    (during.bytes < before.bytes + SPARSE_FD * 2 &&
+	     after.bytes < during.bytes)))
+		test_ok = 1;
+
+	event_base_free(base);
+	close(fd);
+end:
+	cleanup_test();
+}
+
+#define MAX_DISPATCH_PAIRS	64
+
+static void
+max_dispatch_cb(int fd, short what, void *arg)
+{
+	called++;
+}
+
+static void
+test_max_dispatch_events(void)
+{
+	struct event_base *base;
+	struct event evs[MAX_DISPATCH_PAIRS];
+	int fds[MAX_DISPATCH_PAIRS][2];
+	int i, first, passes, capped;
+
+	setup_test("Max dispatch events: ");
+
+	base = event_base_new();
+	capped = !strcmp(event_base_get_method(base), "epoll");
+	if (event_base_set_max_dispatch_events(base, -1) != -1 ||
+	    event_base_set_max_dispatch_events(base, 16) == -1)
+		goto end;
+
+	for (i = 0; i < MAX_DISPATCH_PAIRS; i++) {
+		if (evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) == -1) {
+			fprintf(stderr, "%s: socketpair\n", __func__);
+			exit(1);
+		}
+		event_set(&evs[i], fds[i][0], EV_WRITE, max_dispatch_cb, NULL);
+		event_base_set(base, &evs[i]);
+		event_add(&evs[i], NULL);
+	}
+
+	/* every fd is writable, but epoll hands out 16 per wait */
+	event_base_loop(base, EVLOOP_ONCE);
+	first = called;
+	for (passes = 1; called < MAX_DISPATCH_PAIRS && passes < 100;
+	    passes++)
+		event_base_loop(base, EVLOOP_ONCE);
+
+	/* lifting the limit lets all of them through again */
+	event_base_set_max_dispatch_events(base, 0);
+	called = 0;
+	for (i = 0; i < MAX_DISPATCH_PAIRS; i++)
+		event_add(&evs[i], NULL);
+	for (i = 0; i < 100 && called < MAX_DISPATCH_PAIRS; i++)
+		event_base_loop(base, EVLOOP_ONCE);
+
+	if (called == MAX_DISPATCH_PAIRS &&
+	    (capped ? first == 16 && passes == 4 : first > 0))
+		test_ok = 1;
+
+	for (i = 0; i < MAX_DISPATCH_PAIRS; i++) {
+		event_del(&evs[i]);
+		close(fds[i][0]);
+		close(fds[i][1]);
+	}
+end:
+	event_base_free(base);
+	cleanup_test();
+}
+
+#define LISTENER_CONNS	10
+
+static int listener_fds[LISTENER_CONNS];
+
+static void
+listener_cb(struct evlistener *lev, int fd, struct sockaddr *sa,
+    int socklen, void *arg)
+{
+	int *ok = arg;
+
+	if (!(fcntl(fd, F_GETFL) & O_NONBLOCK) ||
+	    !(fcntl(fd, F_GETFD) & FD_CLOEXEC) ||
+	    sa->sa_family != AF_INET || called >= LISTENER_CONNS)
+		*ok = 0;
+	else
+		listener_fds[called] = fd;
+	called++;
+}
+
+static int
+listener_connect(struct sockaddr_in *sin)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd == -1 ||
+	    connect(fd, (struct sockaddr *)sin, sizeof(*sin)) == -1) {
+		fprintf(stderr, "%s: connect\n", __func__);
+		exit(1);
+	}
+	return (fd);
+}
+
+static void
+test_evlistener(void)
+{
+	struct event_base *base;
+	struct evlistener *lev, *lev2 = NULL;
+	struct sockaddr_in sin, sin2;
+	socklen_t slen = sizeof(sin);
+	struct rlimit rl, orig;
+	struct event_base_stats stats;
+	struct timeval tv;
+	int conns[LISTENER_CONNS];
+	int fd, lfd, lfd2, extra = -1, first, ok = 1, i;
+	char c;
+
+	setup_test("Listener: ");
+
+	base = event_base_new();
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(0x7f000001);
+	sin2 = sin;
+	if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) == -1 ||
+	    bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) == -1 ||
+	    listen(lfd, 64) == -1 ||
+	    getsockname(lfd, (struct sockaddr *)&sin, &slen) == -1) {
+		fprintf(stderr, "%s: listen\n", __func__);
+		exit(1);
+	}
+
+	lev = evlistener_new(base, listener_cb, &ok,
+	    EVLISTENER_CLOSE_ON_FREE, lfd);
+	if (lev == NULL || evlistener_get_fd(lev) != lfd ||
+	    evlistener_set_max_accepts(lev, 0) != -1 ||
+	    evlistener_set_max_accepts(lev, 4) == -1)
+		goto end;
+
+	for (i = 0; i < LISTENER_CONNS; i++)
+		conns[i] = listener_connect(&sin);
+
+	/* all connections are pending, but each pass accepts only four */
+	event_base_loop(base, EVLOOP_ONCE);
+	first = called;
+	for (i = 0; i < 10 && called < LISTENER_CONNS; i++)
+		event_base_loop(base, EVLOOP_ONCE);
+	for (i = 0; i < LISTENER_CONNS; i++) {
+		close(conns[i]);
+		if (i < called)
+			close(listener_fds[i]);
+	}
+	if (first != 4 || called != LISTENER_CONNS || !ok)
+		goto end;
+
+	/* without a free descriptor the connection is dropped */
+	called = 0;
+	extra = listener_connect(&sin);
+	fd = dup(0);
+	close(fd);
+	getrlimit(RLIMIT_NOFILE, &orig);
+	rl = orig;
+	rl.rlim_cur = fd;
+	if (setrlimit(RLIMIT_NOFILE, &rl) == -1) {
+		fprintf(stderr, "%s: setrlimit\n", __func__);
+		exit(1);
+	}
+	event_base_loop(base, EVLOOP_ONCE);
+	setrlimit(RLIMIT_NOFILE, &orig);
+
+	if (called != 0 || read(extra, &c, 1) != 0)
+		goto end;
+	close(extra);
+
+	/*
+	 * a listener created without a spare descriptor stops accepting
+	 * instead of spinning, and picks the connection up later
+	 */
+	if ((lfd2 = socket(AF_INET, SOCK_STREAM, 0)) == -1 ||
+	    bind(lfd2, (struct sockaddr *)&sin2, sizeof(sin2)) == -1 ||
+	    listen(lfd2, 64) == -1 ||
+	    getsockname(lfd2, (struct sockaddr *)&sin2, &slen) == -1) {
+		fprintf(stderr, "%s: listen\n", __func__);
+		exit(1);
+	}
+	extra = listener_connect(&sin2);
+	fd = dup(0);
+	close(fd);
+	rl.rlim_cur = fd;
+	setrlimit(RLIMIT_NOFILE, &rl);
+	lev2 = evlistener_new(base, listener_cb, &ok,
+	    EVLISTENER_CLOSE_ON_FREE, lfd2);
+	event_base_enable_stats(base, 1);
+	tv.tv_sec = 0;
+	tv.tv_usec = 300 * 1000;
+	event_base_loopexit(base, &tv);
+	event_base_dispatch(base);
+	setrlimit(RLIMIT_NOFILE, &orig);
+	event_base_get_stats(base, &stats);
+	if (lev2 == NULL || called != 0 || stats.iterations > 10)
+		goto end;
+
+	tv.tv_sec = 2;
+	tv.tv_usec = 0;
+	event_base_loopexit(base, &tv);
+	while (called == 0 && event_base_loop(base, EVLOOP_ONCE) == 0)
+		;
+	if (called == 1 && ok) {
+		close(listener_fds[0]);
+		test_ok = 1;
+	}
+
+end:
+	if (extra != -1)
+		close(extra);
+	if (lev2 != NULL)
+		evlistener_free(lev2);
+	if (lev != NULL)
+		evlistener_free(lev);
+	event_base_free(base);
+	cleanup_test();
+}
+
+static struct event_base *volatile group_cb_base;
+static int group_read_ok;
+
+static void
+group_fd_cb(struct event_base *base, int fd, void *arg)
+{
+	group_cb_base = base;
+	write(fd, "g", 1);
+}
+
+static void
+group_read_cb(int fd, short what, void *arg)
+{
+	char c;
+
+	if (what == EV_READ && read(fd, &c, 1) == 1 && c == 'g')
+		group_read_ok = 1;
+}
+
+static void
+test_base_group(void)
+{
+	struct event_base_group *group;
+	struct event_base *base;
+	struct event ev;
+	struct timeval tv;
+
+	setup_test("Base group: ");
+
+	group = event_base_group_new(2, EVGROUP_ROUND_ROBIN, 0);
+	if (group == NULL)
+		goto out;
+	if (event_base_group_size(group) != 2 ||
+	    event_base_group_select(group, 0) != event_base_group_get(group, 0) ||
+	    event_base_group_select(group, 0) != event_base_group_get(group, 1))
+		goto end;
+
+	/* the group's first base writes back on the fd handed to it */
+	group_cb_base = NULL;
+	group_read_ok = 0;
+	base = event_base_new();
+	tv.tv_sec = 5;
+	tv.tv_usec = 0;
+	event_set(&ev, pair[1], EV_READ, group_read_cb, NULL);
+	event_base_set(base, &ev);
+	event_add(&ev, &tv);
+	if (event_base_group_assign_fd(group, pair[0], group_fd_cb, NULL) == 0)
+		event_base_dispatch(base);
+	event_base_free(base);
+
+	if (group_read_ok && group_cb_base == event_base_group_get(group, 0))
+		test_ok = 1;
+
+end:
+	event_base_group_free(group);
+out:
+	cleanup_test();
+}
+
+static void
+reused_fd_read_cb(int fd, short what, void *arg)
+{
+	char c;
+
+	if (what == EV_READ && read(fd, &c, 1) == 1 && c == 'r')
+		test_ok = 1;
+}
+
+static void
+reused_fd_timeout_cb(int fd, short what, void *arg)
+{
+}
+
+static void
+test_reused_fd(void)
+{
+	struct event_base *base;
+	struct event ev, timeout;
+	struct timeval tv;
+	int newpair[2];
+
+	setup_test("Reused fd: ");
+
+	base = event_base_new();
+	event_set(&ev, pair[1], EV_READ, reused_fd_read_cb, NULL);
+	event_base_set(base, &ev);
+	event_add(&ev, NULL);
+	event_base_loop(base, EVLOOP_NONBLOCK);
+
+	/* replace the socket behind pair[1] before the loop runs again */
+	event_del(&ev);
+	if (evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, newpair) == -1 ||
+	    dup2(newpair[0], pair[1]) == -1)
+		goto end;
+	close(newpair[0]);
+
+	event_set(&ev, pair[1], EV_READ, reused_fd_read_cb, NULL);
+	event_base_set(base, &ev);
+	event_add(&ev, NULL);
+	tv.tv_sec = 2;
+	tv.tv_usec = 0;
+	evtimer_set(&timeout, reused_fd_timeout_cb, NULL);
+	event_base_set(base, &timeout);
+	evtimer_add(&timeout, &tv);
+
+	write(newpair[1], "r", 1);
+	event_base_loop(base, EVLOOP_ONCE);
+
+	event_del(&ev);
+	evtimer_del(&timeout);
+	close(newpair[1]);
+end:
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+static void
+test_unwatchable_fd(void)
+{
+	struct event_base *base;
+	struct event ev;
+	int fd, epoll;
+
+	setup_test("Unwatchable fd: ");
+
+	base = event_base_new();
+	epoll = !strcmp(event_base_get_method(base), "epoll");
+	if ((fd = open("/dev/null", O_RDONLY)) == -1)
+		goto end;
+
+	/* epoll refuses a device; event_add() has to say so */
+	event_set(&ev, fd, EV_READ, simple_read_cb, NULL);
+	event_base_set(base, &ev);
+	if (epoll && event_add(&ev, NULL) != -1)
+		goto out;
+
+	/* the same for an fd reopened after its events went away */
+	event_del(&ev);
+	event_set(&ev, pair[1], EV_READ, simple_read_cb, NULL);
+	event_base_set(base, &ev);
+	if (event_add(&ev, NULL) == -1)
+		goto out;
+	event_base_loop(base, EVLOOP_NONBLOCK);
+	event_del(&ev);
+	if (epoll && event_add(&ev, NULL) == -1)
+		goto out;
+	event_del(&ev);
+
+	if (epoll) {
+		int saved = dup(pair[1]);
+
+		if (saved == -1 || dup2(fd, pair[1]) == -1)
+			goto out;
+		event_set(&ev, pair[1], EV_READ, simple_read_cb, NULL);
+		event_base_set(base, &ev);
+		if (event_add(&ev, NULL) != -1) {
+			dup2(saved, pair[1]);
+			close(saved);
+			goto out;
+		}
+		dup2(saved, pair[1]);
+		close(saved);
+	}
+
+	/* the base keeps working after the failures */
+	event_base_loop(base, EVLOOP_NONBLOCK);
+	test_ok = 1;
+out:
+	close(fd);
+end:
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+static void
+test_evbuffer(void) {
+
+	struct evbuffer *evb = evbuffer_new();
+	setup_test("Testing Evbuffer: ");
+
+	evbuffer_add_printf(evb, "%s/%d", "hello", 1);
+
+	if (EVBUFFER_LENGTH(evb) == 7 &&
+	    strcmp((char*)EVBUFFER_DATA(evb), "hello/1") == 0)
+	    test_ok = 1;
+	
+	evbuffer_free(evb);
+
+	cleanup_test();
+}
+
+static void
+test_evbuffer_chains(void)
+{
+	struct evbuffer *a = evbuffer_new(), *b = evbuffer_new();
+	char data[10000], out[10000];
+	u_char *p;
+	char *line1, *line2 = NULL, *big;
+	struct event_mem_stats before, after;
+	int i, n;
+
+	setup_test("Evbuffer chains: ");
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i % 251;
+	for (i = 0; i < 10; i++)
+		evbuffer_add(a, data + i * 1000, 1000);
+	if (EVBUFFER_LENGTH(a) != 10000)
+		goto end;
+
+	/* moving part of a buffer splits only the chunk in the middle */
+	if (evbuffer_remove_buffer(a, b, 2500) != 2500 ||
+	    EVBUFFER_LENGTH(a) != 7500 || EVBUFFER_LENGTH(b) != 2500 ||
+	    memcmp(EVBUFFER_DATA(b), data, 2500) != 0 ||
+	    memcmp(evbuffer_pullup(a, 100), data + 2500, 100) != 0)
+		goto end;
+
+	/* appending a buffer links its chunks instead of copying them */
+	p = evbuffer_pullup(a, -1);
+	if (evbuffer_add_buffer(b, a) != 0 || EVBUFFER_LENGTH(a) != 0 ||
+	    EVBUFFER_LENGTH(b) != 10000)
+		goto end;
+	evbuffer_drain(b, 2500);
+	if (evbuffer_pullup(b, 1) != p ||
+	    memcmp(EVBUFFER_DATA(b), data + 2500, 7500) != 0)
+		goto end;
+
+	/* a line whose terminator spans two chunks */
+	evbuffer_drain(b, -1);
+	evbuffer_add(a, "first\r", 6);
+	evbuffer_add(b, "\nsecond\n", 8);
+	evbuffer_add_buffer(a, b);
+	line1 = evbuffer_readline(a);
+	line2 = evbuffer_readline(a);
+	n = line1 != NULL && line2 != NULL && !strcmp(line1, "first") &&
+	    !strcmp(line2, "second") && EVBUFFER_LENGTH(a) == 0;
+	free(line1);
+	free(line2);
+	if (!n)
+		goto end;
+
+	/* all chunks go out with one write */
+	for (i = 0; i < 4; i++) {
+		evbuffer_add(b, data + i * 1000, 1000);
+		evbuffer_add_buffer(a, b);
+	}
+	if (evbuffer_write(a, pair[0]) != 4000 || EVBUFFER_LENGTH(a) != 0)
+		goto end;
+	n = 0;
+	while (n < 4000 && (i = read(pair[1], out + n, 4000 - n)) > 0)
+		n += i;
+	if (n != 4000 || memcmp(out, data, 4000) != 0)
+		goto end;
+
+	/* a small append after a large chunk gets a small chunk */
+	if ((big = calloc(1, 1 << 20)) == NULL)
+		goto end;
+	evbuffer_add(a, big, 1 << 20);
+	event_get_mem_stats(EVENT_MEM_BUFFER, &before);
+	evbuffer_add(a, data, 10);
+	event_get_mem_stats(EVENT_MEM_BUFFER, &after);
+	free(big);
+	if (EVBUFFER_LENGTH(a) == (1 << 20) + 10 &&
+	    after.bytes - before.bytes <= 8192)
+		test_ok = 1;
+
+end:
+	evbuffer_free(a);
+	evbuffer_free(b);
+
+	cleanup_test();
+}
+
+static void
+test_evbuffer_find(void)
+{
+	u_char* p;
+	const char* test1 = "1234567890\r\n";
+	const char* test2 = "1234567890\r";
+#define EVBUFFER_INITIAL_LENGTH 256
+	char test3[EVBUFFER_INITIAL_LENGTH];
+	char *big;
+	struct event_mem_stats before, after;
+	unsigned int i;
+	struct evbuffer * buf = evbuffer_new();
+
+	/* make sure evbuffer_find doesn't match past the end of the buffer */
+	fprintf(stdout, "Testing evbuffer_find 1: ");
+	evbuffer_add(buf, (u_char*)test1, strlen(test1));
+	evbuffer_drain(buf, strlen(test1));	  
+	evbuffer_add(buf, (u_char*)test2, strlen(test2));
+	p = evbuffer_find(buf, (u_char*)"\r\n", 2);
+	if (p == NULL) {
+		fprintf(stdout, "OK\n");
+	} else {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	/*
+	 * drain the buffer and do another find; in r309 this would
+	 * read past the allocated buffer causing a valgrind error.
+	 */
+	fprintf(stdout, "Testing evbuffer_find 2: ");
+	evbuffer_drain(buf, strlen(test2));
+	for (i = 0; i < EVBUFFER_INITIAL_LENGTH; ++i)
+		test3[i] = 'a';
+	test3[EVBUFFER_INITIAL_LENGTH - 1] = 'x';
+	evbuffer_add(buf, (u_char *)test3, EVBUFFER_INITIAL_LENGTH);
+	p = evbuffer_find(buf, (u_char *)"xy", 2);
+	if (p == NULL) {
+		printf("OK\n");
+	} else {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	/* simple test for match at end of allocated buffer */
+	fprintf(stdout, "Testing evbuffer_find 3: ");
+	p = evbuffer_find(buf, (u_char *)"ax", 2);
+	if (p != NULL && strncmp((char*)p, "ax", 2) == 0) {
+		printf("OK\n");
+	} else {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	/*
+	 * a match that straddles two chunks is found, and only the data
+	 * up to its end is made contiguous.
+	 */
+	fprintf(stdout, "Testing evbuffer_find 4: ");
+	evbuffer_drain(buf, EVBUFFER_LENGTH(buf));
+	if ((big = calloc(1, 1 << 20)) == NULL)
+		exit(1);
+	memset(big, 'a', 4096);
+	memcpy(big + 4094, "ne", 2);
+	evbuffer_add(buf, big, 4096);
+	memcpy(big, "edle", 4);
+	evbuffer_add(buf, big, 1 << 20);
+	free(big);
+	event_get_mem_stats(EVENT_MEM_BUFFER, &before);
+	p = evbuffer_find(buf, (u_char *)"needle", 6);
+	event_get_mem_stats(EVENT_MEM_BUFFER, &after);
+	if (p != NULL && p - evbuffer_pullup(buf, 0) == 4094 &&
+	    memcmp(p, "needle", 6) == 0 &&
+	    after.blocks == before.blocks &&
+	    evbuffer_find(buf, (u_char *)"needles", 7) == NULL) {
+		printf("OK\n");
+	} else {
+		fprintf(stdout, "FAILED\n");
+		exit(1);
+	}
+
+	evbuffer_free(buf);
+}
+
+/*
+ * simple bufferevent test
+ */
+
+static void
+readcb(struct bufferevent *bev, void *arg)
+{
+	if (EVBUFFER_LENGTH(bev->input) == 8333) {
+		bufferevent_disable(bev, EV_READ);
+		test_ok++;
+	}
+}
+
+static void
+writecb(struct bufferevent *bev, void *arg)
+{
+	if (EVBUFFER_LENGTH(bev->output) == 0)
+		test_ok++;
+}
+
+static void
+errorcb(struct bufferevent *bev, short what, void *arg)
+{
+	test_ok = -2;
+}
+
+static void
+test_bufferevent(void)
+{
+	struct bufferevent *bev1, *bev2;
+	char buffer[8333];
+	int i;
+
+	setup_test("Bufferevent: ");
+
+	bev1 = bufferevent_new(pair[0], readcb, writecb, errorcb, NULL);
+	bev2 = bufferevent_new(pair[1], readcb, writecb, errorcb, NULL);
+
+	bufferevent_disable(bev1, EV_READ);
+	bufferevent_enable(bev2, EV_READ);
+
+	for (i = 0; i < sizeof(buffer); i++)
+		buffer[i] = i;
+
+	bufferevent_write(bev1, buffer, sizeof(buffer));
+
+	event_dispatch();
+
+	bufferevent_free(bev1);
+	bufferevent_free(bev2);
+
+	if (test_ok != 2)
+		test_ok = 0;
+
+	cleanup_test();
+}
+
+/*
+ * test watermarks and bufferevent
+ */
+
+static void
+wm_readcb(struct bufferevent *bev, void *arg)
+{
+	int len = EVBUFFER_LENGTH(bev->input);
+	static int nread;
+
+	assert(len >= 10 && len <= 20);
+
+	evbuffer_drain(bev->input, len);
+
+	nread += len;
+	if (nread == 65000) {
+		bufferevent_disable(bev, EV_READ);
+		test_ok++;
+	}
+}
+
+static void
+wm_writecb(struct bufferevent *bev, void *arg)
+{
+	if (EVBUFFER_LENGTH(bev->output) == 0)
+		test_ok++;
+}
+
+static void
+wm_errorcb(struct bufferevent *bev, short what, void *arg)
+{
+	test_ok = -2;
+}
+
+static void
+test_bufferevent_watermarks(void)
+{
+	struct bufferevent *bev1, *bev2;
+	char buffer[65000];
+	int i;
+
+	setup_test("Bufferevent Watermarks: ");
+
+	bev1 = bufferevent_new(pair[0], NULL, wm_writecb, wm_errorcb, NULL);
+	bev2 = bufferevent_new(pair[1], wm_readcb, NULL, wm_errorcb, NULL);
+
+	bufferevent_disable(bev1, EV_READ);
+	bufferevent_enable(bev2, EV_READ);
+
+	for (i = 0; i < sizeof(buffer); i++)
+		buffer[i] = i;
+
+	bufferevent_write(bev1, buffer, sizeof(buffer));
+
+	/* limit the reading on the receiving bufferevent */
+	bufferevent_setwatermark(bev2, EV_READ, 10, 20);
+
+	event_dispatch();
+
+	bufferevent_free(bev1);
+	bufferevent_free(bev2);
+
+	if (test_ok != 2)
+		test_ok = 0;
+
+	cleanup_test();
+}
+
+/*
+ * the watermark test again, with edge-triggered bufferevents
+ */
+
+static int et_nread;
+
+static void
+et_wm_readcb(struct bufferevent *bev, void *arg)
+{
+	int len = EVBUFFER_LENGTH(bev->input);
+
+	assert(len >= 10 && len <= 20);
+
+	evbuffer_drain(bev->input, len);
+
+	et_nread += len;
+	if (et_nread == 65000) {
+		bufferevent_disable(bev, EV_READ);
+		test_ok++;
+	}
+}
+
+static void
+test_bufferevent_edge_triggered(void)
+{
+	struct bufferevent *bev1, *bev2;
+	char buffer[65000];
+	int i;
+
+	setup_test("Bufferevent EV_ET: ");
+
+	bev1 = bufferevent_new(pair[0], NULL, wm_writecb, wm_errorcb, NULL);
+	bev2 = bufferevent_new(pair[1], et_wm_readcb, NULL, wm_errorcb, NULL);
+
+	if (!(event_base_get_features(bev1->ev_read.ev_base) &
+		EV_FEATURE_ET)) {
+		/* must be refused, and the bufferevent must keep working */
+		if (bufferevent_set_edge_triggered(bev1, 1) == -1)
+			test_ok = 2;
+		goto end;
+	}
+	if (bufferevent_set_edge_triggered(bev1, 1) == -1 ||
+	    bufferevent_set_edge_triggered(bev2, 1) == -1)
+		goto end;
+
+	bufferevent_disable(bev1, EV_READ);
+	bufferevent_enable(bev2, EV_READ);
+
+	for (i = 0; i < sizeof(buffer); i++)
+		buffer[i] = i;
+
+	et_nread = 0;
+	bufferevent_write(bev1, buffer, sizeof(buffer));
+
+	/* limit the reading on the receiving bufferevent */
+	bufferevent_setwatermark(bev2, EV_READ, 10, 20);
+
+	event_dispatch();
+
+end:
+	bufferevent_free(bev1);
+	bufferevent_free(bev2);
+
+	if (test_ok != 2)
+		test_ok = 0;
+
+	cleanup_test();
+}
+
+static int et_calls;
+
+static void
+et_read_cb(int fd, short what, void *arg)
+{
+	char c;
+
+	/* leave the rest of the data unread */
+	read(fd, &c, 1);
+	et_calls++;
+}
+
+static void
+test_edge_triggered(void)
+{
+	struct event_base *base;
+	struct event ev;
+	struct timeval tv;
+	int supported;
+
+	setup_test("Edge-triggered events: ");
+
+	base = event_base_new();
+	supported = (event_base_get_features(base) & EV_FEATURE_ET) != 0;
+	event_set(&ev, pair[1], EV_READ|EV_PERSIST|EV_ET, et_read_cb, NULL);
+	event_base_set(base, &ev);
+	if (event_add(&ev, NULL) == -1) {
+		if (!supported)
+			test_ok = 1;
+		goto end;
+	}
+	if (!supported)
+		goto end;
+
+	et_calls = 0;
+	write(pair[0], "abc", 3);
+	tv.tv_sec = 0;
+	tv.tv_usec = 100 * 1000;
+	event_base_loopexit(base, &tv);
+	event_base_dispatch(base);
+
+	/* a level-triggered event would have fired once per byte */
+	if (et_calls == 1)
+		test_ok = 1;
+	event_del(&ev);
+
+end:
+	event_base_free(base);
+
+	cleanup_test();
+}
+
+struct test_pri_event {
+	struct event ev;
+	int count;
+};
+
+static void
+test_priorities_cb(int fd, short what, void *arg)
+{
+	struct test_pri_event *pri = arg;
+	struct timeval tv;
+
+	if (pri->count == 3) {
+		event_loopexit(NULL);
+		return;
+	}
+
+	pri->count++;
+
+	evutil_timerclear(&tv);
+	event_add(&pri->ev, &tv);
+}
+
+static void
+test_priorities(int npriorities)
+{
+	char buf[32];
+	struct test_pri_event one, two;
+	struct timeval tv;
+
+	evutil_snprintf(buf, sizeof(buf), "Testing Priorities %d: ", npriorities);
+	setup_test(buf);
+
+	event_base_priority_init(global_base, npriorities);
+
+	memset(&one, 0, sizeof(one));
+	memset(&two, 0, sizeof(two));
+
+	timeout_set(&one.ev, test_priorities_cb, &one);
+	if (event_priority_set(&one.ev, 0) == -1) {
+		fprintf(stderr, "%s: failed to set priority", __func__);
+		exit(1);
+	}
+
+	timeout_set(&two.ev, test_priorities_cb, &two);
+	if (event_priority_set(&two.ev, npriorities - 1) == -1) {
+		fprintf(stderr, "%s: failed to set priority", __func__);
+		exit(1);
+	}
+
+	evutil_timerclear(&tv);
+
+	if (event_add(&one.ev, &tv) == -1)
+		exit(1);
+	if (event_add(&two.ev, &tv) == -1)
+		exit(1);
 
 	event_dispatch();
 
@@ -1626,6 +3425,11 @@ main (int argc, char **argv)
 #endif
 	setvbuf(stdout, NULL, _IONBF, 0);
 
+	/* everything the tests allocate is accounted for */
+	event_set_mem_functions(regress_malloc, regress_realloc, regress_free);
+	if (event_enable_mem_accounting() == -1)
+		return (1);
+
 	/* Initalize the event library */
 	global_base = event_init();
 
@@ -1639,10 +3443,13 @@ main (int argc, char **argv)
 	test_priorities(3);
 
 	test_evbuffer();
+	test_evbuffer_chains();
 	test_evbuffer_find();
 	
 	test_bufferevent();
 	test_bufferevent_watermarks();
+	test_bufferevent_edge_triggered();
+	test_edge_triggered();
 
 	test_free_active_base();
 
@@ -1678,6 +3485,33 @@ main (int argc, char **argv)
 #endif
 	test_loopexit();
 	test_loopbreak();
+	test_base_post();
+#ifdef HAVE_PTHREAD_H
+	test_base_post_thread();
+#endif
+	test_timer_wheel();
+	test_common_timeout();
+	test_precise_timer();
+	test_base_stats();
+	test_watchdog();
+	test_priority_budgets();
+	test_nested_loop();
+	test_event_new();
+	test_mem_accounting();
+	test_cached_time();
+	test_busy_poll();
+	test_timer_slack();
+	test_deferred_callbacks();
+#ifdef HAVE_SYS_SIGNALFD_H
+	test_signalfd();
+#endif
+	test_foreach_event();
+	test_sparse_fd();
+	test_max_dispatch_events();
+	test_evlistener();
+	test_base_group();
+	test_reused_fd();
+	test_unwatchable_fd();
 
 	test_loopexit_multiple();
 	
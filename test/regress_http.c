@@ -1453,6 +1453,129 @@ http_negative_content_length_test(void)
 	fprintf(stdout, "OK\n");
 }
 
+#define REUSEPORT_REQUESTS	32
+
+static int reuseport_served[2];
+static int reuseport_done;
+
+static void
+http_reuseport_cb(struct evhttp_request *req, void *arg)
+{
+	struct evbuffer *evb = evbuffer_new();
+
+	reuseport_served[(long)arg]++;
+	evbuffer_add_printf(evb, "This is funny");
+	evhttp_send_reply(req, HTTP_OK, "Everything is fine", evb);
+	evbuffer_free(evb);
+}
+
+static void
+http_reuseport_done(struct evhttp_request *req, void *arg)
+{
+	if (req != NULL && req->response_code == HTTP_OK)
+		reuseport_done++;
+}
+
+/* Sends requests to port and runs both bases until all are answered */
+static int
+http_reuseport_run(struct event_base *bases[2], short port)
+{
+	struct evhttp_connection *evcons[REUSEPORT_REQUESTS];
+	struct evhttp_request *req;
+	int i, j;
+
+	reuseport_served[0] = reuseport_served[1] = 0;
+	reuseport_done = 0;
+	for (i = 0; i < REUSEPORT_REQUESTS; i++) {
+		evcons[i] = evhttp_connection_new("127.0.0.1", port);
+		evhttp_connection_set_base(evcons[i], bases[0]);
+		req = evhttp_request_new(http_reuseport_done, NULL);
+		evhttp_add_header(req->output_headers, "Host", "somehost");
+		evhttp_make_request(evcons[i], req, EVHTTP_REQ_GET, "/test");
+	}
+
+	for (j = 0; j < 100000 && reuseport_done < REUSEPORT_REQUESTS; j++) {
+		event_base_loop(bases[0], EVLOOP_NONBLOCK);
+		event_base_loop(bases[1], EVLOOP_NONBLOCK);
+	}
+
+	for (i = 0; i < REUSEPORT_REQUESTS; i++)
+		evhttp_connection_free(evcons[i]);
+
+	return (reuseport_done == REUSEPORT_REQUESTS &&
+	    reuseport_served[0] + reuseport_served[1] == REUSEPORT_REQUESTS);
+}
+
+static void
+http_reuseport_test(void)
+{
+	struct event_base *bases[2];
+	struct evhttp *https[2];
+	short port = -1;
+	long i;
+	int fd;
+
+	fprintf(stdout, "Testing HTTP Server with SO_REUSEPORT and EV_EXCLUSIVE: ");
+
+	for (i = 0; i < 2; i++) {
+		bases[i] = event_base_new();
+		https[i] = evhttp_new(bases[i]);
+		evhttp_set_cb(https[i], "/test", http_reuseport_cb, (void *)i);
+	}
+
+	/* a server per base, each with its own socket on the port */
+	for (i = 0; i < 50 && port == -1; ++i) {
+		if (evhttp_bind_socket_with_flags(https[0], "127.0.0.1",
+			8080 + i, EVHTTP_BIND_REUSEPORT) != -1)
+			port = 8080 + i;
+	}
+	if (port == -1) {
+		/* no SO_REUSEPORT here */
+		fprintf(stdout, "SKIPPED\n");
+		goto end;
+	}
+	if (evhttp_bind_socket_with_flags(https[1], "127.0.0.1", port,
+		EVHTTP_BIND_REUSEPORT) == -1)
+		goto fail;
+	/* the kernel spreads the connections over both sockets */
+	if (!http_reuseport_run(bases, port) ||
+	    reuseport_served[0] == 0 || reuseport_served[1] == 0)
+		goto fail;
+
+	for (i = 0; i < 2; i++) {
+		evhttp_free(https[i]);
+		https[i] = evhttp_new(bases[i]);
+		evhttp_set_cb(https[i], "/test", http_reuseport_cb, (void *)i);
+	}
+
+	/* one socket that both bases wait for exclusively */
+	port = -1;
+	for (i = 0; i < 50 && port == -1; ++i) {
+		if (evhttp_bind_socket_with_flags(https[0], "127.0.0.1",
+			8080 + i, EVHTTP_BIND_EXCLUSIVE) != -1)
+			port = 8080 + i;
+	}
+	if (port == -1)
+		goto fail;
+	fd = evlistener_get_fd(TAILQ_FIRST(&https[0]->sockets)->listener);
+	if (evhttp_accept_socket_with_flags(https[1], dup(fd),
+		EVHTTP_BIND_EXCLUSIVE) == -1)
+		goto fail;
+	if (!http_reuseport_run(bases, port))
+		goto fail;
+
+	fprintf(stdout, "OK\n");
+end:
+	for (i = 0; i < 2; i++) {
+		evhttp_free(https[i]);
+		event_base_free(bases[i]);
+	}
+	return;
+fail:
+	fprintf(stdout, "FAILED\n");
+	exit(1);
+}
+
 void
 http_suite(void)
 {
@@ -1473,4 +1596,5 @@ http_suite(void)
 	http_negative_content_length_test();
 
 	http_chunked_test();
+	http_reuseport_test();
 }
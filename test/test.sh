@@ -7,6 +7,7 @@ setup () {
 	 EVENT_NOSELECT=yes; export EVENT_NOSELECT
 	 EVENT_NOEPOLL=yes; export EVENT_NOEPOLL
 	 EVENT_NOEVPORT=yes; export EVENT_NOEVPORT
+	 EVENT_NOIOURING=yes; export EVENT_NOIOURING
 }
 
 test () {
@@ -87,5 +88,20 @@ export EVENT_NOEVPORT
 echo "EVPORT"
 test
 
+setup
+unset EVENT_NOIOURING
+export EVENT_NOIOURING
+echo "IO_URING"
+test
+
+# the default method, with timeouts in a timing wheel
+setup
+unset EVENT_NOKQUEUE EVENT_NODEVPOLL EVENT_NOPOLL EVENT_NOSELECT
+unset EVENT_NOEPOLL EVENT_NOEVPORT EVENT_NOIOURING
+EVENT_TIMER_WHEEL=yes; export EVENT_TIMER_WHEEL
+echo "TIMER WHEEL"
+test
+unset EVENT_TIMER_WHEEL
+
 
 
@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2026 The libevent contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <limits.h>
+#include <string.h>
+
+#include "event.h"
+#include "evutil.h"
+
+/*
+ * A hashed hierarchical timing wheel, used instead of the min heap by
+ * bases created with EVBASE_TIMER_WHEEL.
+ *
+ * Time is counted in 1ms ticks since the wheel was created.  The first
+ * level has a slot for each of the next 256 ticks; each of the four levels
+ * above it has 64 slots covering 64 times the range of the level below.
+ * Whenever the first level wraps around, the next slot of the second level
+ * is cascaded, i.e. its events are redistributed into the lower levels,
+ * and so on upwards.  Adding and removing a timeout is O(1).
+ *
+ * Events hang off the slots through ev_timeout_pos.ev_next_with_timeout.
+ * The lists are not tail queues: tqe_prev points at whatever points at
+ * the event, so an event can be unlinked without knowing its slot.
+ * Expired events are moved to a separate list from which the event loop
+ * takes them one by one.
+ */
+
+#define TW_LVL0_BITS	8
+#define TW_LVLN_BITS	6
+#define TW_LVL0_SIZE	(1 << TW_LVL0_BITS)
+#define TW_LVLN_SIZE	(1 << TW_LVLN_BITS)
+#define TW_LEVELS	5
+#define TW_NSLOTS	(TW_LVL0_SIZE + (TW_LEVELS - 1) * TW_LVLN_SIZE)
+/* timeouts further out than this are parked and rescheduled on expiry */
+#define TW_MAX_TICKS	\
+	((((ev_uint64_t)1) << (TW_LVL0_BITS + (TW_LEVELS-1)*TW_LVLN_BITS)) - 1)
+
+#define TW_LINK(e)	((e)->ev_timeout_pos.ev_next_with_timeout)
+
+typedef struct timer_wheel {
+	struct event *slots[TW_NSLOTS];
+	ev_uint64_t used[TW_NSLOTS / 64];	/* bitmap of non-empty slots */
+	struct event *expired;
+	ev_uint64_t cur;		/* tick that is being processed */
+	struct timeval origin;		/* time of tick 0 */
+	unsigned n;
+} timer_wheel_t;
+
+static inline void		timer_wheel_ctor(timer_wheel_t *w,
+				    const struct timeval *now);
+static inline int		timer_wheel_empty(timer_wheel_t *w);
+static inline unsigned		timer_wheel_size(timer_wheel_t *w);
+static inline void		timer_wheel_push(timer_wheel_t *w,
+				    struct event *e);
+static inline void		timer_wheel_erase(timer_wheel_t *w,
+				    struct event *e);
+static inline struct event *	timer_wheel_first(timer_wheel_t *w);
+static inline int		timer_wheel_next(timer_wheel_t *w,
+				    const struct timeval *now,
+				    struct timeval *deadline);
+static inline struct event *	timer_wheel_top_expired(timer_wheel_t *w,
+				    const struct timeval *now);
+static inline int		timer_wheel_foreach(timer_wheel_t *w,
+				    int (*fn)(struct event *, void *),
+				    void *arg);
+static inline void		timer_wheel_adjust(timer_wheel_t *w,
+				    const struct timeval *off);
+
+static inline ev_uint64_t
+tw_ticks_(timer_wheel_t *w, const struct timeval *tv)
+{
+	ev_int64_t usec = (ev_int64_t)(tv->tv_sec - w->origin.tv_sec) * 1000000
+	    + (tv->tv_usec - w->origin.tv_usec);
+	return (usec <= 0 ? 0 : (ev_uint64_t)usec / 1000);
+}
+
+static inline void
+tw_tick_to_tv_(timer_wheel_t *w, ev_uint64_t tick, struct timeval *tv)
+{
+	struct timeval off;
+	off.tv_sec = (long)(tick / 1000);
+	off.tv_usec = (long)(tick % 1000) * 1000;
+	evutil_timeradd(&w->origin, &off, tv);
+}
+
+static inline int
+tw_first_level_slot_(int lvl)
+{
+	return (lvl == 0 ? 0 : TW_LVL0_SIZE + (lvl - 1) * TW_LVLN_SIZE);
+}
+
+static inline int
+tw_shift_(int lvl)
+{
+	return (lvl == 0 ? 0 : TW_LVL0_BITS + (lvl - 1) * TW_LVLN_BITS);
+}
+
+static inline void
+tw_link_(timer_wheel_t *w, struct event **head, struct event *e)
+{
+	TW_LINK(e).tqe_next = *head;
+	if (*head != NULL)
+		TW_LINK(*head).tqe_prev = &TW_LINK(e).tqe_next;
+	*head = e;
+	TW_LINK(e).tqe_prev = head;
+}
+
+static inline void
+tw_unlink_(timer_wheel_t *w, struct event *e)
+{
+	struct event **prev = TW_LINK(e).tqe_prev;
+	struct event *next = TW_LINK(e).tqe_next;
+
+	if (next != NULL)
+		TW_LINK(next).tqe_prev = prev;
+	*prev = next;
+
+	/* we were the only event in one of the slots */
+	if (next == NULL && prev >= w->slots && prev < w->slots + TW_NSLOTS) {
+		int slot = (int)(prev - w->slots);
+		w->used[slot >> 6] &= ~(((ev_uint64_t)1) << (slot & 63));
+	}
+}
+
+static inline void
+tw_place_(timer_wheel_t *w, struct event *e)
+{
+	ev_uint64_t expires = tw_ticks_(w, &e->ev_timeout), idx;
+	int lvl, slot;
+
+	if (expires < w->cur)
+		expires = w->cur;
+	idx = expires - w->cur;
+	if (idx > TW_MAX_TICKS) {
+		expires = w->cur + TW_MAX_TICKS;
+		idx = TW_MAX_TICKS;
+	}
+
+	for (lvl = 0; lvl < TW_LEVELS - 1 &&
+		 idx >= (((ev_uint64_t)1) << tw_shift_(lvl + 1)); lvl++)
+		;
+	if (lvl == 0)
+		slot = (int)(expires & (TW_LVL0_SIZE - 1));
+	else
+		slot = tw_first_level_slot_(lvl) +
+		    (int)((expires >> tw_shift_(lvl)) & (TW_LVLN_SIZE - 1));
+
+	tw_link_(w, &w->slots[slot], e);
+	w->used[slot >> 6] |= ((ev_uint64_t)1) << (slot & 63);
+}
+
+/* Offset of the first used slot at or after start, wrapping; -1 if none */
+static inline int
+tw_find_used_(timer_wheel_t *w, int first, int size, int start)
+{
+	int i, slot;
+
+	for (i = 0; i < size; ) {
+		ev_uint64_t word;
+		slot = first + ((start + i) & (size - 1));
+		word = w->used[slot >> 6] >> (slot & 63);
+		if (word == 0) {
+			/* skip to the next word, or the end of the level */
+			int skip = 64 - (slot & 63);
+			if (((start + i) & (size - 1)) + skip > size)
+				skip = size - ((start + i) & (size - 1));
+			i += skip;
+			continue;
+		}
+		while (!(word & 1)) {
+			word >>= 1;
+			++i;
+		}
+		return (i < size ? i : -1);
+	}
+
+	return (-1);
+}
+
+/*
+ * Move the events of a slot that are due by now to the expired list.  When
+ * the slot's tick is over, the rest were parked there because they are too
+ * far out; they get a new place relative to the current tick.
+ */
+static inline void
+tw_collect_(timer_wheel_t *w, int slot, const struct timeval *now,
+    int tick_is_over)
+{
+	struct event *e, *next;
+
+	for (e = w->slots[slot]; e != NULL; e = next) {
+		next = TW_LINK(e).tqe_next;
+		if (evutil_timercmp(&e->ev_timeout, now, >)) {
+			if (tick_is_over) {
+				tw_unlink_(w, e);
+				tw_place_(w, e);
+			}
+			continue;
+		}
+		tw_unlink_(w, e);
+		tw_link_(w, &w->expired, e);
+	}
+}
+
+/* Redistribute the current slot of a level; returns its index */
+static inline int
+tw_cascade_(timer_wheel_t *w, int lvl)
+{
+	int idx = (int)((w->cur >> tw_shift_(lvl)) & (TW_LVLN_SIZE - 1));
+	int slot = tw_first_level_slot_(lvl) + idx;
+	struct event *e;
+
+	while ((e = w->slots[slot]) != NULL) {
+		tw_unlink_(w, e);
+		tw_place_(w, e);
+	}
+
+	return (idx);
+}
+
+static inline void
+tw_step_(timer_wheel_t *w, ev_uint64_t to)
+{
+	int lvl;
+
+	w->cur = to;
+	if (w->cur & (TW_LVL0_SIZE - 1))
+		return;
+	for (lvl = 1; lvl < TW_LEVELS; ++lvl) {
+		if (tw_cascade_(w, lvl) != 0)
+			break;
+	}
+}
+
+void
+timer_wheel_ctor(timer_wheel_t *w, const struct timeval *now)
+{
+	memset(w, 0, sizeof(*w));
+	w->origin = *now;
+}
+
+int
+timer_wheel_empty(timer_wheel_t *w)
+{
+	return (w->n == 0);
+}
+
+unsigned
+timer_wheel_size(timer_wheel_t *w)
+{
+	return (w->n);
+}
+
+void
+timer_wheel_push(timer_wheel_t *w, struct event *e)
+{
+	tw_place_(w, e);
+	w->n++;
+}
+
+void
+timer_wheel_erase(timer_wheel_t *w, struct event *e)
+{
+	tw_unlink_(w, e);
+	w->n--;
+}
+
+struct event *
+timer_wheel_first(timer_wheel_t *w)
+{
+	int i;
+
+	if (w->expired != NULL)
+		return (w->expired);
+	for (i = 0; i < TW_NSLOTS; ++i) {
+		if (w->slots[i] != NULL)
+			return (w->slots[i]);
+	}
+	return (NULL);
+}
+
+/* Lowers *deadline to the earliest timeout in a slot */
+static inline void
+tw_slot_min_(timer_wheel_t *w, int slot, struct timeval *deadline)
+{
+	struct event *e;
+
+	for (e = w->slots[slot]; e != NULL; e = TW_LINK(e).tqe_next) {
+		if (evutil_timercmp(&e->ev_timeout, deadline, <))
+			*deadline = e->ev_timeout;
+	}
+}
+
+/*
+ * Computes the earliest timeout on the wheel.  The first used slot of each
+ * level holds the earliest timeouts of that level, so only those slots are
+ * scanned, and only when they start before the best deadline so far.
+ * Waking up at the start of a slot instead would cost an extra pass of the
+ * loop that expires nothing.
+ */
+int
+timer_wheel_next(timer_wheel_t *w, const struct timeval *now,
+    struct timeval *deadline)
+{
+	int lvl, k;
+
+	if (w->n == 0)
+		return (-1);
+
+	if (w->expired != NULL) {
+		*deadline = *now;
+		return (0);
+	}
+
+	deadline->tv_sec = LONG_MAX;
+	deadline->tv_usec = 0;
+
+	k = tw_find_used_(w, 0, TW_LVL0_SIZE,
+	    (int)(w->cur & (TW_LVL0_SIZE - 1)));
+	if (k != -1)
+		tw_slot_min_(w, (int)((w->cur + k) & (TW_LVL0_SIZE - 1)),
+		    deadline);
+
+	for (lvl = 1; lvl < TW_LEVELS; ++lvl) {
+		int shift = tw_shift_(lvl);
+		int idx = (int)((w->cur >> shift) & (TW_LVLN_SIZE - 1));
+		struct timeval start;
+
+		k = tw_find_used_(w, tw_first_level_slot_(lvl), TW_LVLN_SIZE,
+		    (idx + 1) & (TW_LVLN_SIZE - 1));
+		if (k == -1)
+			continue;
+		tw_tick_to_tv_(w, ((w->cur >> shift) + k + 1) << shift, &start);
+		if (evutil_timercmp(&start, deadline, >))
+			continue;
+		tw_slot_min_(w, tw_first_level_slot_(lvl) +
+		    ((idx + 1 + k) & (TW_LVLN_SIZE - 1)), deadline);
+	}
+
+	return (0);
+}
+
+/*
+ * Advances the wheel up to now and returns an expired event, or NULL.  The
+ * event stays on the wheel until the caller removes it.
+ */
+struct event *
+timer_wheel_top_expired(timer_wheel_t *w, const struct timeval *now)
+{
+	ev_uint64_t target;
+
+	if (w->expired != NULL || w->n == 0)
+		return (w->expired);
+
+	target = tw_ticks_(w, now);
+	while (w->cur < target) {
+		if (!(w->used[0] | w->used[1] | w->used[2] | w->used[3])) {
+			/* nothing on the first level: skip to its end */
+			ev_uint64_t next = (w->cur | (TW_LVL0_SIZE - 1)) + 1;
+			tw_step_(w, next < target ? next : target);
+			continue;
+		}
+		tw_collect_(w, (int)(w->cur & (TW_LVL0_SIZE - 1)), now, 1);
+		tw_step_(w, w->cur + 1);
+	}
+	tw_collect_(w, (int)(w->cur & (TW_LVL0_SIZE - 1)), now, 0);
+
+	return (w->expired);
+}
+
+/* Calls fn for every event in no particular order until it returns non-zero */
+int
+timer_wheel_foreach(timer_wheel_t *w, int (*fn)(struct event *, void *),
+    void *arg)
+{
+	struct event *e;
+	int i, r;
+
+	for (e = w->expired; e != NULL; e = TW_LINK(e).tqe_next) {
+		if ((r = (*fn)(e, arg)) != 0)
+			return (r);
+	}
+	for (i = 0; i < TW_NSLOTS; ++i) {
+		for (e = w->slots[i]; e != NULL; e = TW_LINK(e).tqe_next) {
+			if ((r = (*fn)(e, arg)) != 0)
+				return (r);
+		}
+	}
+	return (0);
+}
+
+/* The clock jumped backwards by off; move everything with it */
+void
+timer_wheel_adjust(timer_wheel_t *w, const struct timeval *off)
+{
+	struct event *e;
+	int i;
+
+	evutil_timersub(&w->origin, off, &w->origin);
+	for (e = w->expired; e != NULL; e = TW_LINK(e).tqe_next)
+		evutil_timersub(&e->ev_timeout, off, &e->ev_timeout);
+	for (i = 0; i < TW_NSLOTS; ++i) {
+		for (e = w->slots[i]; e != NULL; e = TW_LINK(e).tqe_next)
+			evutil_timersub(&e->ev_timeout, off, &e->ev_timeout);
+	}
+}
+
+#endif /* _TIMER_WHEEL_H_ */